@@ -0,0 +1,65 @@
+// ===========================
+// TIME-ON-AIR LORA
+// ===========================
+// Formula Semtech (datasheet SX1262 §6.1.4, AN1200.13):
+//   Tsym      = 2^SF / BW
+//   Npayload  = 8 + max(ceil((8*PL - 4*SF + 28 + 16*CRC - 20*IH) / (4*(SF - 2*DE))) * CR, 0)
+//   ToA       = (Npreamble + 4.25 + Npayload) * Tsym
+// con CR = denominatore del coding rate (5..8 per 4/5..4/8) e DE = low data
+// rate optimization (obbligatoria con Tsym >= 16.38 ms).
+//
+// Solo aritmetica intera: nessuna dipendenza da Arduino. Le funzioni sono
+// constexpr (una sola espressione, C++11): i ToA con parametri fissi si
+// calcolano in compilazione e si verificano con static_assert.
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include <stdint.h>
+
+// true se il low data rate optimization è obbligatorio (Tsym >= 16.38 ms)
+constexpr bool loraLowDataRateOptimize(uint8_t sf, uint32_t bwHz) {
+    return ((uint64_t)1000000 << sf) >= (uint64_t)16380 * bwHz;
+}
+
+// ceil(numerator / denominator), 0 se numerator <= 0
+constexpr int32_t loraCeilPositive(int32_t numerator, int32_t denominator) {
+    return numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+}
+
+// Simboli del payload (Npayload, gli 8 fissi compresi)
+constexpr int32_t loraPayloadSymbols(uint8_t sf, uint8_t crDenom, uint16_t payloadLength,
+                                     bool crc, bool implicitHeader, bool lowDataRateOptimize) {
+    return 8 + loraCeilPositive(8 * (int32_t)payloadLength - 4 * sf + 28 +
+                                    (crc ? 16 : 0) - (implicitHeader ? 20 : 0),
+                                4 * (sf - 2 * (lowDataRateOptimize ? 1 : 0))) * crDenom;
+}
+
+// Time-on-air in µs con tutti i parametri espliciti (0 se non validi).
+// Simboli totali x4 per rappresentare esattamente i 4.25 del preambolo
+constexpr uint32_t loraFrameTimeOnAirUs(uint8_t sf, uint32_t bwHz, uint8_t crDenom,
+                                        uint16_t preambleLength, uint16_t payloadLength,
+                                        bool crc, bool implicitHeader, bool lowDataRateOptimize) {
+    return (sf < 5 || sf > 12 || bwHz == 0 || crDenom < 5 || crDenom > 8) ? 0 :
+           (uint32_t)((((uint64_t)preambleLength * 4 + 17 +
+                        (uint64_t)loraPayloadSymbols(sf, crDenom, payloadLength, crc,
+                                                     implicitHeader, lowDataRateOptimize) * 4) *
+                       ((uint64_t)1000000 << sf)) / (4 * (uint64_t)bwHz));
+}
+
+// Time-on-air in µs di un frame LoRa, LDRO come lo imposta la radio
+constexpr uint32_t loraTimeOnAirUs(uint8_t sf, uint32_t bwHz, uint8_t crDenom,
+                                   uint16_t preambleLength, uint16_t payloadLength,
+                                   bool crc, bool implicitHeader = false) {
+    return loraFrameTimeOnAirUs(sf, bwHz, crDenom, preambleLength, payloadLength, crc,
+                                implicitHeader, loraLowDataRateOptimize(sf, bwHz));
+}
+
+// Valori di riferimento (calcolatore Semtech LoRa, preambolo 8)
+static_assert(loraTimeOnAirUs(7, 125000, 5, 8, 13, true) == 46336, "ToA SF7/125 13 byte");
+static_assert(loraTimeOnAirUs(12, 125000, 5, 8, 13, true) == 1155072, "ToA SF12/125 13 byte (LDRO)");
+static_assert(loraTimeOnAirUs(9, 125000, 5, 8, 33, false) == 246784, "ToA SF9/125 33 byte senza CRC");
+static_assert(loraTimeOnAirUs(7, 250000, 5, 8, 51, true) == 51328, "ToA SF7/250 51 byte");
+static_assert(loraTimeOnAirUs(12, 125000, 5, 8, 51, true) == 2465792, "ToA SF12/125 51 byte (LDRO)");
+static_assert(loraFrameTimeOnAirUs(10, 125000, 5, 8, 12, true, true, false) == 247808, "ToA SF10/125 header implicito");
+
+#endif // AIRTIME_H
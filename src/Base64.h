@@ -0,0 +1,183 @@
+// ===========================
+// BASE64 (RFC 4648, alfabeto standard con padding)
+// ===========================
+// Codifica/decodifica a blocchi 3↔4 byte su buffer forniti dal chiamante:
+// nessuna allocazione, nessuna String. La decodifica usa una tabella
+// inversa a 256 voci calcolata a compile-time (in flash) ed è stretta:
+// lunghezza multipla di 4, solo caratteri dell'alfabeto, padding solo in
+// coda e bit inutilizzati dell'ultimo carattere a zero.
+//
+// Dipende solo dagli header C standard: compila anche su host.
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Caratteri prodotti dalla codifica di length byte (senza terminatore)
+constexpr size_t base64EncodedLength(size_t length) {
+    return ((length + 2) / 3) * 4;
+}
+
+// Byte massimi prodotti dalla decodifica di length caratteri
+constexpr size_t base64MaxDecodedLength(size_t length) {
+    return (length / 4) * 3;
+}
+
+// Valore 0..63 di un carattere dell'alfabeto, -1 se non valido
+constexpr int8_t base64CharValue(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (int8_t)(c - 'A') :
+           (c >= 'a' && c <= 'z') ? (int8_t)(c - 'a' + 26) :
+           (c >= '0' && c <= '9') ? (int8_t)(c - '0' + 52) :
+           (c == '+') ? (int8_t)62 :
+           (c == '/') ? (int8_t)63 : (int8_t)-1;
+}
+
+#define BASE64_ROW(r) \
+    base64CharValue((r) + 0),  base64CharValue((r) + 1),  base64CharValue((r) + 2),  base64CharValue((r) + 3),  \
+    base64CharValue((r) + 4),  base64CharValue((r) + 5),  base64CharValue((r) + 6),  base64CharValue((r) + 7),  \
+    base64CharValue((r) + 8),  base64CharValue((r) + 9),  base64CharValue((r) + 10), base64CharValue((r) + 11), \
+    base64CharValue((r) + 12), base64CharValue((r) + 13), base64CharValue((r) + 14), base64CharValue((r) + 15)
+
+constexpr int8_t BASE64_DECODE_TABLE[256] = {
+    BASE64_ROW(0x00), BASE64_ROW(0x10), BASE64_ROW(0x20), BASE64_ROW(0x30),
+    BASE64_ROW(0x40), BASE64_ROW(0x50), BASE64_ROW(0x60), BASE64_ROW(0x70),
+    BASE64_ROW(0x80), BASE64_ROW(0x90), BASE64_ROW(0xA0), BASE64_ROW(0xB0),
+    BASE64_ROW(0xC0), BASE64_ROW(0xD0), BASE64_ROW(0xE0), BASE64_ROW(0xF0)
+};
+
+#undef BASE64_ROW
+
+constexpr char BASE64_ENCODE_TABLE[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static_assert(BASE64_DECODE_TABLE[(uint8_t)'A'] == 0 && BASE64_DECODE_TABLE[(uint8_t)'/'] == 63 &&
+              BASE64_DECODE_TABLE[(uint8_t)'='] == -1, "BASE64_DECODE_TABLE non valida");
+
+enum class Base64Result : uint8_t {
+    OK = 0,
+    INVALID_LENGTH,    // Lunghezza non multipla di 4
+    INVALID_CHAR,      // Carattere fuori dall'alfabeto
+    INVALID_PADDING,   // '=' fuori posto o bit finali non a zero
+    OUTPUT_TOO_SMALL   // Buffer di uscita insufficiente
+};
+
+inline const char* base64ResultToString(Base64Result result) {
+    switch (result) {
+        case Base64Result::OK:               return "OK";
+        case Base64Result::INVALID_LENGTH:   return "INVALID_LENGTH";
+        case Base64Result::INVALID_CHAR:     return "INVALID_CHAR";
+        case Base64Result::INVALID_PADDING:  return "INVALID_PADDING";
+        case Base64Result::OUTPUT_TOO_SMALL: return "OUTPUT_TOO_SMALL";
+        default:                             return "UNKNOWN";
+    }
+}
+
+// Codifica length byte in out (terminato da '\0').
+// Ritorna i caratteri scritti, 0 se outSize < base64EncodedLength(length) + 1.
+inline size_t base64Encode(const uint8_t* data, size_t length, char* out, size_t outSize) {
+    size_t encodedLength = base64EncodedLength(length);
+    if (outSize < encodedLength + 1) {
+        return 0;
+    }
+
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        uint32_t b = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        *out++ = BASE64_ENCODE_TABLE[(b >> 18) & 0x3F];
+        *out++ = BASE64_ENCODE_TABLE[(b >> 12) & 0x3F];
+        *out++ = BASE64_ENCODE_TABLE[(b >> 6) & 0x3F];
+        *out++ = BASE64_ENCODE_TABLE[b & 0x3F];
+    }
+
+    // Blocco finale di 1 o 2 byte con padding
+    if (i < length) {
+        uint32_t b = (uint32_t)data[i] << 16;
+        bool two = (i + 1 < length);
+        if (two) {
+            b |= (uint32_t)data[i + 1] << 8;
+        }
+        *out++ = BASE64_ENCODE_TABLE[(b >> 18) & 0x3F];
+        *out++ = BASE64_ENCODE_TABLE[(b >> 12) & 0x3F];
+        *out++ = two ? BASE64_ENCODE_TABLE[(b >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+
+    *out = '\0';
+    return encodedLength;
+}
+
+// Decodifica length caratteri (non serve terminatore) in out.
+// decodedLength riceve i byte scritti; con errore il contenuto di out è
+// indefinito e decodedLength vale 0.
+inline Base64Result base64Decode(const char* in, size_t length, uint8_t* out, size_t outSize,
+                                 size_t& decodedLength) {
+    decodedLength = 0;
+    if (length % 4 != 0) {
+        return Base64Result::INVALID_LENGTH;
+    }
+    if (length == 0) {
+        return Base64Result::OK;
+    }
+
+    // Padding: solo negli ultimi due caratteri
+    size_t padding = 0;
+    if (in[length - 1] == '=') {
+        padding = (in[length - 2] == '=') ? 2 : 1;
+    }
+    size_t total = base64MaxDecodedLength(length) - padding;
+    if (total > outSize) {
+        return Base64Result::OUTPUT_TOO_SMALL;
+    }
+
+    const uint8_t* src = (const uint8_t*)in;
+    size_t fullBlocks = (length / 4) - (padding > 0 ? 1 : 0);
+
+    // Blocchi completi: un errore in un qualsiasi carattere rende negativo
+    // l'OR dei quattro valori, un solo test per blocco
+    for (size_t block = 0; block < fullBlocks; block++) {
+        int8_t a = BASE64_DECODE_TABLE[src[0]];
+        int8_t b = BASE64_DECODE_TABLE[src[1]];
+        int8_t c = BASE64_DECODE_TABLE[src[2]];
+        int8_t d = BASE64_DECODE_TABLE[src[3]];
+        if ((a | b | c | d) < 0) {
+            // '=' nel mezzo è un errore di padding, il resto carattere non valido
+            for (int k = 0; k < 4; k++) {
+                if (src[k] == '=') return Base64Result::INVALID_PADDING;
+            }
+            return Base64Result::INVALID_CHAR;
+        }
+        uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+        out[0] = (uint8_t)(v >> 16);
+        out[1] = (uint8_t)(v >> 8);
+        out[2] = (uint8_t)v;
+        out += 3;
+        src += 4;
+    }
+
+    // Blocco finale con 1 o 2 '='
+    if (padding > 0) {
+        int8_t a = BASE64_DECODE_TABLE[src[0]];
+        int8_t b = BASE64_DECODE_TABLE[src[1]];
+        int8_t c = (padding == 1) ? BASE64_DECODE_TABLE[src[2]] : 0;
+        if ((a | b | c) < 0) {
+            // Con "==" src[2] è padding regolare, non un errore
+            return (src[0] == '=' || src[1] == '=' || (padding == 1 && src[2] == '='))
+                ? Base64Result::INVALID_PADDING : Base64Result::INVALID_CHAR;
+        }
+        uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6);
+        // Codifica canonica: i bit non usati devono essere zero
+        if ((padding == 2 && (v & 0xFFFF) != 0) || (padding == 1 && (v & 0xFF) != 0)) {
+            return Base64Result::INVALID_PADDING;
+        }
+        out[0] = (uint8_t)(v >> 16);
+        if (padding == 1) {
+            out[1] = (uint8_t)(v >> 8);
+        }
+    }
+
+    decodedLength = total;
+    return Base64Result::OK;
+}
+
+#endif // BASE64_H
@@ -0,0 +1,68 @@
+// ===========================
+// POOL DI BLOCCHI A DIMENSIONE FISSA
+// ===========================
+// COUNT blocchi da BLOCK_SIZE byte in un unico array statico: allocazione e
+// rilascio in O(1) tramite una free list di indici, nessun uso dell'heap e
+// nessuna frammentazione. Non thread-safe: va usato da un solo task.
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <size_t BLOCK_SIZE, uint16_t COUNT>
+class BlockPool {
+    static_assert(COUNT > 0 && COUNT < 0xFFFF, "BlockPool: COUNT non valido");
+
+private:
+    static constexpr uint16_t NO_BLOCK = 0xFFFF;
+
+    alignas(4) uint8_t blocks[COUNT][BLOCK_SIZE];
+    uint16_t nextFree[COUNT];  // Free list concatenata per indice
+    uint16_t freeHead = 0;
+    uint16_t freeCount = 0;
+
+public:
+    BlockPool() {
+        clear();
+    }
+
+    // Ritorna un blocco libero, nullptr se il pool è esaurito
+    uint8_t* allocate() {
+        if (freeHead == NO_BLOCK) {
+            return nullptr;
+        }
+        uint16_t index = freeHead;
+        freeHead = nextFree[index];
+        freeCount--;
+        return blocks[index];
+    }
+
+    // Restituisce un blocco ottenuto con allocate()
+    void release(uint8_t* block) {
+        if (block == nullptr) {
+            return;
+        }
+        uint16_t index = (uint16_t)((block - blocks[0]) / BLOCK_SIZE);
+        nextFree[index] = freeHead;
+        freeHead = index;
+        freeCount++;
+    }
+
+    // Rende di nuovo liberi tutti i blocchi
+    void clear() {
+        for (uint16_t i = 0; i < COUNT; i++) {
+            nextFree[i] = (i + 1 < COUNT) ? i + 1 : NO_BLOCK;
+        }
+        freeHead = 0;
+        freeCount = COUNT;
+    }
+
+    uint16_t available() const { return freeCount; }
+    uint16_t used() const { return COUNT - freeCount; }
+
+    static constexpr size_t blockSize() { return BLOCK_SIZE; }
+    static constexpr uint16_t capacity() { return COUNT; }
+};
+
+#endif // BLOCK_POOL_H
@@ -0,0 +1,147 @@
+// ===========================
+// CONTABILITÀ DEL TEMPO "SORDO" DELLA RADIO
+// ===========================
+// La radio è sorda (non in RX) da RxDone al successivo startReceive(),
+// durante TX, nel pre-roll con IQ invertito, in standby per OTA e finché
+// una reinizializzazione non va a buon fine. Ogni intervallo sordo ha un
+// motivo; il ledger accumula i us per motivo:
+//
+// - dall'avvio (uint64, non va in overflow)
+// - per finestra di DEAF_WINDOW_US (1 minuto): alla chiusura della
+//   finestra la percentuale in millesimi diventa "ultimo minuto"
+//
+// Un intervallo a cavallo di due finestre viene diviso tra le due.
+// Scritto solo dal radio task; le letture di lastWindow*/totali da altri
+// task sono di singoli contatori senza lock.
+// Il tempo arriva dal chiamante (tmst in us): compila anche su host.
+#ifndef DEAF_TIME_H
+#define DEAF_TIME_H
+
+#include <stdint.h>
+
+#ifndef DEAF_WINDOW_US
+#define DEAF_WINDOW_US 60000000UL
+#endif
+
+enum class DeafReason : uint8_t {
+    PROCESSING = 0,  // RxDone → startReceive (lettura, log, gestione)
+    TX,              // Trasmissione downlink
+    WAITING,         // Pre-roll TX: IQ già invertito, in attesa dell'istante
+    REINIT,          // Radio non inizializzata / riavvio RX fallito
+    OTA,             // Standby durante l'aggiornamento OTA
+    COUNT
+};
+
+inline const char* deafReasonToString(DeafReason reason) {
+    switch (reason) {
+        case DeafReason::PROCESSING: return "PROCESSING";
+        case DeafReason::TX:         return "TX";
+        case DeafReason::WAITING:    return "WAITING";
+        case DeafReason::REINIT:     return "REINIT";
+        case DeafReason::OTA:        return "OTA";
+        default:                     return "UNKNOWN";
+    }
+}
+
+class DeafTimeLedger {
+private:
+    static constexpr uint8_t REASONS = (uint8_t)DeafReason::COUNT;
+
+    bool deaf = true;                     // All'avvio la radio non è ancora in RX
+    DeafReason reason = DeafReason::REINIT;
+    uint32_t since = 0;                   // Inizio della parte non ancora contata
+
+    uint32_t windowStart = 0;
+    uint32_t windowUs[REASONS] = {0};
+    uint64_t totalUs[REASONS] = {0};
+
+    uint16_t lastWindowPermille[REASONS] = {0};
+    uint16_t lastWindowTotalPermille = 0;
+    uint32_t windows = 0;                 // Finestre chiuse
+
+    // Un tmst precedente all'ultimo già contato (es. dio1Tmst catturato
+    // prima di un tick) viene portato avanti: nessun tratto contato due volte
+    uint32_t clamp(uint32_t now) const {
+        return ((int32_t)(now - since) < 0) ? since : now;
+    }
+
+    // Conta il tratto [since, now) dell'intervallo in corso
+    void account(uint32_t now) {
+        if (deaf) {
+            uint32_t elapsed = now - since;
+            windowUs[(uint8_t)reason] += elapsed;
+            totalUs[(uint8_t)reason] += elapsed;
+        }
+        since = now;
+    }
+
+    void closeWindows(uint32_t now) {
+        while ((int32_t)(now - windowStart) >= (int32_t)DEAF_WINDOW_US) {
+            uint32_t windowEnd = windowStart + DEAF_WINDOW_US;
+            account(windowEnd);
+
+            uint32_t total = 0;
+            for (uint8_t i = 0; i < REASONS; i++) {
+                lastWindowPermille[i] = (uint16_t)((uint64_t)windowUs[i] * 1000 / DEAF_WINDOW_US);
+                total += windowUs[i];
+                windowUs[i] = 0;
+            }
+            lastWindowTotalPermille = (uint16_t)((uint64_t)total * 1000 / DEAF_WINDOW_US);
+            windowStart = windowEnd;
+            windows++;
+        }
+    }
+
+public:
+    // Avvio: radio sorda (REINIT) da now
+    void begin(uint32_t now) {
+        deaf = true;
+        reason = DeafReason::REINIT;
+        since = now;
+        windowStart = now;
+    }
+
+    // La radio lascia l'RX (o cambia motivo se già sorda)
+    void enter(DeafReason newReason, uint32_t now) {
+        now = clamp(now);
+        closeWindows(now);
+        account(now);
+        deaf = true;
+        reason = newReason;
+    }
+
+    // La radio è di nuovo in RX
+    void leave(uint32_t now) {
+        now = clamp(now);
+        closeWindows(now);
+        account(now);
+        deaf = false;
+    }
+
+    // Da chiamare periodicamente: chiude le finestre anche senza eventi
+    void tick(uint32_t now) {
+        now = clamp(now);
+        closeWindows(now);
+        account(now);
+    }
+
+    bool isDeaf() const { return deaf; }
+    DeafReason currentReason() const { return reason; }
+
+    // Ultimo minuto completo, in millesimi (123 = 12.3%)
+    uint16_t getLastWindowPermille() const { return lastWindowTotalPermille; }
+    uint16_t getLastWindowPermille(DeafReason r) const { return lastWindowPermille[(uint8_t)r]; }
+    uint32_t getWindowCount() const { return windows; }
+
+    // Dall'avvio, in us
+    uint64_t getTotalUs(DeafReason r) const { return totalUs[(uint8_t)r]; }
+    uint64_t getTotalUs() const {
+        uint64_t total = 0;
+        for (uint8_t i = 0; i < REASONS; i++) {
+            total += totalUs[i];
+        }
+        return total;
+    }
+};
+
+#endif // DEAF_TIME_H
@@ -0,0 +1,36 @@
+// ===========================
+// DOWNLINK COMPATTO (ring network → radio e coda downlink)
+// ===========================
+// Solo ciò che serve per trasmettere: frame LoRaWAN già decodificato e
+// parametri radio in forma numerica (DownlinkTxParams, TxpkParser.h).
+// Niente testo base64 né stringhe modu/datr/codr.
+// SemtechUdpPackage::getPullResponse() lo scrive direttamente nello slot
+// finale del ring (reserve → parse → commit).
+//
+// Dipende solo da TxpkParser.h: compila anche su host.
+#ifndef DOWNLINK_FRAME_H
+#define DOWNLINK_FRAME_H
+
+#include <stdint.h>
+#include "TxpkParser.h"
+
+#ifndef DOWNLINK_MAX_FRAME_SIZE
+#define DOWNLINK_MAX_FRAME_SIZE 255  // PHYPayload max EU868: MHDR + 250 MACPayload + MIC
+#endif
+
+// Metadati di un downlink (senza payload)
+struct DownlinkInfo {
+    uint32_t devAddr = 0;
+    uint16_t token = 0;           // Token del PULL_RESP (per TX_ACK)
+    uint8_t fport = 0;
+    uint8_t length = 0;           // Lunghezza frame decodificato
+    DownlinkTxParams tx;
+};
+
+// Downlink completo: metadati + frame LoRaWAN binario
+struct DownlinkFrame {
+    DownlinkInfo info;
+    uint8_t payload[DOWNLINK_MAX_FRAME_SIZE];
+};
+
+#endif // DOWNLINK_FRAME_H
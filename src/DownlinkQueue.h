@@ -0,0 +1,471 @@
+// ===========================
+// CODA DOWNLINK JUST-IN-TIME
+// ===========================
+// Due lane separate:
+// - programmata (Classe A): albero AVL ordinato per txTmst → prossimo dovuto
+//   in O(1), inserimento/estrazione in O(log n). Gli intervalli in coda non
+//   si sovrappongono, quindi per un nuovo [txTmst, txTmst + time-on-air)
+//   basta confrontare il predecessore e il successore: O(log n).
+// - immediata (Classe C, imme=true): FIFO.
+// Gli slot liberi sono in uno stack (O(1)) e il limite per DevAddr passa da
+// un indice hash DevAddr → conteggio (O(1)), senza scansioni della coda.
+// Ogni elemento tiene solo i metadati compatti (DownlinkInfo); il frame
+// decodificato sta in un blocco di un pool a dimensione fissa.
+//
+// Nessuna dipendenza da Arduino: compila anche su host.
+#ifndef DOWNLINK_QUEUE_H
+#define DOWNLINK_QUEUE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "DownlinkFrame.h"
+#include "DownlinkScheduler.h"
+#include "BlockPool.h"
+
+#ifndef MAX_DOWNLINK_QUEUE_SIZE
+#define MAX_DOWNLINK_QUEUE_SIZE 24  // Massimo 24 messaggi totali in coda (~7 KB)
+#endif
+
+#ifndef MAX_DOWNLINK_PER_DEVADDR
+#define MAX_DOWNLINK_PER_DEVADDR 2  // Massimo 2 messaggi per DevAddr (RX1 + RX2)
+#endif
+
+static_assert(MAX_DOWNLINK_QUEUE_SIZE <= 0xFFFF, "MAX_DOWNLINK_QUEUE_SIZE troppo grande");
+
+// Esito di un inserimento in coda
+enum class QueueResult : uint8_t {
+    OK = 0,
+    FULL,            // Coda piena (MAX_DOWNLINK_QUEUE_SIZE)
+    DEVADDR_LIMIT,   // Limite per DevAddr raggiunto (MAX_DOWNLINK_PER_DEVADDR)
+    COLLISION        // Intervallo TX sovrapposto a un downlink già programmato
+};
+
+inline const char* queueResultToString(QueueResult result) {
+    switch (result) {
+        case QueueResult::OK:            return "OK";
+        case QueueResult::FULL:          return "FULL";
+        case QueueResult::DEVADDR_LIMIT: return "DEVADDR_LIMIT";
+        case QueueResult::COLLISION:     return "COLLISION";
+        default:                         return "UNKNOWN";
+    }
+}
+
+// Elemento in coda: metadati del downlink + dati di scheduling
+struct DownlinkEntry {
+    DownlinkInfo info;
+    uint8_t* payload = nullptr;  // Frame decodificato (blocco del pool)
+    uint32_t txTmst = 0;      // Istante TX (lane programmata)
+    uint32_t airtimeUs = 0;   // Time-on-air del frame
+    uint32_t rxTmst = 0;      // tmst dell'uplink associato (0 = nessuno)
+    bool immediate = false;   // Lane Classe C
+
+    // Fine dell'intervallo TX occupato
+    uint32_t endTmst() const {
+        return txTmst + airtimeUs;
+    }
+};
+
+// Potenza di 2 >= n (per dimensionare l'indice hash)
+constexpr uint32_t downlinkQueueNextPow2(uint32_t n, uint32_t p = 1) {
+    return p >= n ? p : downlinkQueueNextPow2(n, p << 1);
+}
+
+class DownlinkQueue {
+private:
+    static constexpr uint16_t CAPACITY = MAX_DOWNLINK_QUEUE_SIZE;
+    static constexpr uint16_t NO_SLOT = 0xFFFF;
+
+    DownlinkEntry entries[CAPACITY];
+    BlockPool<DOWNLINK_MAX_FRAME_SIZE, CAPACITY> payloadPool;
+
+    // Slot liberi (stack)
+    uint16_t freeSlots[CAPACITY];
+    uint16_t freeCount = 0;
+
+    // Lane programmata: AVL di slot, chiave txTmst (figli e altezza per slot)
+    uint16_t treeLeft[CAPACITY];
+    uint16_t treeRight[CAPACITY];
+    uint8_t treeHeight[CAPACITY];
+    uint16_t treeRoot = NO_SLOT;
+    uint16_t firstSlot = NO_SLOT;    // Nodo più a sinistra: prossimo dovuto
+    uint16_t scheduledSize = 0;
+
+    // Lane immediata: FIFO circolare di slot
+    uint16_t immediateFifo[CAPACITY];
+    uint16_t immediateHead = 0;
+    uint16_t immediateCount = 0;
+
+    // Indice DevAddr → numero di messaggi (hash a indirizzamento aperto,
+    // linear probing con cancellazione a backward-shift: niente tombstone)
+    struct DevAddrCount {
+        uint32_t devAddr;
+        uint8_t count;  // 0 = bucket vuoto
+    };
+    static constexpr uint32_t INDEX_SIZE = downlinkQueueNextPow2(2 * CAPACITY);
+    DevAddrCount devAddrIndex[INDEX_SIZE];
+
+    // ----- INDICE DEVADDR -----
+
+    static uint32_t hashDevAddr(uint32_t devAddr) {
+        return (devAddr * 2654435761u) & (INDEX_SIZE - 1);
+    }
+
+    // Bucket di devAddr, o il primo bucket vuoto della sua sequenza di probing
+    uint32_t findBucket(uint32_t devAddr) const {
+        uint32_t i = hashDevAddr(devAddr);
+        while (devAddrIndex[i].count != 0 && devAddrIndex[i].devAddr != devAddr) {
+            i = (i + 1) & (INDEX_SIZE - 1);
+        }
+        return i;
+    }
+
+    void indexIncrement(uint32_t devAddr) {
+        uint32_t i = findBucket(devAddr);
+        devAddrIndex[i].devAddr = devAddr;
+        devAddrIndex[i].count++;
+    }
+
+    void indexDecrement(uint32_t devAddr) {
+        uint32_t i = findBucket(devAddr);
+        if (devAddrIndex[i].count == 0) {
+            return;
+        }
+        if (--devAddrIndex[i].count > 0) {
+            return;
+        }
+        // Bucket svuotato: riporta indietro gli elementi successivi del cluster
+        uint32_t hole = i;
+        uint32_t j = (i + 1) & (INDEX_SIZE - 1);
+        while (devAddrIndex[j].count != 0) {
+            uint32_t home = hashDevAddr(devAddrIndex[j].devAddr);
+            // Sposta j nel buco se la sua posizione ideale non sta in (hole, j]
+            if (((j - home) & (INDEX_SIZE - 1)) >= ((j - hole) & (INDEX_SIZE - 1))) {
+                devAddrIndex[hole] = devAddrIndex[j];
+                devAddrIndex[j].count = 0;
+                hole = j;
+            }
+            j = (j + 1) & (INDEX_SIZE - 1);
+        }
+    }
+
+    // ----- ALBERO AVL -----
+    // Altezza <= 1.44 log2(n + 2): le ricorsioni di insert/remove restano
+    // entro TREE_MAX_HEIGHT livelli anche con 0xFFFF slot.
+    static constexpr uint8_t TREE_MAX_HEIGHT = 24;
+
+    bool earlier(uint16_t a, uint16_t b) const {
+        return tmstDelta(entries[a].txTmst, entries[b].txTmst) < 0;
+    }
+
+    uint8_t nodeHeight(uint16_t node) const {
+        return node == NO_SLOT ? 0 : treeHeight[node];
+    }
+
+    void updateHeight(uint16_t node) {
+        uint8_t left = nodeHeight(treeLeft[node]);
+        uint8_t right = nodeHeight(treeRight[node]);
+        treeHeight[node] = 1 + (left > right ? left : right);
+    }
+
+    uint16_t rotateRight(uint16_t node) {
+        uint16_t left = treeLeft[node];
+        treeLeft[node] = treeRight[left];
+        treeRight[left] = node;
+        updateHeight(node);
+        updateHeight(left);
+        return left;
+    }
+
+    uint16_t rotateLeft(uint16_t node) {
+        uint16_t right = treeRight[node];
+        treeRight[node] = treeLeft[right];
+        treeLeft[right] = node;
+        updateHeight(node);
+        updateHeight(right);
+        return right;
+    }
+
+    // Ripristina |altezza sinistra - altezza destra| <= 1, ritorna la nuova radice
+    uint16_t rebalance(uint16_t node) {
+        updateHeight(node);
+        int balance = (int)nodeHeight(treeLeft[node]) - (int)nodeHeight(treeRight[node]);
+        if (balance > 1) {
+            uint16_t left = treeLeft[node];
+            if (nodeHeight(treeLeft[left]) < nodeHeight(treeRight[left])) {
+                treeLeft[node] = rotateLeft(left);
+            }
+            return rotateRight(node);
+        }
+        if (balance < -1) {
+            uint16_t right = treeRight[node];
+            if (nodeHeight(treeRight[right]) < nodeHeight(treeLeft[right])) {
+                treeRight[node] = rotateRight(right);
+            }
+            return rotateLeft(node);
+        }
+        return node;
+    }
+
+    uint16_t insertNode(uint16_t node, uint16_t slot) {
+        if (node == NO_SLOT) {
+            treeLeft[slot] = NO_SLOT;
+            treeRight[slot] = NO_SLOT;
+            treeHeight[slot] = 1;
+            return slot;
+        }
+        if (earlier(slot, node)) {
+            treeLeft[node] = insertNode(treeLeft[node], slot);
+        } else {
+            treeRight[node] = insertNode(treeRight[node], slot);
+        }
+        return rebalance(node);
+    }
+
+    // Toglie il nodo più a sinistra del sottoalbero
+    uint16_t removeFirst(uint16_t node) {
+        if (treeLeft[node] == NO_SLOT) {
+            return treeRight[node];
+        }
+        treeLeft[node] = removeFirst(treeLeft[node]);
+        return rebalance(node);
+    }
+
+    uint16_t leftmost(uint16_t node) const {
+        if (node == NO_SLOT) return NO_SLOT;
+        while (treeLeft[node] != NO_SLOT) node = treeLeft[node];
+        return node;
+    }
+
+    static bool overlaps(const DownlinkEntry& entry, uint32_t start, uint32_t end) {
+        return tmstDelta(entry.txTmst, end) < 0 && tmstDelta(entry.endTmst(), start) > 0;
+    }
+
+    // true se [start, end) si sovrappone a un downlink programmato. Gli
+    // intervalli in coda sono disgiunti: chi inizia prima del predecessore
+    // finisce prima del suo inizio, chi inizia dopo il successore inizia
+    // dopo la sua fine. Una sola discesa dalla radice.
+    bool overlapsScheduled(uint32_t start, uint32_t end) const {
+        uint16_t predecessor = NO_SLOT;
+        uint16_t successor = NO_SLOT;
+        uint16_t node = treeRoot;
+        while (node != NO_SLOT) {
+            if (tmstDelta(entries[node].txTmst, start) <= 0) {
+                predecessor = node;
+                node = treeRight[node];
+            } else {
+                successor = node;
+                node = treeLeft[node];
+            }
+        }
+        return (predecessor != NO_SLOT && overlaps(entries[predecessor], start, end)) ||
+               (successor != NO_SLOT && overlaps(entries[successor], start, end));
+    }
+
+    // index-esimo downlink programmato in ordine di tmst (visita in ordine)
+    uint16_t scheduledAt(uint16_t index) const {
+        uint16_t stack[TREE_MAX_HEIGHT];
+        uint8_t depth = 0;
+        uint16_t node = treeRoot;
+        for (;;) {
+            while (node != NO_SLOT) {
+                stack[depth++] = node;
+                node = treeLeft[node];
+            }
+            node = stack[--depth];
+            if (index-- == 0) return node;
+            node = treeRight[node];
+        }
+    }
+
+    // ----- SLOT -----
+
+    // Controlli comuni in O(1), prima di qualsiasi ricerca nella coda
+    QueueResult admit(uint32_t devAddr) const {
+        if (freeCount == 0 || payloadPool.available() == 0) {
+            return QueueResult::FULL;
+        }
+        if (countByDevAddr(devAddr) >= MAX_DOWNLINK_PER_DEVADDR) {
+            return QueueResult::DEVADDR_LIMIT;
+        }
+        return QueueResult::OK;
+    }
+
+    // Allocazione slot + blocco payload e copia del frame (solo info.length
+    // byte). Solo dopo admit() == OK.
+    uint16_t allocate(const DownlinkFrame& frame) {
+        uint16_t slot = freeSlots[--freeCount];
+        
+        DownlinkEntry& entry = entries[slot];
+        entry.info = frame.info;
+        entry.payload = payloadPool.allocate();
+        memcpy(entry.payload, frame.payload, frame.info.length);
+        indexIncrement(frame.info.devAddr);
+        return slot;
+    }
+
+    void release(uint16_t slot) {
+        DownlinkEntry& entry = entries[slot];
+        indexDecrement(entry.info.devAddr);
+        payloadPool.release(entry.payload);
+        entry.payload = nullptr;
+        freeSlots[freeCount++] = slot;
+    }
+
+public:
+    // Costruttore: inizializza la coda
+    DownlinkQueue() {
+        clear();
+    }
+
+    // Inserisce un downlink da trasmettere a txTmst (Classe A, copia)
+    QueueResult schedule(const DownlinkFrame& frame, uint32_t txTmst,
+                         uint32_t airtimeUs, uint32_t rxTmst = 0) {
+        QueueResult result = admit(frame.info.devAddr);
+        if (result != QueueResult::OK) {
+            return result;
+        }
+        if (overlapsScheduled(txTmst, txTmst + airtimeUs)) {
+            return QueueResult::COLLISION;
+        }
+
+        uint16_t slot = allocate(frame);
+
+        DownlinkEntry& entry = entries[slot];
+        entry.txTmst = txTmst;
+        entry.airtimeUs = airtimeUs;
+        entry.rxTmst = rxTmst;
+        entry.immediate = false;
+
+        treeRoot = insertNode(treeRoot, slot);
+        if (firstSlot == NO_SLOT || earlier(slot, firstSlot)) {
+            firstSlot = slot;
+        }
+        scheduledSize++;
+        return QueueResult::OK;
+    }
+
+    // Inserisce un downlink immediato (Classe C, copia)
+    QueueResult addImmediate(const DownlinkFrame& frame, uint32_t airtimeUs) {
+        QueueResult result = admit(frame.info.devAddr);
+        if (result != QueueResult::OK) {
+            return result;
+        }
+
+        uint16_t slot = allocate(frame);
+
+        DownlinkEntry& entry = entries[slot];
+        entry.txTmst = 0;
+        entry.airtimeUs = airtimeUs;
+        entry.rxTmst = 0;
+        entry.immediate = true;
+
+        immediateFifo[(immediateHead + immediateCount) % CAPACITY] = slot;
+        immediateCount++;
+        return QueueResult::OK;
+    }
+
+    // Prossimo downlink programmato (O(1)), nullptr se nessuno
+    DownlinkEntry* nextScheduled() {
+        return firstSlot != NO_SLOT ? &entries[firstSlot] : nullptr;
+    }
+
+    // Rimuove il prossimo downlink programmato (O(log n))
+    void popScheduled() {
+        if (firstSlot == NO_SLOT) return;
+        release(firstSlot);
+        treeRoot = removeFirst(treeRoot);
+        firstSlot = leftmost(treeRoot);
+        scheduledSize--;
+    }
+
+    // Primo downlink immediato (O(1)), nullptr se nessuno
+    DownlinkEntry* nextImmediate() {
+        return immediateCount > 0 ? &entries[immediateFifo[immediateHead]] : nullptr;
+    }
+
+    // Rimuove il primo downlink immediato (O(1))
+    void popImmediate() {
+        if (immediateCount == 0) return;
+        release(immediateFifo[immediateHead]);
+        immediateHead = (immediateHead + 1) % CAPACITY;
+        immediateCount--;
+    }
+
+    // Ritorna il numero di elementi nella coda
+    uint16_t size() const {
+        return CAPACITY - freeCount;
+    }
+
+    uint16_t scheduledCount() const {
+        return scheduledSize;
+    }
+
+    uint16_t immediateSize() const {
+        return immediateCount;
+    }
+
+    // Ritorna true se la coda è vuota
+    bool isEmpty() const {
+        return freeCount == CAPACITY;
+    }
+
+    // Ritorna true se la coda è piena
+    bool isFull() const {
+        return freeCount == 0;
+    }
+
+    // Conta quanti elementi ci sono per un specifico DevAddr (O(1))
+    uint8_t countByDevAddr(uint32_t devAddr) const {
+        return devAddrIndex[findBucket(devAddr)].count;
+    }
+
+    // Verifica se si può aggiungere un elemento per un DevAddr specifico
+    bool canAddForDevAddr(uint32_t devAddr) const {
+        return freeCount > 0 && countByDevAddr(devAddr) < MAX_DOWNLINK_PER_DEVADDR;
+    }
+
+    // Svuota completamente la coda
+    void clear() {
+        for (uint16_t i = 0; i < CAPACITY; i++) {
+            freeSlots[i] = CAPACITY - 1 - i;
+            entries[i].payload = nullptr;
+        }
+        payloadPool.clear();
+        freeCount = CAPACITY;
+        treeRoot = NO_SLOT;
+        firstSlot = NO_SLOT;
+        scheduledSize = 0;
+        immediateHead = 0;
+        immediateCount = 0;
+        memset(devAddrIndex, 0, sizeof(devAddrIndex));
+    }
+
+    static constexpr uint16_t capacity() {
+        return CAPACITY;
+    }
+
+    // Una riga per elemento: prima la lane programmata (in ordine di tmst,
+    // visita in O(n)), poi quella immediata. 0 se index è oltre l'ultimo.
+    size_t formatEntry(uint16_t index, char* out, size_t size) const {
+        int n;
+        if (index < scheduledSize) {
+            uint16_t slot = scheduledAt(index);
+            const DownlinkEntry& entry = entries[slot];
+            n = snprintf(out, size, "Slot %u: DevAddr 0x%08lX, tmst %lu, ToA %lu us, FPort=%u, Token=0x%04X",
+                         slot, (unsigned long)entry.info.devAddr,
+                         (unsigned long)entry.txTmst, (unsigned long)entry.airtimeUs,
+                         entry.info.fport, entry.info.token);
+        } else if (index < scheduledSize + immediateCount) {
+            uint16_t slot = immediateFifo[(immediateHead + index - scheduledSize) % CAPACITY];
+            const DownlinkEntry& entry = entries[slot];
+            n = snprintf(out, size, "Slot %u: DevAddr 0x%08lX, Classe C, FPort=%u, Token=0x%04X",
+                         slot, (unsigned long)entry.info.devAddr,
+                         entry.info.fport, entry.info.token);
+        } else {
+            return 0;
+        }
+        return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+    }
+};
+
+#endif // DOWNLINK_QUEUE_H
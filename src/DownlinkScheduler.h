@@ -0,0 +1,218 @@
+// ===========================
+// SCHEDULER DOWNLINK (timing su txpk.tmst)
+// ===========================
+// Il NS indica l'istante di TX con txpk.tmst, espresso nello stesso contatore
+// libero a 32 bit in µs usato per rxpk.tmst (come il concentratore SX1301,
+// wrap ogni ~71.6 minuti). Lo scheduler decide quando armare il timer
+// one-shot, quanto pre-roll lasciare al radio task e misura l'errore reale
+// di avvio TX.
+//
+// Solo aritmetica sui tmst passati dal chiamante: nessuna dipendenza da
+// Arduino/esp_timer, le stesse formule girano su host con un clock virtuale.
+#ifndef DOWNLINK_SCHEDULER_H
+#define DOWNLINK_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Anticipo della sveglia del timer rispetto all'avvio TX (µs):
+// copre latenza di notifica/scheduling del radio task, poi busy-wait
+#ifndef DOWNLINK_TX_PREROLL_US
+#define DOWNLINK_TX_PREROLL_US 2000
+#endif
+
+// Compensazione fissa tra comando TX e inizio emissione RF (µs)
+#ifndef DOWNLINK_TX_LEAD_US
+#define DOWNLINK_TX_LEAD_US 0
+#endif
+
+// Ritardo massimo tollerato oltre l'istante programmato (µs)
+#ifndef DOWNLINK_TX_LATE_US
+#define DOWNLINK_TX_LATE_US 1000
+#endif
+
+// Anticipo massimo accettato per un txpk.tmst (µs): oltre è un tmst non valido
+#ifndef DOWNLINK_TX_MAX_AHEAD_US
+#define DOWNLINK_TX_MAX_AHEAD_US 10000000
+#endif
+
+// Istogramma dell'errore di avvio TX: bucket lineari con segno (anticipo
+// e ritardo restano distinti), ±DOWNLINK_TX_ERROR_BUCKETS/2 passi attorno
+// a 0, più un bucket per lato fuori scala
+#ifndef DOWNLINK_TX_ERROR_STEP_US
+#define DOWNLINK_TX_ERROR_STEP_US 5
+#endif
+#define DOWNLINK_TX_ERROR_BUCKETS 40
+#define DOWNLINK_TX_ERROR_RANGE_US (DOWNLINK_TX_ERROR_BUCKETS / 2 * DOWNLINK_TX_ERROR_STEP_US)
+
+// ===========================
+// ARITMETICA TMST (wrap-safe)
+// ===========================
+// Distanza con segno target - now, corretta anche a cavallo del wrap
+inline int32_t tmstDelta(uint32_t target, uint32_t now) {
+    return (int32_t)(target - now);
+}
+
+// true se l'istante target è stato raggiunto o superato
+inline bool tmstReached(uint32_t target, uint32_t now) {
+    return tmstDelta(target, now) <= 0;
+}
+
+enum class TxTiming : uint8_t {
+    OK = 0,       // Istante raggiungibile
+    TOO_LATE,     // Istante già passato (oltre la tolleranza)
+    TOO_EARLY     // Istante troppo lontano nel futuro
+};
+
+inline const char* txTimingToString(TxTiming timing) {
+    switch (timing) {
+        case TxTiming::OK:        return "OK";
+        case TxTiming::TOO_LATE:  return "TOO_LATE";
+        case TxTiming::TOO_EARLY: return "TOO_EARLY";
+        default:                  return "UNKNOWN";
+    }
+}
+
+class DownlinkScheduler {
+private:
+    uint32_t preRollUs;
+    uint32_t leadUs;
+    uint32_t lateUs;
+    uint32_t maxAheadUs;
+
+    // Statistiche errore di avvio TX (attuale - programmato)
+    uint32_t txCount = 0;
+    int32_t lastErrorUs = 0;
+    int32_t minErrorUs = 0;
+    int32_t maxErrorUs = 0;
+    uint64_t sumAbsErrorUs = 0;
+    // [0] sotto -RANGE, [1..BUCKETS] un passo ciascuno, [BUCKETS + 1] da +RANGE
+    uint32_t errorBuckets[DOWNLINK_TX_ERROR_BUCKETS + 2] = {};
+
+    static uint8_t errorBucket(int32_t errorUs) {
+        if (errorUs < -DOWNLINK_TX_ERROR_RANGE_US) {
+            return 0;
+        }
+        if (errorUs >= DOWNLINK_TX_ERROR_RANGE_US) {
+            return DOWNLINK_TX_ERROR_BUCKETS + 1;
+        }
+        return (uint8_t)(1 + (errorUs + DOWNLINK_TX_ERROR_RANGE_US) / DOWNLINK_TX_ERROR_STEP_US);
+    }
+
+    // Estremo inferiore (µs) del bucket k in scala
+    static int32_t bucketLowUs(uint8_t k) {
+        return -DOWNLINK_TX_ERROR_RANGE_US + (int32_t)(k - 1) * DOWNLINK_TX_ERROR_STEP_US;
+    }
+
+public:
+    DownlinkScheduler(uint32_t preRollUs = DOWNLINK_TX_PREROLL_US,
+                      uint32_t leadUs = DOWNLINK_TX_LEAD_US,
+                      uint32_t lateUs = DOWNLINK_TX_LATE_US,
+                      uint32_t maxAheadUs = DOWNLINK_TX_MAX_AHEAD_US)
+        : preRollUs(preRollUs), leadUs(leadUs), lateUs(lateUs), maxAheadUs(maxAheadUs) {}
+
+    // Istante in cui dare il comando TX perché l'emissione parta a targetTmst
+    uint32_t txStartTmst(uint32_t targetTmst) const {
+        return targetTmst - leadUs;
+    }
+
+    // Verifica se targetTmst è ancora raggiungibile all'istante now
+    TxTiming check(uint32_t targetTmst, uint32_t now) const {
+        int32_t remaining = tmstDelta(txStartTmst(targetTmst), now);
+        if (remaining < -(int32_t)lateUs) {
+            return TxTiming::TOO_LATE;
+        }
+        if (remaining > (int32_t)maxAheadUs) {
+            return TxTiming::TOO_EARLY;
+        }
+        return TxTiming::OK;
+    }
+
+    // Ritardo (µs) con cui armare il timer one-shot: sveglia preRollUs prima
+    // del comando TX. 0 = siamo già dentro il pre-roll.
+    uint32_t timerDelayUs(uint32_t targetTmst, uint32_t now) const {
+        int32_t remaining = tmstDelta(txStartTmst(targetTmst), now) - (int32_t)preRollUs;
+        return remaining > 0 ? (uint32_t)remaining : 0;
+    }
+
+    // true se mancano al massimo preRollUs al comando TX (busy-wait finale)
+    bool inPreRoll(uint32_t targetTmst, uint32_t now) const {
+        return tmstDelta(txStartTmst(targetTmst), now) <= (int32_t)preRollUs;
+    }
+
+    // Registra l'istante reale del comando TX e ritorna l'errore (µs)
+    int32_t recordTxStart(uint32_t targetTmst, uint32_t actualTmst) {
+        int32_t error = tmstDelta(actualTmst, txStartTmst(targetTmst));
+        if (txCount == 0 || error < minErrorUs) minErrorUs = error;
+        if (txCount == 0 || error > maxErrorUs) maxErrorUs = error;
+        lastErrorUs = error;
+        sumAbsErrorUs += (uint32_t)(error < 0 ? -error : error);
+        errorBuckets[errorBucket(error)]++;
+        txCount++;
+        return error;
+    }
+
+    uint32_t getPreRollUs() const { return preRollUs; }
+    uint32_t getTxCount() const { return txCount; }
+    int32_t getLastErrorUs() const { return lastErrorUs; }
+    int32_t getMinErrorUs() const { return minErrorUs; }
+    int32_t getMaxErrorUs() const { return maxErrorUs; }
+    uint32_t getMeanAbsErrorUs() const {
+        return txCount > 0 ? (uint32_t)(sumAbsErrorUs / txCount) : 0;
+    }
+
+    // Percentile (0-100) dell'errore con segno: estremo superiore del
+    // bucket che lo contiene, limitato a [min, max] osservati
+    int32_t getErrorPercentileUs(uint8_t percent) const {
+        if (txCount == 0) {
+            return 0;
+        }
+        uint32_t rank = (uint32_t)(((uint64_t)txCount * percent + 99) / 100);
+        if (rank == 0) {
+            rank = 1;
+        }
+        uint32_t seen = 0;
+        for (uint8_t k = 0; k < DOWNLINK_TX_ERROR_BUCKETS + 2; k++) {
+            seen += errorBuckets[k];
+            if (seen < rank) {
+                continue;
+            }
+            if (k == 0) {
+                return minErrorUs;
+            }
+            if (k == DOWNLINK_TX_ERROR_BUCKETS + 1) {
+                return maxErrorUs;
+            }
+            int32_t upper = bucketLowUs(k) + DOWNLINK_TX_ERROR_STEP_US - 1;
+            upper = upper > maxErrorUs ? maxErrorUs : upper;
+            return upper < minErrorUs ? minErrorUs : upper;
+        }
+        return maxErrorUs;
+    }
+
+    // Una riga per bucket non vuoto (0 se vuoto o fuori indice):
+    // "[-5, 0) us: 12", "< -100 us: 1", ">= 100 us: 3"
+    size_t formatErrorBucket(uint8_t k, char* out, size_t size) const {
+        if (k >= DOWNLINK_TX_ERROR_BUCKETS + 2 || errorBuckets[k] == 0) {
+            return 0;
+        }
+        int n;
+        if (k == 0) {
+            n = snprintf(out, size, "< %ld us: %lu", (long)-DOWNLINK_TX_ERROR_RANGE_US,
+                         (unsigned long)errorBuckets[k]);
+        } else if (k == DOWNLINK_TX_ERROR_BUCKETS + 1) {
+            n = snprintf(out, size, ">= %ld us: %lu", (long)DOWNLINK_TX_ERROR_RANGE_US,
+                         (unsigned long)errorBuckets[k]);
+        } else {
+            n = snprintf(out, size, "[%ld, %ld) us: %lu", (long)bucketLowUs(k),
+                         (long)(bucketLowUs(k) + DOWNLINK_TX_ERROR_STEP_US),
+                         (unsigned long)errorBuckets[k]);
+        }
+        return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+    }
+
+    static constexpr uint8_t errorBucketCount() { return DOWNLINK_TX_ERROR_BUCKETS + 2; }
+};
+
+#endif // DOWNLINK_SCHEDULER_H
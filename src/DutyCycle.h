@@ -0,0 +1,163 @@
+// ===========================
+// DUTY CYCLE EU868 PER SOTTOBANDA
+// ===========================
+// ETSI EN 300 220 (LoRaWAN RP002, EU863-870) limita il tempo di
+// trasmissione per sottobanda su una finestra di un'ora:
+//
+//   863.0 - 865.0 MHz   0.1%   →   3.6 s/h
+//   865.0 - 868.0 MHz   1%     →  36   s/h
+//   868.0 - 868.6 MHz   1%     →  36   s/h   (868.1/868.3/868.5, RX1)
+//   868.7 - 869.2 MHz   0.1%   →   3.6 s/h
+//   869.4 - 869.65 MHz  10%    → 360   s/h   (869.525, RX2)
+//   869.7 - 870.0 MHz   1%     →  36   s/h
+//
+// Il canale (frequenza ± BW/2) deve stare tutto dentro una sottobanda.
+// La finestra scorrevole è divisa in DUTY_CYCLE_BUCKETS intervalli: il
+// ToA di ogni TX si somma all'intervallo corrente. Si tengono l'ultima
+// ora di intervalli completi più quello corrente, quindi ogni TX
+// dell'ultima ora è contata e la stima è sempre per eccesso (al massimo
+// un intervallo oltre l'ora).
+//
+// Usato solo dal radio task. Il tempo (secondi dall'avvio, senza wrap
+// pratico) arriva dal chiamante: compila anche su host.
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DUTY_CYCLE_WINDOW_S 3600UL
+
+#ifndef DUTY_CYCLE_BUCKETS
+#define DUTY_CYCLE_BUCKETS 60      // Intervalli da 1 minuto
+#endif
+
+#define DUTY_CYCLE_BUCKET_S (DUTY_CYCLE_WINDOW_S / DUTY_CYCLE_BUCKETS)
+#define DUTY_CYCLE_SLOTS (DUTY_CYCLE_BUCKETS + 1)   // Ora completa + intervallo corrente
+
+struct DutyCycleBand {
+    uint32_t minHz;
+    uint32_t maxHz;
+    uint32_t budgetUs;    // Tempo di TX ammesso nella finestra
+};
+
+#define EU868_SUB_BANDS 6
+
+static const DutyCycleBand EU868_BANDS[EU868_SUB_BANDS] = {
+    { 863000000UL, 865000000UL,   3600000UL },   // 0.1%
+    { 865000000UL, 868000000UL,  36000000UL },   // 1%
+    { 868000000UL, 868600000UL,  36000000UL },   // 1%
+    { 868700000UL, 869200000UL,   3600000UL },   // 0.1%
+    { 869400000UL, 869650000UL, 360000000UL },   // 10%
+    { 869700000UL, 870000000UL,  36000000UL }    // 1%
+};
+
+enum class DutyCycleResult : uint8_t {
+    OK = 0,
+    NO_BAND,        // Canale fuori da tutte le sottobande
+    OVER_BUDGET     // La TX supererebbe il budget della sottobanda
+};
+
+inline const char* dutyCycleResultToString(DutyCycleResult result) {
+    switch (result) {
+        case DutyCycleResult::OK:          return "OK";
+        case DutyCycleResult::NO_BAND:     return "NO_BAND";
+        case DutyCycleResult::OVER_BUDGET: return "OVER_BUDGET";
+        default:                           return "UNKNOWN";
+    }
+}
+
+// Indice della sottobanda che contiene tutto il canale, -1 se nessuna
+inline int8_t eu868SubBand(uint32_t freqHz, uint32_t bwHz) {
+    uint32_t half = bwHz / 2;
+    for (uint8_t i = 0; i < EU868_SUB_BANDS; i++) {
+        if (freqHz >= EU868_BANDS[i].minHz + half && freqHz <= EU868_BANDS[i].maxHz - half) {
+            return (int8_t)i;
+        }
+    }
+    return -1;
+}
+
+class DutyCycleLedger {
+private:
+    uint32_t buckets[EU868_SUB_BANDS][DUTY_CYCLE_SLOTS] = {};
+    uint32_t currentBucket = 0;    // Numero assoluto dell'intervallo corrente
+    bool started = false;
+
+    // Contatori
+    uint32_t rejected[EU868_SUB_BANDS] = {};
+
+    // Porta la finestra a nowS azzerando gli intervalli usciti
+    void advance(uint32_t nowS) {
+        uint32_t bucket = nowS / DUTY_CYCLE_BUCKET_S;
+        if (!started) {
+            currentBucket = bucket;
+            started = true;
+            return;
+        }
+        uint32_t elapsed = bucket - currentBucket;
+        if (elapsed == 0) {
+            return;
+        }
+        if (elapsed > DUTY_CYCLE_SLOTS) {
+            elapsed = DUTY_CYCLE_SLOTS;
+        }
+        for (uint32_t i = 1; i <= elapsed; i++) {
+            uint32_t slot = (currentBucket + i) % DUTY_CYCLE_SLOTS;
+            for (uint8_t band = 0; band < EU868_SUB_BANDS; band++) {
+                buckets[band][slot] = 0;
+            }
+        }
+        currentBucket = bucket;
+    }
+
+public:
+    // Tempo di TX nella finestra (µs)
+    uint32_t usedUs(int8_t band, uint32_t nowS) {
+        if (band < 0 || band >= EU868_SUB_BANDS) {
+            return 0;
+        }
+        advance(nowS);
+        return getUsedUs(band);
+    }
+
+    // La TX di airtimeUs starebbe nel budget? Non registra nulla
+    DutyCycleResult check(int8_t band, uint32_t airtimeUs, uint32_t nowS) {
+        if (band < 0 || band >= EU868_SUB_BANDS) {
+            return DutyCycleResult::NO_BAND;
+        }
+        if ((uint64_t)usedUs(band, nowS) + airtimeUs > EU868_BANDS[band].budgetUs) {
+            rejected[band]++;
+            return DutyCycleResult::OVER_BUDGET;
+        }
+        return DutyCycleResult::OK;
+    }
+
+    // Da chiamare per ogni TX partita
+    void record(int8_t band, uint32_t airtimeUs, uint32_t nowS) {
+        if (band < 0 || band >= EU868_SUB_BANDS) {
+            return;
+        }
+        advance(nowS);
+        buckets[band][currentBucket % DUTY_CYCLE_SLOTS] += airtimeUs;
+    }
+
+    // Come usedUs() ma senza far scorrere la finestra (lettura da altri
+    // task per le statistiche): al più qualche intervallo scaduto in più
+    uint32_t getUsedUs(int8_t band) const {
+        if (band < 0 || band >= EU868_SUB_BANDS) {
+            return 0;
+        }
+        uint32_t sum = 0;
+        for (uint8_t i = 0; i < DUTY_CYCLE_SLOTS; i++) {
+            sum += buckets[band][i];
+        }
+        return sum;
+    }
+
+    uint32_t getRejected(int8_t band) const {
+        return (band >= 0 && band < EU868_SUB_BANDS) ? rejected[band] : 0;
+    }
+};
+
+#endif // DUTY_CYCLE_H
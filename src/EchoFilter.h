@@ -0,0 +1,152 @@
+// ===========================
+// SOPPRESSIONE DELL'ECO DEI DOWNLINK
+// ===========================
+// Dopo una TX il gateway scartava il primo pacchetto ricevuto, qualunque
+// fosse: un uplink vero subito dopo un downlink andava perso. Ora ogni
+// TX riuscita lascia un record (hash FNV-1a del payload, lunghezza,
+// inizio e fine TX) in un ring di N voci, e si distinguono due casi:
+//
+// - Fronte della nostra TX: un evento IRQ senza pacchetto (NONE/TxDone)
+//   con tmst dentro [inizio TX, fine TX + margine]. È il TxDone della
+//   trasmissione stessa, non traffico: si ignora senza riavviare l'RX.
+// - Eco: un frame ricevuto entro ECHO_WINDOW_US dalla fine di una TX con
+//   stessa lunghezza e stesso hash (nostro downlink ritrasmesso o
+//   ricevuto di riflesso). Va soppresso.
+//
+// Tutto il resto è traffico reale. Il primo frame reale dopo ogni TX è
+// contato come "conservato": è quello che la vecchia logica scartava.
+// Usato solo dal radio task. Il tempo arriva dal chiamante (tmst in us):
+// compila anche su host.
+#ifndef ECHO_FILTER_H
+#define ECHO_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Finestra dopo la fine della TX in cui un frame identico è un eco
+#ifndef ECHO_WINDOW_US
+#define ECHO_WINDOW_US 2000000UL
+#endif
+
+// Tolleranza sul fronte TxDone oltre la fine TX misurata dal task
+#ifndef ECHO_TX_EDGE_MARGIN_US
+#define ECHO_TX_EDGE_MARGIN_US 1000
+#endif
+
+// FNV-1a a 32 bit: nessuna tabella, un byte per iterazione
+inline uint32_t echoHash(const uint8_t* data, size_t length) {
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+enum class EchoVerdict : uint8_t {
+    REAL = 0,    // Traffico reale: da inoltrare
+    ECHO         // Copia di un nostro downlink recente: da sopprimere
+};
+
+inline const char* echoVerdictToString(EchoVerdict verdict) {
+    switch (verdict) {
+        case EchoVerdict::REAL: return "REAL";
+        case EchoVerdict::ECHO: return "ECHO";
+        default:                return "UNKNOWN";
+    }
+}
+
+template <size_t N>
+class EchoFilter {
+    static_assert(N > 0 && N <= 255, "EchoFilter: da 1 a 255 voci");
+
+private:
+    struct TxRecord {
+        uint32_t hash;
+        uint32_t start;     // tmst inizio TX
+        uint32_t end;       // tmst fine TX (TxDone)
+        uint16_t length;
+        bool valid;
+    };
+
+    TxRecord records[N] = {};
+    uint8_t next = 0;
+    bool firstRxPending = false;   // Nessun frame ricevuto dall'ultima TX
+    uint32_t lastEchoAgeUs = 0;
+
+    // Contatori
+    uint32_t txEdges = 0;          // Fronti IRQ della nostra TX
+    uint32_t echoes = 0;           // Frame soppressi come eco
+    uint32_t preserved = 0;        // Primi frame reali dopo una TX
+
+public:
+    // Da chiamare dopo ogni TX riuscita
+    void recordTx(const uint8_t* data, size_t length, uint32_t start, uint32_t end) {
+        recordTx(echoHash(data, length), length, start, end);
+    }
+
+    // Con l'hash già calcolato (payload non più disponibile a fine TX)
+    void recordTx(uint32_t hash, size_t length, uint32_t start, uint32_t end) {
+        TxRecord& record = records[next];
+        record.hash = hash;
+        record.start = start;
+        record.end = end;
+        record.length = (uint16_t)length;
+        record.valid = true;
+        next = (uint8_t)((next + 1) % N);
+        firstRxPending = true;
+    }
+
+    // true se un evento IRQ senza pacchetto cade dentro una nostra TX
+    bool isTxEdge(uint32_t irqTmst) {
+        for (size_t i = 0; i < N; i++) {
+            const TxRecord& record = records[i];
+            if (record.valid && (int32_t)(irqTmst - record.start) >= 0 &&
+                (int32_t)(irqTmst - record.end) <= (int32_t)ECHO_TX_EDGE_MARGIN_US) {
+                txEdges++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Confronta un frame ricevuto (tmst di RxDone) con le TX recenti
+    EchoVerdict check(const uint8_t* data, size_t length, uint32_t rxTmst) {
+        uint32_t hash = 0;
+        bool hashed = false;
+        for (size_t i = 0; i < N; i++) {
+            const TxRecord& record = records[i];
+            if (!record.valid || record.length != length) {
+                continue;
+            }
+            int32_t age = (int32_t)(rxTmst - record.end);
+            if (age < 0 || age > (int32_t)ECHO_WINDOW_US) {
+                continue;
+            }
+            if (!hashed) {
+                hash = echoHash(data, length);  // Solo se lunghezza e tempo tornano
+                hashed = true;
+            }
+            if (record.hash == hash) {
+                echoes++;
+                lastEchoAgeUs = (uint32_t)age;
+                return EchoVerdict::ECHO;
+            }
+        }
+        if (firstRxPending) {
+            preserved++;
+            firstRxPending = false;
+        }
+        return EchoVerdict::REAL;
+    }
+
+    // us tra la fine della TX e l'ultimo eco soppresso
+    uint32_t getLastEchoAgeUs() const { return lastEchoAgeUs; }
+
+    uint32_t getTxEdges() const { return txEdges; }
+    uint32_t getEchoes() const { return echoes; }
+    uint32_t getPreserved() const { return preserved; }
+    static constexpr size_t capacity() { return N; }
+};
+
+#endif // ECHO_FILTER_H
@@ -0,0 +1,244 @@
+// ===========================
+// LOG A LIVELLI + LOG BINARIO DIFFERITO
+// ===========================
+// Due strumenti complementari:
+//
+// 1. LOG_E/W/I/D/V: printf sincroni filtrati a compile-time. Sotto
+//    LOG_LEVEL la chiamata sparisce del tutto (argomenti compresi).
+//
+// 2. LOG_DEFER: per i percorsi caldi (RX, TX, PULL_RESP). Registra solo
+//    ID del messaggio + tmst + fino a LOG_MAX_ARGS interi a 32 bit in un
+//    ring SPSC lock-free (~30 ns, nessun accesso a Serial). Un task a
+//    bassa priorità svuota i ring e formatta il testo fuori dal percorso
+//    critico: una scrittura USB-CDC bloccata non ritarda più la radio.
+//
+// I messaggi differiti sono definiti una sola volta in LOG_MESSAGES:
+// ID, tipo degli argomenti ('u' senza segno, 'd' con segno) e formato
+// printf con soli %lu/%ld/%lX. Lo stesso elenco è letto da
+// tools/log_decode.py per ricostruire il testo dai frame binari
+// (LOG_FLUSH_BINARY=1): NON riordinare le voci, aggiungere in coda.
+//
+// Dipende solo da SpscRing.h e dagli header C: compila anche su host.
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "SpscRing.h"
+
+#define LOG_LEVEL_NONE    0
+#define LOG_LEVEL_ERROR   1
+#define LOG_LEVEL_WARN    2
+#define LOG_LEVEL_INFO    3
+#define LOG_LEVEL_DEBUG   4
+#define LOG_LEVEL_VERBOSE 5
+
+// Livello massimo compilato (sovrascrivibile da config.h o build_flags)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// 1 = il task di log scrive frame binari (da decodificare su host),
+// 0 = scrive testo già formattato
+#ifndef LOG_FLUSH_BINARY
+#define LOG_FLUSH_BINARY 0
+#endif
+
+#ifndef LOG_PRINTF
+#define LOG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#endif
+
+#define LOG_AT(level, ...) do { if (LOG_LEVEL >= (level)) { LOG_PRINTF(__VA_ARGS__); } } while (0)
+#define LOG_E(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_W(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_I(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_D(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_V(...) LOG_AT(LOG_LEVEL_VERBOSE, __VA_ARGS__)
+
+// ===========================
+// MESSAGGI DIFFERITI
+// ===========================
+#define LOG_MESSAGES(X) \
+    X(RX_IRQ,            "uuu",   "[RX] Interrupt #%lu (seq %lu, IRQ 0x%04lX)") \
+    X(RX_ECHO_IGNORED,   "uu",    "[RX] Evento IRQ seq %lu dentro la nostra TX (TxDone), ignorato (totale %lu)") \
+    X(RX_FRAME,          "udduu", "[RX] %lu bytes, RSSI %ld dBm, SNR %ld/10 dB, tmst %lu (letto dopo %lu us)") \
+    X(RX_HEADER,         "uuuuu", "[RX] DevAddr 0x%08lX, FCnt %lu, MHDR 0x%02lX, FCtrl 0x%02lX, FOptsLen %lu") \
+    X(RX_RING_FULL,      "",      "[RX] Ring uplink pieno, pacchetto non inoltrato") \
+    X(RX_TIMEOUT,        "u",     "[RX] Timeout (totale: %lu)") \
+    X(RX_CRC_ERROR,      "u",     "[RX] CRC ERROR (totale: %lu)") \
+    X(RX_ERROR,          "du",    "[RX] Errore %ld (totale altri errori: %lu)") \
+    X(RXWIN_OPEN,        "uu",    "[RXWIN] Finestre RX aperte per 0x%08lX (%lu attive)") \
+    X(RXWIN_FULL,        "",      "[RXWIN] Tabella finestre RX piena, downlink non possibile") \
+    X(RXWIN_EXPIRED,     "u",     "[RXWIN] %lu finestra/e RX scaduta/e senza PULL_RESP") \
+    X(QUEUE_CLASS_C,     "uu",    "[QUEUE] Downlink Classe C per 0x%08lX in coda (ToA %lu us)") \
+    X(QUEUE_SCHEDULED,   "uudu",  "[QUEUE] Downlink per 0x%08lX programmato a tmst %lu (tra %ld us, ToA %lu us)") \
+    X(QUEUE_NO_WINDOW,   "u",     "[QUEUE] Downlink per 0x%08lX scartato: ne' tmst ne' uplink recente") \
+    X(QUEUE_TIMING,      "uuuu",  "[QUEUE] Downlink per 0x%08lX scartato: TxTiming %lu (tmst %lu, ora %lu)") \
+    X(QUEUE_REJECTED,    "uu",    "[QUEUE] Downlink per 0x%08lX scartato: QueueResult %lu") \
+    X(TX_DONE,           "udduu", "[TX_DL] tmst %lu, errore avvio %ld us, stato %ld, %lu bytes, TX %lu us") \
+    X(TX_UPLINK_DELAY,   "u",     "[TX_DL] Ritardo da uplink: %lu us") \
+    X(TX_NOT_READY,      "",      "[TX_DL] Radio non inizializzata") \
+    X(TX_MISSED,         "ud",    "[DOWNLINK] Token 0x%04lX: istante TX perso di %ld us, TX_ACK TOO_LATE") \
+    X(TX_CLASS_C,        "ud",    "[PULL] Classe C token 0x%04lX trasmesso, stato %ld") \
+    X(RX_RESTART_ERROR,  "d",     "[LORA] Errore riavvio ricezione: %ld") \
+    X(PULL_RESP_QUEUED,  "uuuu",  "[PULL_RESP] Token 0x%04lX, DevAddr 0x%08lX, %lu bytes nel ring (arrivo -> coda %lu us)") \
+    X(PULL_RESP_RING_FULL, "",    "[PULL_RESP] Scartato: ring downlink pieno") \
+    X(PULL_RESP_INVALID, "",      "[PULL_RESP] Scartato: errore parsing txpk") \
+    X(NET_STALL,         "uuu",   "[STALL] network: iterazione %lu us oltre il budget, sezione #%lu (%lu us)") \
+    X(RX_IRQ_STALE,      "uu",    "[RX] Evento IRQ seq %lu senza flag (gia' gestito), totale %lu") \
+    X(RX_HEADER_ERROR,   "u",     "[RX] Header LoRa non valido (totale: %lu)") \
+    X(RX_IRQ_UNEXPECTED, "u",     "[RX] IRQ non gestito 0x%04lX") \
+    X(RX_READOUT_ERROR,  "u",     "[RX] Lettura pacchetto fallita: RxReadoutResult %lu") \
+    X(RX_SIGNAL,         "ddu",   "[RX] RSSI segnale %ld dBm, errore frequenza %ld Hz, %lu transazioni SPI") \
+    X(RX_ECHO_SUPPRESSED, "uuu",  "[RX] Eco del downlink soppresso: %lu bytes, %lu us dopo la TX (totale %lu)") \
+    X(TX_START_FAILED,   "ud",    "[TX_DL] Token 0x%04lX: startTransmit fallito, stato %ld") \
+    X(TX_TIMEOUT,        "uuu",   "[TX_DL] Token 0x%04lX: nessun TxDone dopo %lu us (ToA %lu us), TX chiusa") \
+    X(RADIO_STALL,       "uuu",   "[STALL] radio: iterazione %lu us oltre il budget, sezione #%lu (%lu us)") \
+    X(TX_PREPARE_LATE,   "uuu",   "[TX_DL] Token 0x%04lX: preparazione %lu us, pronta %lu us dopo l'istante TX, annullata") \
+    X(RADIO_PROFILE_ERROR, "uu",  "[RADIO] Token 0x%04lX: cambio profilo fallito, RadioProfileResult %lu") \
+    X(QUEUE_TX_PARAMS,   "uu",    "[QUEUE] Downlink per 0x%08lX scartato: parametri txpk non supportati, TxAckError %lu") \
+    X(QUEUE_DUTY_CYCLE,  "uuuu",  "[QUEUE] Downlink per 0x%08lX scartato: duty cycle sottobanda %lu esaurito (usati %lu us, ToA %lu us)") \
+    X(TX_DUTY_CYCLE,     "uuu",   "[TX_DL] Token 0x%04lX: duty cycle sottobanda %lu esaurito (usati %lu us), TX annullata") \
+    X(UL_FORWARDED,      "uuu",   "[GW] PUSH_DATA inoltrato: tmst %lu, payload %lu bytes, datagram %lu bytes") \
+    X(UDP_NOT_CONNECTED, "u",     "[UDP] WiFi non connesso, datagram tipo 0x%02lX non inviato") \
+    X(UDP_SEND_ERROR,    "uud",   "[UDP] sendto fallito: datagram tipo 0x%02lX, %lu bytes, errno %ld") \
+    X(PULL_DATA_SENT,    "u",     "[PULL] PULL_DATA inviato in %lu us") \
+    X(TX_ACK_SENT,       "uuud",  "[TX_ACK] Token 0x%04lX: TxAckError %lu, avviso TX_POWER %lu (%ld dBm)") \
+    X(TX_ACK_RING_FULL,  "uu",    "[TX_ACK] Ring TX_ACK pieno, token 0x%04lX perso (totale %lu)") \
+    X(UDP_RX_TRUNCATED,  "uu",    "[UDP_RX] Datagram oltre %lu bytes scartato (totale %lu)") \
+    X(UDP_RX_INVALID,    "uu",    "[UDP_RX] Header Semtech non valido, %lu bytes scartati (totale %lu)") \
+    X(UDP_RX_UNHANDLED,  "uu",    "[UDP_RX] Tipo messaggio 0x%02lX non gestito, token 0x%04lX") \
+    X(PULL_RESP_PARSE_ERROR, "uuuu", "[PULL_RESP] Token 0x%04lX scartato: TxpkParseResult %lu, Base64Result %lu, %lu bytes decodificati") \
+    X(PULL_RESP_INFO,    "uuuu",  "[PULL_RESP] Token 0x%04lX: FPort %lu, MAC command %lu, Classe C %lu") \
+    X(QUEUE_STATE,       "uuu",   "[QUEUE] Elementi nella coda: %lu/%lu (immediati %lu)") \
+    X(UL_TOO_LARGE,      "uuu",   "[GW] rxpk oltre %lu bytes: tmst %lu, payload %lu bytes, PUSH_DATA non inviato") \
+    X(STAT_SENT,         "uuuuu", "[STAT] stat inviato: rxnb %lu, rxok %lu, rxfw %lu, dwnb %lu, txnb %lu") \
+    X(TX_TIMER_START_ERROR, "uud", "[TX_DL] esp_timer_start_once fallito: tmst TX %lu, ritardo %lu us, errore %ld") \
+    X(TX_TIMER_STOP_ERROR, "d",   "[TX_DL] esp_timer_stop fallito: errore %ld")
+
+#define LOG_ENUM_ENTRY(id, types, format) id,
+enum class LogId : uint16_t {
+    LOG_MESSAGES(LOG_ENUM_ENTRY)
+    COUNT
+};
+#undef LOG_ENUM_ENTRY
+
+struct LogFormat {
+    const char* types;   // Un carattere per argomento: 'u' o 'd'
+    const char* format;
+};
+
+#define LOG_FORMAT_ENTRY(id, types, format) {types, format},
+constexpr LogFormat LOG_FORMATS[] = {
+    LOG_MESSAGES(LOG_FORMAT_ENTRY)
+};
+#undef LOG_FORMAT_ENTRY
+
+static_assert(sizeof(LOG_FORMATS) / sizeof(LOG_FORMATS[0]) == (size_t)LogId::COUNT,
+              "LOG_FORMATS non allineata a LogId");
+
+// ===========================
+// RECORD BINARIO
+// ===========================
+#define LOG_MAX_ARGS 5
+
+// 28 byte, layout fisso (little-endian): è anche il frame binario
+struct LogEntry {
+    uint32_t tmst;
+    uint16_t id;
+    uint8_t argc;
+    uint8_t reserved;
+    uint32_t args[LOG_MAX_ARGS];
+};
+
+static_assert(sizeof(LogEntry) == 28, "LogEntry: layout del frame binario cambiato");
+
+// Byte di sincronismo prima di ogni LogEntry in modalità binaria
+#define LOG_FRAME_SYNC0 0xA5
+#define LOG_FRAME_SYNC1 0x5A
+
+// Formatta un record in testo (senza newline). Ritorna i caratteri scritti.
+inline size_t logFormatEntry(const LogEntry& entry, char* out, size_t size) {
+    if (entry.id >= (uint16_t)LogId::COUNT) {
+        int n = snprintf(out, size, "[%lu] [LOG] ID sconosciuto %u",
+                         (unsigned long)entry.tmst, (unsigned)entry.id);
+        return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+    }
+
+    // Argomenti estesi a long secondo il tipo: %lu/%ld corretti anche su
+    // host a 64 bit
+    const LogFormat& fmt = LOG_FORMATS[entry.id];
+    long values[LOG_MAX_ARGS] = {0};
+    for (uint8_t i = 0; i < entry.argc && i < LOG_MAX_ARGS && fmt.types[i] != '\0'; i++) {
+        values[i] = (fmt.types[i] == 'd') ? (long)(int32_t)entry.args[i]
+                                          : (long)(unsigned long)entry.args[i];
+    }
+
+    int prefix = snprintf(out, size, "[%lu] ", (unsigned long)entry.tmst);
+    if (prefix < 0 || (size_t)prefix >= size) {
+        return 0;
+    }
+    int n = snprintf(out + prefix, size - prefix, fmt.format,
+                     values[0], values[1], values[2], values[3], values[4]);
+    if (n < 0) {
+        return 0;
+    }
+    size_t total = (size_t)prefix + (size_t)n;
+    return total < size ? total : size - 1;
+}
+
+// ===========================
+// RING DI LOG (un produttore)
+// ===========================
+// Un ring per task produttore (SPSC): il consumatore è il task di log.
+template <size_t N>
+class LogRing {
+private:
+    SpscRing<LogEntry, N> ring;
+    uint32_t dropped = 0;  // Scritto solo dal produttore
+
+    static void store(uint32_t* args, uint8_t& argc) {}
+
+    template <typename T, typename... Rest>
+    static void store(uint32_t* args, uint8_t& argc, T value, Rest... rest) {
+        args[argc++] = (uint32_t)value;
+        store(args, argc, rest...);
+    }
+
+public:
+    template <typename... Args>
+    void record(LogId id, uint32_t tmst, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "LogRing: troppi argomenti");
+        LogEntry* entry = ring.reserve();
+        if (entry == nullptr) {
+            dropped++;  // Ring pieno: si perde il log, mai la radio
+            return;
+        }
+        entry->tmst = tmst;
+        entry->id = (uint16_t)id;
+        entry->argc = 0;
+        entry->reserved = 0;
+        store(entry->args, entry->argc, args...);
+        ring.commit();
+    }
+
+    // ----- LATO CONSUMATORE -----
+    const LogEntry* front() { return ring.front(); }
+    void release() { ring.release(); }
+
+    uint32_t getDropped() const { return dropped; }
+    static constexpr size_t capacity() { return N; }
+};
+
+// Registra un messaggio differito se il livello è compilato.
+// LOG_TIMESTAMP() va definito prima dell'include (es. tmstNow()).
+#ifndef LOG_TIMESTAMP
+#define LOG_TIMESTAMP() 0
+#endif
+
+#define LOG_DEFER(ring, level, id, ...) \
+    do { if (LOG_LEVEL >= (level)) { (ring).record(LogId::id, LOG_TIMESTAMP(), ##__VA_ARGS__); } } while (0)
+
+#endif // LOG_H
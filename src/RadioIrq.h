@@ -0,0 +1,108 @@
+// ===========================
+// CODA DEGLI EVENTI IRQ DELLA RADIO (ISR → radio task)
+// ===========================
+// Ogni fronte di DIO1 diventa un evento nel ring SPSC: la ISR registra
+// solo tmst e numero di sequenza, il radio task li consuma in ordine.
+// Se il ring è pieno l'evento è perso ma contato (overrun): nessun
+// fronte sparisce in silenzio come con un solo flag/bit.
+//
+// Lo stato IRQ dell'SX126x si legge via SPI, vietato nella ISR (bus
+// condiviso con il task): il consumatore lo cattura per primo, prima di
+// readData(), e lo classifica (RxDone, CRC, header, timeout, TxDone).
+// Un evento il cui stato è già stato consumato da un readData()/clear
+// precedente (burst di fronti ravvicinati) risulta NONE: va contato, non
+// trattato come un nuovo pacchetto.
+//
+// Dipende solo da SpscRing.h: compila anche su host.
+#ifndef RADIO_IRQ_H
+#define RADIO_IRQ_H
+
+#include <stdint.h>
+#include "SpscRing.h"
+
+// Bit del registro IRQ SX126x (datasheet, tabella 13-29)
+#define SX126X_IRQ_TX_DONE         0x0001
+#define SX126X_IRQ_RX_DONE         0x0002
+#define SX126X_IRQ_PREAMBLE        0x0004
+#define SX126X_IRQ_SYNC_WORD_VALID 0x0008
+#define SX126X_IRQ_HEADER_VALID    0x0010
+#define SX126X_IRQ_HEADER_ERR      0x0020
+#define SX126X_IRQ_CRC_ERR         0x0040
+#define SX126X_IRQ_CAD_DONE        0x0080
+#define SX126X_IRQ_CAD_DETECTED    0x0100
+#define SX126X_IRQ_TIMEOUT         0x0200
+
+enum class RadioIrqKind : uint8_t {
+    RX_DONE = 0,     // Pacchetto valido da leggere
+    CRC_ERROR,       // RxDone con CRC errato
+    HEADER_ERROR,    // Header LoRa non valido (nessun payload)
+    TIMEOUT,         // Timeout RX
+    TX_DONE,         // Fine trasmissione
+    NONE,            // Nessun flag: già consumato da un evento precedente
+    OTHER            // Flag non gestiti (preamble, CAD, ...)
+};
+
+inline const char* radioIrqKindToString(RadioIrqKind kind) {
+    switch (kind) {
+        case RadioIrqKind::RX_DONE:      return "RX_DONE";
+        case RadioIrqKind::CRC_ERROR:    return "CRC_ERROR";
+        case RadioIrqKind::HEADER_ERROR: return "HEADER_ERROR";
+        case RadioIrqKind::TIMEOUT:      return "TIMEOUT";
+        case RadioIrqKind::TX_DONE:      return "TX_DONE";
+        case RadioIrqKind::NONE:         return "NONE";
+        case RadioIrqKind::OTHER:        return "OTHER";
+        default:                         return "UNKNOWN";
+    }
+}
+
+// Priorità: un errore accompagna RxDone, quindi si controlla prima
+inline RadioIrqKind classifyRadioIrq(uint16_t status) {
+    if (status & SX126X_IRQ_CRC_ERR)    return RadioIrqKind::CRC_ERROR;
+    if (status & SX126X_IRQ_HEADER_ERR) return RadioIrqKind::HEADER_ERROR;
+    if (status & SX126X_IRQ_RX_DONE)    return RadioIrqKind::RX_DONE;
+    if (status & SX126X_IRQ_TIMEOUT)    return RadioIrqKind::TIMEOUT;
+    if (status & SX126X_IRQ_TX_DONE)    return RadioIrqKind::TX_DONE;
+    if (status == 0)                    return RadioIrqKind::NONE;
+    return RadioIrqKind::OTHER;
+}
+
+struct RadioIrqEvent {
+    uint32_t tmst;       // Catturato nella ISR al fronte DIO1
+    uint16_t seq;        // Numero di sequenza (solo eventi accodati)
+    uint16_t status;     // Registro IRQ, letto dal consumatore
+};
+
+template <size_t N>
+class RadioIrqQueue {
+private:
+    SpscRing<RadioIrqEvent, N> ring;
+    volatile uint32_t overruns = 0;   // Scritto solo dalla ISR
+    uint16_t nextSeq = 0;             // Solo ISR
+
+public:
+    // ----- LATO ISR -----
+    // Ritorna false (e conta l'overrun) se il ring è pieno
+    SPSC_INLINE bool pushFromIsr(uint32_t tmst) {
+        RadioIrqEvent* event = ring.reserve();
+        if (event == nullptr) {
+            overruns = overruns + 1;
+            return false;
+        }
+        event->tmst = tmst;
+        event->seq = nextSeq++;
+        event->status = 0;
+        ring.commit();
+        return true;
+    }
+
+    // ----- LATO RADIO TASK -----
+    // Il puntatore resta valido (e modificabile: status) fino a release()
+    RadioIrqEvent* front() { return ring.front(); }
+    void release() { ring.release(); }
+    bool isEmpty() const { return ring.isEmpty(); }
+
+    uint32_t getOverruns() const { return overruns; }
+    static constexpr size_t capacity() { return N; }
+};
+
+#endif // RADIO_IRQ_H
@@ -0,0 +1,245 @@
+// ===========================
+// PROFILI RADIO + CACHE DEI REGISTRI (SX126x)
+// ===========================
+// Un profilo raccoglie i parametri che distinguono un downlink dall'RX
+// del gateway: frequenza, SF/BW/CR, potenza e polarità IQ (dal txpk:
+// freq, datr, codr, powe, ipol). RadioShadow tiene una copia dello stato
+// della radio e apply() scrive solo i gruppi che cambiano:
+//
+//   SetRfFrequency        frequenza
+//   SetModulationParams   SF, BW, CR, LDRO
+//   SetTxParams           potenza (solo profili TX), rampa 200 us
+//   registro IQ (0x0736)  bit 2: letto una volta, poi solo scritto
+//
+// Un downlink RX1 (stessi parametri dell'uplink) cambia solo IQ; un RX2
+// a 869.525 MHz SF12 scrive frequenza e modulazione, e il ritorno all'RX
+// le riscrive. Ogni gruppo saltato è una scrittura SPI risparmiata.
+// 863-870 MHz resta una sola banda di calibrazione immagine: nessuna
+// CalibrateImage tra i canali EU868.
+//
+// Lo stato di RadioLib non viene aggiornato: chi chiama startReceive()
+// (che riscrive i parametri pacchetto e rimette l'IQ standard) deve
+// segnalarlo con rxRestarted(). Bus come in TxStaging.h; solo
+// aritmetica intera: compila anche su host.
+#ifndef RADIO_PROFILE_H
+#define RADIO_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Airtime.h"
+
+#define SX126X_CMD_SET_RF_FREQUENCY       0x86
+#define SX126X_CMD_SET_MODULATION_PARAMS  0x8B
+#define SX126X_CMD_SET_TX_PARAMS          0x8E
+#define SX126X_PA_RAMP_200U               0x04
+#define SX126X_XTAL_FREQ_HZ               32000000ULL
+
+#ifndef SX126X_CMD_READ_REGISTER
+#define SX126X_CMD_READ_REGISTER          0x1D
+#endif
+#ifndef SX126X_CMD_WRITE_REGISTER
+#define SX126X_CMD_WRITE_REGISTER         0x0D
+#endif
+#ifndef SX126X_REG_IQ_POLARITY
+#define SX126X_REG_IQ_POLARITY            0x0736
+#endif
+
+// Potenza accettata dall'SX1262 (PA ad alta potenza)
+#define SX1262_POWER_MIN_DBM (-9)
+#define SX1262_POWER_MAX_DBM 22
+
+struct RadioProfile {
+    uint32_t freqHz = 0;
+    uint8_t sf = 0;           // 5..12
+    uint16_t bwKHz = 0;       // 125, 250, 500
+    uint8_t crDenom = 0;      // 4/5..4/8
+    int8_t powerDbm = 0;      // Solo per i profili TX
+    bool invertIq = false;
+
+    bool sameFrequency(const RadioProfile& other) const { return freqHz == other.freqHz; }
+    bool sameModulation(const RadioProfile& other) const {
+        return sf == other.sf && bwKHz == other.bwKHz && crDenom == other.crDenom;
+    }
+};
+
+enum class RadioProfileResult : uint8_t {
+    OK = 0,
+    INVALID_PARAMS,    // SF, BW o CR non validi: nessuna scrittura
+    FREQUENCY_ERROR,
+    MODULATION_ERROR,
+    POWER_ERROR,
+    IQ_ERROR
+};
+
+inline const char* radioProfileResultToString(RadioProfileResult result) {
+    switch (result) {
+        case RadioProfileResult::OK:               return "OK";
+        case RadioProfileResult::INVALID_PARAMS:   return "INVALID_PARAMS";
+        case RadioProfileResult::FREQUENCY_ERROR:  return "FREQUENCY_ERROR";
+        case RadioProfileResult::MODULATION_ERROR: return "MODULATION_ERROR";
+        case RadioProfileResult::POWER_ERROR:      return "POWER_ERROR";
+        case RadioProfileResult::IQ_ERROR:         return "IQ_ERROR";
+        default:                                   return "UNKNOWN";
+    }
+}
+
+// Codice BW di SetModulationParams (0xFF = non supportata)
+inline uint8_t sx126xBandwidthCode(uint16_t bwKHz) {
+    switch (bwKHz) {
+        case 125: return 0x04;
+        case 250: return 0x05;
+        case 500: return 0x06;
+        default:  return 0xFF;
+    }
+}
+
+// Registro di frequenza: freq * 2^25 / Fxtal
+inline uint32_t sx126xFrequencyRegister(uint32_t freqHz) {
+    return (uint32_t)(((uint64_t)freqHz << 25) / SX126X_XTAL_FREQ_HZ);
+}
+
+inline int8_t sx1262ClampPower(int8_t powerDbm, int8_t maxDbm) {
+    if (maxDbm > SX1262_POWER_MAX_DBM) {
+        maxDbm = SX1262_POWER_MAX_DBM;
+    }
+    if (powerDbm > maxDbm) {
+        return maxDbm;
+    }
+    return powerDbm < SX1262_POWER_MIN_DBM ? (int8_t)SX1262_POWER_MIN_DBM : powerDbm;
+}
+
+// Scritture SPI di un cambio di profilo
+struct RadioSwitchCount {
+    uint8_t writes = 0;      // Transazioni eseguite
+    uint8_t saved = 0;       // Saltate perché il valore era già quello
+};
+
+class RadioShadow {
+private:
+    RadioProfile current;
+    bool frequencyKnown = false;
+    bool modulationKnown = false;
+    bool powerKnown = false;
+    bool iqKnown = false;          // Polarità IQ attuale nota
+    bool iqBaseKnown = false;      // Altri bit del registro IQ noti
+    uint8_t iqRegister = 0;
+
+    template <typename Bus>
+    static bool writeCommand(Bus& bus, uint8_t command, const uint8_t* data, size_t length) {
+        const uint8_t cmd[] = { command };
+        return bus.write(cmd, sizeof(cmd), data, length);
+    }
+
+public:
+    // Stato impostato da altri (RadioLib begin()): parametri noti, IQ no
+    void assume(const RadioProfile& profile, bool powerSet) {
+        current = profile;
+        frequencyKnown = true;
+        modulationKnown = true;
+        powerKnown = powerSet;
+        iqKnown = false;
+    }
+
+    // Radio reinizializzata o scrittura fallita: tutto da riscrivere
+    void invalidate() {
+        frequencyKnown = modulationKnown = powerKnown = iqKnown = iqBaseKnown = false;
+    }
+
+    // startReceive() di RadioLib ha rimesso l'IQ standard (bit 2 = 1)
+    void rxRestarted() {
+        current.invertIq = false;
+        if (iqBaseKnown) {
+            iqRegister |= 0x04;
+            iqKnown = true;
+        }
+    }
+
+    const RadioProfile& state() const { return current; }
+
+    // Radio in standby. Con applyPower = false la potenza non si tocca
+    // (profilo RX). count riporta scritture eseguite e risparmiate.
+    template <typename Bus>
+    RadioProfileResult apply(Bus& bus, const RadioProfile& target, bool applyPower,
+                             RadioSwitchCount& count) {
+        count = RadioSwitchCount();
+        uint8_t bwCode = sx126xBandwidthCode(target.bwKHz);
+        if (target.sf < 5 || target.sf > 12 || bwCode == 0xFF ||
+            target.crDenom < 5 || target.crDenom > 8 || target.freqHz == 0) {
+            return RadioProfileResult::INVALID_PARAMS;
+        }
+
+        if (frequencyKnown && current.sameFrequency(target)) {
+            count.saved++;
+        } else {
+            uint32_t reg = sx126xFrequencyRegister(target.freqHz);
+            const uint8_t data[] = { (uint8_t)(reg >> 24), (uint8_t)(reg >> 16),
+                                     (uint8_t)(reg >> 8), (uint8_t)reg };
+            frequencyKnown = writeCommand(bus, SX126X_CMD_SET_RF_FREQUENCY, data, sizeof(data));
+            if (!frequencyKnown) {
+                return RadioProfileResult::FREQUENCY_ERROR;
+            }
+            current.freqHz = target.freqHz;
+            count.writes++;
+        }
+
+        if (modulationKnown && current.sameModulation(target)) {
+            count.saved++;
+        } else {
+            bool ldro = loraLowDataRateOptimize(target.sf, (uint32_t)target.bwKHz * 1000);
+            const uint8_t data[] = { target.sf, bwCode, (uint8_t)(target.crDenom - 4),
+                                     (uint8_t)(ldro ? 0x01 : 0x00) };
+            modulationKnown = writeCommand(bus, SX126X_CMD_SET_MODULATION_PARAMS, data, sizeof(data));
+            if (!modulationKnown) {
+                return RadioProfileResult::MODULATION_ERROR;
+            }
+            current.sf = target.sf;
+            current.bwKHz = target.bwKHz;
+            current.crDenom = target.crDenom;
+            count.writes++;
+        }
+
+        if (applyPower) {
+            if (powerKnown && current.powerDbm == target.powerDbm) {
+                count.saved++;
+            } else {
+                const uint8_t data[] = { (uint8_t)target.powerDbm, SX126X_PA_RAMP_200U };
+                powerKnown = writeCommand(bus, SX126X_CMD_SET_TX_PARAMS, data, sizeof(data));
+                if (!powerKnown) {
+                    return RadioProfileResult::POWER_ERROR;
+                }
+                current.powerDbm = target.powerDbm;
+                count.writes++;
+            }
+        }
+
+        // IQ: lettura solo la prima volta, poi il registro è in cache
+        if (iqKnown && current.invertIq == target.invertIq) {
+            count.saved++;
+        } else {
+            const uint8_t address[] = { (uint8_t)(SX126X_REG_IQ_POLARITY >> 8),
+                                        (uint8_t)(SX126X_REG_IQ_POLARITY & 0xFF) };
+            if (!iqBaseKnown) {
+                const uint8_t readCmd[] = { SX126X_CMD_READ_REGISTER, address[0], address[1] };
+                if (!bus.read(readCmd, sizeof(readCmd), &iqRegister, 1)) {
+                    return RadioProfileResult::IQ_ERROR;
+                }
+                iqBaseKnown = true;
+                count.writes++;
+            } else {
+                count.saved++;   // Lettura evitata
+            }
+            uint8_t value = target.invertIq ? (uint8_t)(iqRegister & ~0x04) : (uint8_t)(iqRegister | 0x04);
+            const uint8_t writeCmd[] = { SX126X_CMD_WRITE_REGISTER, address[0], address[1] };
+            iqKnown = bus.write(writeCmd, sizeof(writeCmd), &value, 1);
+            if (!iqKnown) {
+                return RadioProfileResult::IQ_ERROR;
+            }
+            iqRegister = value;
+            current.invertIq = target.invertIq;
+            count.writes++;
+        }
+        return RadioProfileResult::OK;
+    }
+};
+
+#endif // RADIO_PROFILE_H
@@ -0,0 +1,122 @@
+// ===========================
+// LETTURA A RAFFICA DEL PACCHETTO RICEVUTO (SX126x)
+// ===========================
+// Al posto di readData() + getPacketLength() + getRSSI() + getSNR(),
+// ognuna con le sue transazioni SPI e attese di BUSY (readData da sola
+// rilegge stato, IRQ e lunghezza), una sola sequenza minima:
+//
+//   1. GetRxBufferStatus   → lunghezza e offset nel buffer
+//   2. ReadBuffer          → payload in un'unica transazione
+//   3. GetPacketStatus     → RSSI, SNR, RSSI del segnale
+//   4. ReadRegister (FEI)  → errore di frequenza (3 byte in un burst)
+//
+// L'SX126x accetta un solo comando per frame NSS: quattro transazioni
+// sono il minimo. ClearIrqStatus non serve: lo esegue già startReceive()
+// di RadioLib, chiamato subito dopo. Il tipo di IRQ (CRC, header) è già
+// noto dallo stato letto prima (RadioIrq.h): qui si arriva solo per
+// RxDone valido.
+//
+// Il bus è un parametro template con un metodo:
+//   bool read(const uint8_t* cmd, uint8_t cmdLen, uint8_t* data, size_t len)
+// (il byte di stato dopo il comando lo scarta il bus, come RadioLib).
+// Sul dispositivo è il Module di RadioLib, su host un mock che conta le
+// transazioni. Solo aritmetica intera per la FEI: compila anche su host.
+#ifndef RX_READOUT_H
+#define RX_READOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Comandi e registri SX126x (datasheet, cap. 13)
+#define SX126X_CMD_GET_RX_BUFFER_STATUS  0x13
+#define SX126X_CMD_GET_PACKET_STATUS     0x14
+#define SX126X_CMD_READ_REGISTER         0x1D
+#define SX126X_CMD_READ_BUFFER           0x1E
+#define SX126X_REG_FREQ_ERROR            0x076B  // FEI, 20 bit con segno
+
+struct RxPacketInfo {
+    uint8_t length = 0;         // PayloadLengthRx
+    uint8_t offset = 0;         // RxStartBufferPointer
+    float rssi = 0.0;           // RssiPkt: media sul pacchetto (dBm)
+    float snr = 0.0;            // SnrPkt (dB)
+    float signalRssi = 0.0;     // SignalRssiPkt: dopo il despreading (dBm)
+    int32_t freqErrorHz = 0;    // Errore di frequenza stimato (Hz)
+};
+
+enum class RxReadoutResult : uint8_t {
+    OK = 0,
+    BUFFER_STATUS_ERROR,   // GetRxBufferStatus fallito
+    PAYLOAD_ERROR,         // ReadBuffer fallito
+    PACKET_STATUS_ERROR    // GetPacketStatus fallito
+};
+
+inline const char* rxReadoutResultToString(RxReadoutResult result) {
+    switch (result) {
+        case RxReadoutResult::OK:                  return "OK";
+        case RxReadoutResult::BUFFER_STATUS_ERROR: return "BUFFER_STATUS_ERROR";
+        case RxReadoutResult::PAYLOAD_ERROR:       return "PAYLOAD_ERROR";
+        case RxReadoutResult::PACKET_STATUS_ERROR: return "PACKET_STATUS_ERROR";
+        default:                                   return "UNKNOWN";
+    }
+}
+
+// RssiPkt / SignalRssiPkt: -valore/2 dBm
+inline float sx126xPacketRssi(uint8_t raw) {
+    return -(float)raw / 2.0f;
+}
+
+// SnrPkt: complemento a 2, passi di 0.25 dB
+inline float sx126xPacketSnr(uint8_t raw) {
+    return (float)(int8_t)raw / 4.0f;
+}
+
+// FEI (AN1200.58 / RadioLib): errore = 1.55 * fei / (1600 / BW_kHz)
+//                                    = fei * 155 * BW_Hz / 160000000
+inline int32_t sx126xFreqErrorHz(const uint8_t raw[3], uint32_t bwHz) {
+    int32_t fei = (int32_t)((((uint32_t)raw[0] << 16) | ((uint32_t)raw[1] << 8) | raw[2]) & 0x0FFFFF);
+    if (fei & 0x80000) {
+        fei -= 0x100000;  // Estensione del segno a 20 bit
+    }
+    return (int32_t)((int64_t)fei * 155 * bwHz / 160000000LL);
+}
+
+// Legge payload e stato del pacchetto con la sequenza minima di
+// transazioni. payload deve avere almeno maxLength byte; un pacchetto
+// più lungo viene troncato (info.length resta quello ricevuto).
+template <typename Bus>
+RxReadoutResult readRxPacket(Bus& bus, uint8_t* payload, size_t maxLength,
+                             uint32_t bwHz, RxPacketInfo& info) {
+    uint8_t data[3];
+
+    const uint8_t bufferStatus[] = { SX126X_CMD_GET_RX_BUFFER_STATUS };
+    if (!bus.read(bufferStatus, sizeof(bufferStatus), data, 2)) {
+        return RxReadoutResult::BUFFER_STATUS_ERROR;
+    }
+    info.length = data[0];
+    info.offset = data[1];
+
+    size_t length = info.length < maxLength ? info.length : maxLength;
+    if (length > 0) {
+        const uint8_t readBuffer[] = { SX126X_CMD_READ_BUFFER, info.offset };
+        if (!bus.read(readBuffer, sizeof(readBuffer), payload, length)) {
+            return RxReadoutResult::PAYLOAD_ERROR;
+        }
+    }
+
+    const uint8_t packetStatus[] = { SX126X_CMD_GET_PACKET_STATUS };
+    if (!bus.read(packetStatus, sizeof(packetStatus), data, 3)) {
+        return RxReadoutResult::PACKET_STATUS_ERROR;
+    }
+    info.rssi = sx126xPacketRssi(data[0]);
+    info.snr = sx126xPacketSnr(data[1]);
+    info.signalRssi = sx126xPacketRssi(data[2]);
+
+    // FEI facoltativa: se la lettura fallisce resta 0
+    const uint8_t readFei[] = { SX126X_CMD_READ_REGISTER,
+                                (uint8_t)(SX126X_REG_FREQ_ERROR >> 8),
+                                (uint8_t)(SX126X_REG_FREQ_ERROR & 0xFF) };
+    info.freqErrorHz = bus.read(readFei, sizeof(readFei), data, 3) ? sx126xFreqErrorHz(data, bwHz) : 0;
+    return RxReadoutResult::OK;
+}
+
+#endif // RX_READOUT_H
@@ -0,0 +1,155 @@
+// ===========================
+// WRITER PUSH_DATA (rxpk)
+// ===========================
+// Genera il datagram PUSH_DATA completo (header 12 byte + JSON rxpk) in un
+// unico buffer preallocato, pronto per una sola write UDP:
+//
+//   [0x02][token:2][0x00][gateway_id:8]{"rxpk":[{"tmst":...,<costanti>,
+//   "rssi":...,"lsnr":...,"size":...,"data":"<base64>"}]}
+//
+// Gateway ID e campi costanti (freq, chan, rfch, stat, modu, datr, codr)
+// sono renderizzati una sola volta in init(); per ogni uplink si scrivono
+// solo i campi variabili. Nessuna allocazione, nessun printf: solo
+// aritmetica intera, compila anche su host.
+#ifndef RXPK_WRITER_H
+#define RXPK_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Base64.h"
+
+// Header + JSON con payload LoRa max (255 byte → 340 caratteri base64)
+#ifndef RXPK_DATAGRAM_SIZE
+#define RXPK_DATAGRAM_SIZE 640
+#endif
+
+class RxpkWriter {
+private:
+    static constexpr size_t HEADER_SIZE = 12;
+
+    char buffer[RXPK_DATAGRAM_SIZE];   // Datagram (header binario + JSON)
+    char constFields[128];             // "freq":...,"codr":"4/5",
+    size_t constFieldsLength = 0;
+
+    size_t pos = 0;
+    bool overflow = false;
+
+    void append(const char* str, size_t length) {
+        if (pos + length >= sizeof(buffer)) {
+            overflow = true;
+            return;
+        }
+        memcpy(buffer + pos, str, length);
+        pos += length;
+    }
+
+    void appendLiteral(const char* str) {
+        append(str, strlen(str));
+    }
+
+    void appendUint(uint32_t value) {
+        char digits[10];
+        size_t n = 0;
+        do {
+            digits[n++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        if (pos + n >= sizeof(buffer)) {
+            overflow = true;
+            return;
+        }
+        while (n > 0) {
+            buffer[pos++] = digits[--n];
+        }
+    }
+
+    void appendInt(int32_t value) {
+        if (value < 0) {
+            append("-", 1);
+            appendUint((uint32_t)(-(int64_t)value));
+        } else {
+            appendUint((uint32_t)value);
+        }
+    }
+
+    // Valore in decimi (es: -75 → "-7.5")
+    void appendTenths(int32_t tenths) {
+        if (tenths < 0) {
+            append("-", 1);
+            tenths = -tenths;
+        }
+        appendUint((uint32_t)tenths / 10);
+        char frac[2] = {'.', (char)('0' + tenths % 10)};
+        append(frac, 2);
+    }
+
+    void appendBase64(const uint8_t* data, size_t length) {
+        size_t written = base64Encode(data, length, buffer + pos, sizeof(buffer) - pos);
+        if (written == 0 && length > 0) {
+            overflow = true;
+            return;
+        }
+        pos += written;
+    }
+
+public:
+    // Prepara header e campi costanti (una volta, all'avvio).
+    // freqHz deve essere un multiplo di 100 Hz (canali LoRa).
+    void init(uint64_t gatewayId, uint32_t freqHz, uint8_t sf, uint16_t bwKHz, uint8_t crDenom) {
+        buffer[0] = 0x02;                  // Protocol version
+        buffer[3] = 0x00;                  // PUSH_DATA
+        for (int i = 0; i < 8; i++) {
+            buffer[4 + i] = (char)((gatewayId >> ((7 - i) * 8)) & 0xFF);
+        }
+
+        int n = snprintf(constFields, sizeof(constFields),
+                         "\"freq\":%lu.%04lu,\"chan\":0,\"rfch\":0,\"stat\":1,"
+                         "\"modu\":\"LORA\",\"datr\":\"SF%uBW%u\",\"codr\":\"4/%u\",",
+                         (unsigned long)(freqHz / 1000000), (unsigned long)(freqHz % 1000000 / 100),
+                         (unsigned)sf, (unsigned)bwKHz, (unsigned)crDenom);
+        constFieldsLength = (n > 0 && (size_t)n < sizeof(constFields)) ? (size_t)n : 0;
+    }
+
+    // Renderizza il datagram per un uplink. rssi in dBm, snr in decimi di dB.
+    // Ritorna la lunghezza totale (header + JSON), 0 se non entra nel buffer.
+    size_t build(uint16_t token, uint32_t tmst, int16_t rssi, int16_t snrTenths,
+                 const uint8_t* payload, size_t length) {
+        buffer[1] = (char)(token >> 8);
+        buffer[2] = (char)(token & 0xFF);
+
+        pos = HEADER_SIZE;
+        overflow = false;
+        appendLiteral("{\"rxpk\":[{\"tmst\":");
+        appendUint(tmst);
+        append(",", 1);
+        append(constFields, constFieldsLength);
+        appendLiteral("\"rssi\":");
+        appendInt(rssi);
+        appendLiteral(",\"lsnr\":");
+        appendTenths(snrTenths);
+        appendLiteral(",\"size\":");
+        appendUint((uint32_t)length);
+        appendLiteral(",\"data\":\"");
+        appendBase64(payload, length);
+        appendLiteral("\"}]}");
+
+        if (overflow) {
+            return 0;
+        }
+        buffer[pos] = '\0';  // Solo per il log, non fa parte del datagram
+        return pos;
+    }
+
+    const uint8_t* data() const {
+        return (const uint8_t*)buffer;
+    }
+
+    // JSON dell'ultimo datagram (null-terminated)
+    const char* json() const {
+        return buffer + HEADER_SIZE;
+    }
+};
+
+#endif // RXPK_WRITER_H
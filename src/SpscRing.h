@@ -0,0 +1,113 @@
+// ===========================
+// RING BUFFER LOCK-FREE SINGLE-PRODUCER / SINGLE-CONSUMER
+// ===========================
+// Coda a dimensione fissa tra esattamente UN produttore e UN consumatore
+// (es. radio task → network task). Nessun mutex, nessuna allocazione:
+// gli indici sono contatori liberi a 32 bit, lo slot è (indice & (N-1)).
+//
+// - tail: scritto solo dal produttore (release), letto dal consumatore (acquire)
+// - head: scritto solo dal consumatore (release), letto dal produttore (acquire)
+//
+// Dipende solo da <atomic>: compila identico su ESP32 e su host Linux
+// (pthreads) per gli stress test.
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Forza l'inlining: i metodi del ring sono chiamati anche da ISR in IRAM
+#ifndef SPSC_INLINE
+#define SPSC_INLINE inline __attribute__((always_inline))
+#endif
+
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing: N deve essere potenza di 2");
+
+private:
+    static constexpr uint32_t MASK = N - 1;
+
+    T slots[N];
+    // Su linee di cache separate per evitare false sharing tra i due core
+    alignas(64) std::atomic<uint32_t> head{0};  // Prossimo slot da leggere
+    alignas(64) std::atomic<uint32_t> tail{0};  // Prossimo slot da scrivere
+
+public:
+    // ----- LATO PRODUTTORE -----
+
+    // Ritorna lo slot libero da riempire in-place, nullptr se il ring è pieno.
+    // Lo slot diventa visibile al consumatore solo dopo commit().
+    SPSC_INLINE T* reserve() {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= N) {
+            return nullptr;  // Pieno
+        }
+        return &slots[t & MASK];
+    }
+
+    // Pubblica lo slot ottenuto con reserve()
+    SPSC_INLINE void commit() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Copia un elemento nel ring. Ritorna false se pieno.
+    SPSC_INLINE bool push(const T& item) {
+        T* slot = reserve();
+        if (slot == nullptr) {
+            return false;
+        }
+        *slot = item;
+        commit();
+        return true;
+    }
+
+    // ----- LATO CONSUMATORE -----
+
+    // Ritorna il primo elemento senza rimuoverlo, nullptr se vuoto.
+    // Il puntatore resta valido fino a release().
+    SPSC_INLINE T* front() {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return nullptr;  // Vuoto
+        }
+        return &slots[h & MASK];
+    }
+
+    // Libera lo slot ottenuto con front()
+    SPSC_INLINE void release() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Estrae (copia) il primo elemento. Ritorna false se vuoto.
+    SPSC_INLINE bool pop(T& out) {
+        T* slot = front();
+        if (slot == nullptr) {
+            return false;
+        }
+        out = *slot;
+        release();
+        return true;
+    }
+
+    // ----- INFO (valori indicativi se letti dal lato opposto) -----
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool isEmpty() const {
+        return size() == 0;
+    }
+
+    bool isFull() const {
+        return size() >= N;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+};
+
+#endif // SPSC_RING_H
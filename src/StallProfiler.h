@@ -0,0 +1,127 @@
+// ===========================
+// PROFILER DEGLI STALLI PER ITERAZIONE
+// ===========================
+// Misura ogni iterazione di un ciclo (loop(), network task) divisa in
+// sezioni con nome: begin() apre l'iterazione, mark(i) attribuisce alla
+// sezione i il tempo trascorso dall'ultimo mark, end() chiude. Per ogni
+// sezione e per l'iterazione intera tiene un istogramma log2 in us
+// (TraceHistogram: p50/p99/max). Se un'iterazione supera il budget,
+// end() ritorna true e worstSection() indica la sezione che ha pesato di
+// più, da loggare. La somma delle iterazioni (getBusyUs) confrontata col
+// tempo trascorso dà la disponibilità di un task che attende eventi.
+//
+// Il tempo arriva dal chiamante (tmst in us): compila anche su host.
+// Usato da un solo task, letto senza lock da chi stampa le statistiche.
+#ifndef STALL_PROFILER_H
+#define STALL_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "Trace.h"
+
+template <uint8_t N>
+class StallProfiler {
+    static_assert(N > 0, "StallProfiler: almeno una sezione");
+
+private:
+    const char* const* names;
+    uint32_t budgetUs;
+
+    // Istogrammi in us (TraceHistogram è indipendente dall'unità)
+    TraceHistogram sections[N];
+    TraceHistogram iterations;
+
+    uint32_t iterationStart = 0;
+    uint32_t lastMark = 0;
+    uint32_t current[N];           // us per sezione nell'iterazione in corso
+    uint32_t lastIterationUs = 0;
+    uint32_t overBudget = 0;       // Iterazioni oltre il budget
+    uint64_t busyUs = 0;           // Somma delle iterazioni
+    uint8_t worst = 0;
+
+public:
+    StallProfiler(const char* const (&sectionNames)[N], uint32_t budget)
+        : names(sectionNames), budgetUs(budget) {
+        reset();
+    }
+
+    void reset() {
+        for (uint8_t i = 0; i < N; i++) {
+            sections[i].reset();
+            current[i] = 0;
+        }
+        iterations.reset();
+        lastIterationUs = 0;
+        overBudget = 0;
+        busyUs = 0;
+        worst = 0;
+    }
+
+    void setBudgetUs(uint32_t budget) { budgetUs = budget; }
+    uint32_t getBudgetUs() const { return budgetUs; }
+
+    void begin(uint32_t now) {
+        iterationStart = now;
+        lastMark = now;
+        for (uint8_t i = 0; i < N; i++) {
+            current[i] = 0;
+        }
+    }
+
+    // Attribuisce alla sezione il tempo dall'ultimo mark (o da begin)
+    void mark(uint8_t section, uint32_t now) {
+        if (section < N) {
+            current[section] += now - lastMark;
+        }
+        lastMark = now;
+    }
+
+    // Chiude l'iterazione. Ritorna true se ha superato il budget.
+    // Le sezioni non eseguite (0 us) non entrano negli istogrammi.
+    bool end(uint32_t now) {
+        lastIterationUs = now - iterationStart;
+        iterations.record(lastIterationUs);
+        busyUs += lastIterationUs;
+
+        worst = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            if (current[i] > 0) {
+                sections[i].record(current[i]);
+            }
+            if (current[i] > current[worst]) {
+                worst = i;
+            }
+        }
+
+        if (budgetUs > 0 && lastIterationUs > budgetUs) {
+            overBudget++;
+            return true;
+        }
+        return false;
+    }
+
+    // Dati dell'ultima iterazione
+    uint32_t getLastIterationUs() const { return lastIterationUs; }
+    uint8_t worstSection() const { return worst; }
+    uint32_t worstSectionUs() const { return current[worst]; }
+
+    uint32_t getOverBudgetCount() const { return overBudget; }
+    uint64_t getBusyUs() const { return busyUs; }
+    const char* sectionName(uint8_t section) const { return section < N ? names[section] : "?"; }
+    const TraceHistogram& sectionHistogram(uint8_t section) const { return sections[section]; }
+    const TraceHistogram& iterationHistogram() const { return iterations; }
+    static constexpr uint8_t sectionCount() { return N; }
+
+    // "OTA        n=1200 p50=15 p99=255 max=180 us"
+    size_t formatSection(uint8_t section, char* out, size_t size) const {
+        const TraceHistogram& h = (section < N) ? sections[section] : iterations;
+        int n = snprintf(out, size, "%-10s n=%lu p50=%lu p99=%lu max=%lu us",
+                         section < N ? names[section] : "TOTALE",
+                         (unsigned long)h.count, (unsigned long)h.percentileCycles(50),
+                         (unsigned long)h.percentileCycles(99), (unsigned long)h.maxCycles);
+        return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+    }
+};
+
+#endif // STALL_PROFILER_H
@@ -0,0 +1,202 @@
+// ===========================
+// TRACEPOINT DELLA PIPELINE + ISTOGRAMMI LOG2
+// ===========================
+// Ogni stadio della pipeline (RX → PUSH_DATA, PULL_RESP → TX) alimenta un
+// istogramma a bucket fissi in base 2: il bucket k conta le durate in
+// [2^k, 2^(k+1)) cicli CPU. Registrare un campione costa un CLZ e due
+// incrementi, senza divisioni né allocazioni; p50/p99 si ricavano dai
+// bucket (limite superiore del bucket, limitato al massimo osservato).
+//
+// - Stadi nello stesso task: cicli CPU (TRACE_CLOCK, contatore del core)
+// - Stadi tra task/core diversi: tmst in us convertiti in cicli, perché i
+//   contatori di ciclo dei due core non sono allineati
+//
+// Ogni stadio ha un solo task scrittore; chi stampa legge contatori a 32
+// bit senza lock (un campione in corso può mancare dal riepilogo).
+//
+// Con TRACE_ENABLED a 0 le macro TRACE_* non generano codice.
+// Dipende solo dagli header C: compila anche su host.
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+// Frequenza del contatore di cicli (ESP32-S3 a 240 MHz)
+#ifndef TRACE_CYCLES_PER_US
+#define TRACE_CYCLES_PER_US 240
+#endif
+
+#ifndef TRACE_CLOCK
+#define TRACE_CLOCK() 0
+#endif
+
+// Stadi: nome, descrizione
+#define TRACE_STAGES(X) \
+    X(RX_ISR_TO_READ, "DIO1 ISR -> packet read") \
+    X(RX_READ,        "packet burst read (SPI)") \
+    X(UL_QUEUE,       "DIO1 ISR -> network task") \
+    X(UL_SERIALIZE,   "rxpk serialize") \
+    X(UL_SEND,        "PUSH_DATA sendto") \
+    X(UL_TOTAL,       "DIO1 ISR -> PUSH_DATA sent") \
+    X(DL_PARSE,       "PULL_RESP parse") \
+    X(DL_ENQUEUE,     "JIT enqueue") \
+    X(TX_START,       "|TX start - txpk.tmst|") \
+    X(TX_DONE,        "startTransmit -> TxDone IRQ") \
+    X(RX_REARM,       "RxDone -> RX riarmata") \
+    X(TX_PREPARE,     "TX fase 1: buffer + parametri") \
+    X(TX_COMMAND,     "comando TX -> SetTx completato")
+
+#define TRACE_ENUM_ENTRY(id, description) id,
+enum class TraceStage : uint8_t {
+    TRACE_STAGES(TRACE_ENUM_ENTRY)
+    COUNT
+};
+#undef TRACE_ENUM_ENTRY
+
+inline const char* traceStageName(TraceStage stage) {
+    #define TRACE_NAME_ENTRY(id, description) #id,
+    static const char* const names[] = { TRACE_STAGES(TRACE_NAME_ENTRY) };
+    #undef TRACE_NAME_ENTRY
+    return (uint8_t)stage < (uint8_t)TraceStage::COUNT ? names[(uint8_t)stage] : "UNKNOWN";
+}
+
+inline const char* traceStageDescription(TraceStage stage) {
+    #define TRACE_DESCRIPTION_ENTRY(id, description) description,
+    static const char* const descriptions[] = { TRACE_STAGES(TRACE_DESCRIPTION_ENTRY) };
+    #undef TRACE_DESCRIPTION_ENTRY
+    return (uint8_t)stage < (uint8_t)TraceStage::COUNT ? descriptions[(uint8_t)stage] : "";
+}
+
+// ===========================
+// ISTOGRAMMA LOG2
+// ===========================
+#define TRACE_BUCKETS 32
+
+struct TraceHistogram {
+    uint32_t buckets[TRACE_BUCKETS];
+    uint32_t count;
+    uint32_t maxCycles;
+
+    void reset() {
+        memset(this, 0, sizeof(*this));
+    }
+
+    void record(uint32_t cycles) {
+        uint8_t bucket = (uint8_t)(31 - __builtin_clz(cycles | 1));
+        buckets[bucket]++;
+        count++;
+        if (cycles > maxCycles) {
+            maxCycles = cycles;
+        }
+    }
+
+    // Percentile (0-100) in cicli: limite superiore del bucket che lo
+    // contiene, mai oltre il massimo osservato
+    uint32_t percentileCycles(uint8_t percent) const {
+        if (count == 0) {
+            return 0;
+        }
+        uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+        if (rank == 0) {
+            rank = 1;
+        }
+        uint32_t seen = 0;
+        for (uint8_t k = 0; k < TRACE_BUCKETS; k++) {
+            seen += buckets[k];
+            if (seen >= rank) {
+                uint32_t upper = (k < 31) ? ((1UL << (k + 1)) - 1) : 0xFFFFFFFFUL;
+                return upper < maxCycles ? upper : maxCycles;
+            }
+        }
+        return maxCycles;
+    }
+};
+
+// Cicli → decimi di us (per la stampa senza float)
+inline uint32_t traceCyclesToTenthsUs(uint32_t cycles) {
+    return (uint32_t)((uint64_t)cycles * 10 / TRACE_CYCLES_PER_US);
+}
+
+// ===========================
+// TRACCIA DELLA PIPELINE
+// ===========================
+class PipelineTrace {
+private:
+    TraceHistogram stages[(uint8_t)TraceStage::COUNT];
+
+public:
+    PipelineTrace() {
+        reset();
+    }
+
+    void reset() {
+        for (uint8_t i = 0; i < (uint8_t)TraceStage::COUNT; i++) {
+            stages[i].reset();
+        }
+    }
+
+    void record(TraceStage stage, uint32_t cycles) {
+        stages[(uint8_t)stage].record(cycles);
+    }
+
+    // Durata in us tra due tmst (stadi tra task diversi)
+    void recordUs(TraceStage stage, uint32_t us) {
+        const uint32_t maxUs = 0xFFFFFFFFUL / TRACE_CYCLES_PER_US;
+        stages[(uint8_t)stage].record(us < maxUs ? us * TRACE_CYCLES_PER_US : 0xFFFFFFFFUL);
+    }
+
+    const TraceHistogram& histogram(TraceStage stage) const {
+        return stages[(uint8_t)stage];
+    }
+
+    // "RX_READ         n=12 p50=45.3 p99=90.6 max=88.1 us"
+    size_t formatSummary(TraceStage stage, char* out, size_t size) const {
+        const TraceHistogram& h = stages[(uint8_t)stage];
+        uint32_t p50 = traceCyclesToTenthsUs(h.percentileCycles(50));
+        uint32_t p99 = traceCyclesToTenthsUs(h.percentileCycles(99));
+        uint32_t max = traceCyclesToTenthsUs(h.maxCycles);
+        int n = snprintf(out, size, "%-15s n=%lu p50=%lu.%lu p99=%lu.%lu max=%lu.%lu us",
+                         traceStageName(stage), (unsigned long)h.count,
+                         (unsigned long)(p50 / 10), (unsigned long)(p50 % 10),
+                         (unsigned long)(p99 / 10), (unsigned long)(p99 % 10),
+                         (unsigned long)(max / 10), (unsigned long)(max % 10));
+        return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+    }
+
+    // Una riga per bucket non vuoto: "  [a, b) us: count"
+    size_t formatBucket(TraceStage stage, uint8_t bucket, char* out, size_t size) const {
+        const TraceHistogram& h = stages[(uint8_t)stage];
+        if (bucket >= TRACE_BUCKETS || h.buckets[bucket] == 0) {
+            return 0;
+        }
+        uint32_t low = traceCyclesToTenthsUs(1UL << bucket);
+        uint32_t high = traceCyclesToTenthsUs(bucket < 31 ? (1UL << (bucket + 1)) : 0xFFFFFFFFUL);
+        int n = snprintf(out, size, "  [%lu.%lu, %lu.%lu) us: %lu",
+                         (unsigned long)(low / 10), (unsigned long)(low % 10),
+                         (unsigned long)(high / 10), (unsigned long)(high % 10),
+                         (unsigned long)h.buckets[bucket]);
+        return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+    }
+};
+
+// ===========================
+// MACRO TRACEPOINT
+// ===========================
+#if TRACE_ENABLED
+#define TRACE_BEGIN(var)                  uint32_t var = TRACE_CLOCK()
+#define TRACE_END(tracer, stage, var)     (tracer).record(TraceStage::stage, TRACE_CLOCK() - (var))
+#define TRACE_US(tracer, stage, us)       (tracer).recordUs(TraceStage::stage, (uint32_t)(us))
+#else
+#define TRACE_BEGIN(var)                  do {} while (0)
+#define TRACE_END(tracer, stage, var)     do {} while (0)
+#define TRACE_US(tracer, stage, us)       do {} while (0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,79 @@
+// ===========================
+// ESITO DOWNLINK (txpk_ack.error del TX_ACK)
+// ===========================
+// Ogni PULL_RESP valido riceve un TX_ACK: NONE a TX conclusa, altrimenti
+// l'errore appena noto, così il NS può ripiegare sulla finestra successiva
+// senza attendere il proprio timeout.
+//
+// Dipende solo dagli header C: compila anche su host.
+#ifndef TX_ACK_H
+#define TX_ACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum class TxAckError : uint8_t {
+    NONE = 0,
+    TOO_LATE,            // Istante già passato o mancato
+    TOO_EARLY,           // Istante troppo lontano nel futuro
+    COLLISION_PACKET,    // Coda piena, sovrapposizione o radio non disponibile
+    TX_FREQ,             // Frequenza fuori banda
+    TX_POWER,            // Potenza non supportata
+    GPS_UNLOCKED,        // Solo tmms (tempo GPS): nessun GPS
+    DUTY_CYCLE           // Budget di duty cycle della sottobanda esaurito
+};
+
+inline const char* txAckErrorToString(TxAckError error) {
+    switch (error) {
+        case TxAckError::NONE:             return "NONE";
+        case TxAckError::TOO_LATE:         return "TOO_LATE";
+        case TxAckError::TOO_EARLY:        return "TOO_EARLY";
+        case TxAckError::COLLISION_PACKET: return "COLLISION_PACKET";
+        case TxAckError::TX_FREQ:          return "TX_FREQ";
+        case TxAckError::TX_POWER:         return "TX_POWER";
+        case TxAckError::GPS_UNLOCKED:     return "GPS_UNLOCKED";
+        case TxAckError::DUTY_CYCLE:       return "DUTY_CYCLE";
+        default:                           return "UNKNOWN";
+    }
+}
+
+#define TX_ACK_ERROR_COUNT 8
+
+// TX_ACK da inviare (radio task → network task)
+struct TxAck {
+    uint16_t token = 0;           // Token del PULL_RESP
+    TxAckError error = TxAckError::NONE;
+    bool powerLimited = false;    // powe ridotta: avviso TX_POWER al posto di error
+    int8_t powerDbm = 0;          // Potenza usata (con powerLimited)
+};
+
+// Esito di una TX avviata, alla sua chiusura: TxDone arrivato → NONE (con
+// l'eventuale avviso di potenza), nessun TxDone entro ToA + margine →
+// COLLISION_PACKET, il NS non deve contare su quel downlink
+inline TxAck txAckForFinishedTx(uint16_t token, bool timedOut, bool powerLimited, int8_t powerDbm) {
+    TxAck ack;
+    ack.token = token;
+    if (timedOut) {
+        ack.error = TxAckError::COLLISION_PACKET;
+    } else {
+        ack.powerLimited = powerLimited;
+        ack.powerDbm = powerDbm;
+    }
+    return ack;
+}
+
+// JSON del TX_ACK (dopo l'header Semtech): error per l'esito, oppure
+// l'avviso TX_POWER con la potenza usata quando la TX è riuscita con powe
+// ridotta. Ritorna i caratteri scritti, 0 se out è troppo piccolo.
+inline size_t formatTxAckJson(const TxAck& ack, char* out, size_t size) {
+    int n;
+    if (ack.powerLimited && ack.error == TxAckError::NONE) {
+        n = snprintf(out, size, "{\"txpk_ack\":{\"warn\":\"TX_POWER\",\"value\":%d}}", ack.powerDbm);
+    } else {
+        n = snprintf(out, size, "{\"txpk_ack\":{\"error\":\"%s\"}}", txAckErrorToString(ack.error));
+    }
+    return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+}
+
+#endif // TX_ACK_H
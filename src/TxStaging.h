@@ -0,0 +1,130 @@
+// ===========================
+// TX IN DUE FASI (SX126x): PREPARAZIONE + SCATTO
+// ===========================
+// startTransmit() di RadioLib esegue tutta la configurazione (parametri
+// pacchetto, IRQ, scrittura del buffer, ...) e solo alla fine SetTx: il
+// comando arriva dopo un numero variabile di transazioni SPI e attese
+// di BUSY, dentro la parte critica. Qui il lavoro è diviso:
+//
+// prepareTx(), durante il pre-roll:
+//   SetStandby(XOSC)      → esce dall'RX, oscillatore già acceso
+//   SetBufferBaseAddress  → TX e RX da 0
+//   WriteBuffer           → payload in un'unica transazione
+//   SetPacketParams       → preambolo, lunghezza, CRC, IQ invertito
+//   SetDioIrqParams       → TxDone/Timeout su DIO1
+//   ClearIrqStatus
+//
+// fireTx(), all'istante esatto: un solo SetTx (senza timeout).
+//
+// Frequenza, modulazione, potenza e registro IQ (correzione del
+// datasheet §15.4) li scrive RadioShadow (RadioProfile.h), solo se
+// cambiano, tra le due fasi.
+// Il bus è un parametro template (come in RxReadout.h) con due metodi:
+//   bool read(const uint8_t* cmd, uint8_t cmdLen, uint8_t* data, size_t len)
+//   bool write(const uint8_t* cmd, uint8_t cmdLen, const uint8_t* data, size_t len)
+// Compila anche su host, con un bus finto.
+#ifndef TX_STAGING_H
+#define TX_STAGING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 1 = TX in due fasi, 0 = startTransmit() di RadioLib (confronto jitter)
+#ifndef TX_TWO_PHASE
+#define TX_TWO_PHASE 1
+#endif
+
+// Tempo massimo atteso per prepareTx() (µs): deve stare nel pre-roll
+#ifndef TX_PREPARE_BUDGET_US
+#define TX_PREPARE_BUDGET_US 1500
+#endif
+
+// Comandi e registri SX126x (datasheet, cap. 13)
+#define SX126X_CMD_CLEAR_IRQ_STATUS         0x02
+#define SX126X_CMD_SET_DIO_IRQ_PARAMS       0x08
+#define SX126X_CMD_WRITE_BUFFER             0x0E
+#define SX126X_CMD_SET_STANDBY              0x80
+#define SX126X_CMD_SET_TX                   0x83
+#define SX126X_CMD_SET_PACKET_PARAMS        0x8C
+#define SX126X_CMD_SET_BUFFER_BASE_ADDRESS  0x8F
+#define SX126X_STANDBY_XOSC                 0x01
+
+struct TxStageParams {
+    const uint8_t* payload = nullptr;
+    uint8_t length = 0;
+    uint16_t preambleLength = 8;
+    bool crc = false;            // Downlink LoRaWAN: senza CRC
+    bool invertIq = true;        // Downlink LoRaWAN: IQ invertito
+};
+
+enum class TxStageResult : uint8_t {
+    OK = 0,
+    STANDBY_ERROR,     // SetStandby fallito
+    BUFFER_ERROR,      // SetBufferBaseAddress / WriteBuffer falliti
+    PARAMS_ERROR,      // SetPacketParams fallito
+    IRQ_ERROR,         // SetDioIrqParams / ClearIrqStatus falliti
+    FIRE_ERROR         // SetTx fallito
+};
+
+inline const char* txStageResultToString(TxStageResult result) {
+    switch (result) {
+        case TxStageResult::OK:            return "OK";
+        case TxStageResult::STANDBY_ERROR: return "STANDBY_ERROR";
+        case TxStageResult::BUFFER_ERROR:  return "BUFFER_ERROR";
+        case TxStageResult::PARAMS_ERROR:  return "PARAMS_ERROR";
+        case TxStageResult::IRQ_ERROR:     return "IRQ_ERROR";
+        case TxStageResult::FIRE_ERROR:    return "FIRE_ERROR";
+        default:                           return "UNKNOWN";
+    }
+}
+
+// Fase 1: carica payload e parametri, radio in standby pronta a SetTx
+template <typename Bus>
+TxStageResult prepareTx(Bus& bus, const TxStageParams& params) {
+    const uint8_t standby[] = { SX126X_CMD_SET_STANDBY };
+    const uint8_t standbyMode[] = { SX126X_STANDBY_XOSC };
+    if (!bus.write(standby, sizeof(standby), standbyMode, sizeof(standbyMode))) {
+        return TxStageResult::STANDBY_ERROR;
+    }
+
+    const uint8_t baseAddress[] = { SX126X_CMD_SET_BUFFER_BASE_ADDRESS };
+    const uint8_t baseOffsets[] = { 0x00, 0x00 };
+    const uint8_t writeBuffer[] = { SX126X_CMD_WRITE_BUFFER, 0x00 };
+    if (!bus.write(baseAddress, sizeof(baseAddress), baseOffsets, sizeof(baseOffsets)) ||
+        !bus.write(writeBuffer, sizeof(writeBuffer), params.payload, params.length)) {
+        return TxStageResult::BUFFER_ERROR;
+    }
+
+    // Header esplicito (0x00)
+    const uint8_t packetParams[] = { SX126X_CMD_SET_PACKET_PARAMS };
+    const uint8_t packetValues[] = { (uint8_t)(params.preambleLength >> 8),
+                                     (uint8_t)(params.preambleLength & 0xFF),
+                                     0x00, params.length,
+                                     (uint8_t)(params.crc ? 0x01 : 0x00),
+                                     (uint8_t)(params.invertIq ? 0x01 : 0x00) };
+    if (!bus.write(packetParams, sizeof(packetParams), packetValues, sizeof(packetValues))) {
+        return TxStageResult::PARAMS_ERROR;
+    }
+
+    // TxDone (bit 0) e Timeout (bit 9) su IRQ e DIO1, nulla su DIO2/DIO3
+    const uint8_t dioParams[] = { SX126X_CMD_SET_DIO_IRQ_PARAMS };
+    const uint8_t dioMasks[] = { 0x02, 0x01, 0x02, 0x01, 0x00, 0x00, 0x00, 0x00 };
+    const uint8_t clearIrq[] = { SX126X_CMD_CLEAR_IRQ_STATUS };
+    const uint8_t allIrqs[] = { 0x43, 0xFF };
+    if (!bus.write(dioParams, sizeof(dioParams), dioMasks, sizeof(dioMasks)) ||
+        !bus.write(clearIrq, sizeof(clearIrq), allIrqs, sizeof(allIrqs))) {
+        return TxStageResult::IRQ_ERROR;
+    }
+    return TxStageResult::OK;
+}
+
+// Fase 2: un solo comando, da dare all'istante esatto
+template <typename Bus>
+TxStageResult fireTx(Bus& bus) {
+    const uint8_t setTx[] = { SX126X_CMD_SET_TX };
+    const uint8_t noTimeout[] = { 0x00, 0x00, 0x00 };
+    return bus.write(setTx, sizeof(setTx), noTimeout, sizeof(noTimeout)) ? TxStageResult::OK
+                                                                         : TxStageResult::FIRE_ERROR;
+}
+
+#endif // TX_STAGING_H
@@ -0,0 +1,469 @@
+// ===========================
+// PARSER TXPK (PULL_RESP)
+// ===========================
+// Scanner a passata singola per {"txpk":{...}} del protocollo Semtech UDP.
+// Legge il JSON direttamente dal buffer UDP, senza documento intermedio né
+// copie di stringhe:
+// - data viene decodificato da base64 direttamente nel buffer binario
+// - tmst/freq/powe/prea/size/imme/ipol/datr/codr/modu diventano campi tipati
+//   (di tmms conta solo la presenza: il gateway non ha GPS)
+// - i campi sconosciuti (anche oggetti/array annidati) vengono saltati
+// Nessuna allocazione e nessun limite di pool: i downlink di dimensione
+// massima passano come quelli piccoli.
+//
+// Dipende solo dagli header C standard: compila anche su host.
+#ifndef TXPK_PARSER_H
+#define TXPK_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Base64.h"
+
+// ===========================
+// CAMPI TXPK (downlink)
+// ===========================
+enum class LoRaBandwidth : uint8_t {
+    BW_125 = 0,
+    BW_250 = 1,
+    BW_500 = 2,
+    UNSET  = 0xFF     // datr assente: bandwidth della configurazione radio
+};
+
+inline LoRaBandwidth loraBandwidthFromKHz(uint16_t bwKHz) {
+    switch (bwKHz) {
+        case 125: return LoRaBandwidth::BW_125;
+        case 250: return LoRaBandwidth::BW_250;
+        case 500: return LoRaBandwidth::BW_500;
+        default:  return LoRaBandwidth::UNSET;
+    }
+}
+
+// Ritorna 0 per UNSET
+inline uint16_t loraBandwidthKHz(LoRaBandwidth bw) {
+    switch (bw) {
+        case LoRaBandwidth::BW_125: return 125;
+        case LoRaBandwidth::BW_250: return 250;
+        case LoRaBandwidth::BW_500: return 500;
+        default:                    return 0;
+    }
+}
+
+// Estrae SF e bandwidth (kHz) da datr (es: "SF9BW125", non terminato).
+// Ritorna false se datr non è un data rate LoRa.
+inline bool parseLoRaDataRate(const char* datr, size_t length, uint8_t &sf, uint16_t &bwKHz) {
+    const char* p = datr;
+    const char* end = datr + length;
+    if (length < 6 || p[0] != 'S' || p[1] != 'F') {
+        return false;
+    }
+    p += 2;
+    uint32_t parsedSf = 0;
+    while (p < end && *p >= '0' && *p <= '9' && parsedSf < 100) {
+        parsedSf = parsedSf * 10 + (*p++ - '0');
+    }
+    if (end - p < 3 || p[0] != 'B' || p[1] != 'W') {
+        return false;
+    }
+    p += 2;
+    uint32_t parsedBw = 0;
+    while (p < end && *p >= '0' && *p <= '9' && parsedBw < 10000) {
+        parsedBw = parsedBw * 10 + (*p++ - '0');
+    }
+    if (p != end || parsedSf < 5 || parsedSf > 12 || parsedBw == 0) {
+        return false;
+    }
+    sf = (uint8_t)parsedSf;
+    bwKHz = (uint16_t)parsedBw;
+    return true;
+}
+
+// Denominatore del coding rate (es: "4/5" → 5), 0 se non valido
+inline uint8_t parseCodingRateDenom(const char* codr, size_t length) {
+    if (length != 3 || codr[0] != '4' || codr[1] != '/' || codr[2] < '5' || codr[2] > '8') {
+        return 0;
+    }
+    return (uint8_t)(codr[2] - '0');
+}
+
+// Flag di DownlinkTxParams
+#define DOWNLINK_FLAG_IMMEDIATE  0x01  // imme=true (Classe C)
+#define DOWNLINK_FLAG_HAS_TMST   0x02  // txpk.tmst presente
+#define DOWNLINK_FLAG_INVERT_IQ  0x04  // ipol=true
+#define DOWNLINK_FLAG_HAS_TMMS   0x08  // txpk.tmms presente (tempo GPS)
+
+// Parametri radio del txpk (0 / UNSET = valore della configurazione radio)
+struct DownlinkTxParams {
+    uint32_t tmst = 0;            // Istante TX (contatore concentratore, µs)
+    uint32_t freqHz = 0;          // Frequenza TX in Hz
+    uint16_t preamble = 8;        // Lunghezza preambolo
+    int8_t power = 14;            // Potenza dBm
+    uint8_t sf = 0;               // Spreading factor 5..12
+    LoRaBandwidth bandwidth = LoRaBandwidth::UNSET;
+    uint8_t crDenom = 0;          // Coding rate 4/crDenom (5..8)
+    uint8_t flags = DOWNLINK_FLAG_INVERT_IQ;  // DOWNLINK_FLAG_* (ipol true di default)
+
+    bool isImmediate() const { return flags & DOWNLINK_FLAG_IMMEDIATE; }
+    bool hasTmst() const { return flags & DOWNLINK_FLAG_HAS_TMST; }
+    bool invertIq() const { return flags & DOWNLINK_FLAG_INVERT_IQ; }
+    bool hasTmms() const { return flags & DOWNLINK_FLAG_HAS_TMMS; }
+};
+
+// ===========================
+// SCANNER
+// ===========================
+enum class TxpkParseResult : uint8_t {
+    OK = 0,
+    INVALID_JSON,     // Sintassi JSON non valida o troncata
+    MISSING_TXPK,     // Oggetto txpk assente
+    MISSING_DATA,     // Campo data assente
+    INVALID_DATA,     // data non è base64 valido o non entra nel buffer
+    SIZE_MISMATCH,    // size diverso dalla lunghezza decodificata
+    INVALID_FIELD     // Campo con tipo/valore non valido (es: modu non LORA)
+};
+
+inline const char* txpkParseResultToString(TxpkParseResult result) {
+    switch (result) {
+        case TxpkParseResult::OK:            return "OK";
+        case TxpkParseResult::INVALID_JSON:  return "INVALID_JSON";
+        case TxpkParseResult::MISSING_TXPK:  return "MISSING_TXPK";
+        case TxpkParseResult::MISSING_DATA:  return "MISSING_DATA";
+        case TxpkParseResult::INVALID_DATA:  return "INVALID_DATA";
+        case TxpkParseResult::SIZE_MISMATCH: return "SIZE_MISMATCH";
+        case TxpkParseResult::INVALID_FIELD: return "INVALID_FIELD";
+        default:                             return "UNKNOWN";
+    }
+}
+
+// Profondità massima di annidamento per i valori saltati
+#ifndef TXPK_PARSER_MAX_DEPTH
+#define TXPK_PARSER_MAX_DEPTH 8
+#endif
+
+class TxpkParser {
+private:
+    const char* p;
+    const char* end;
+
+    // Esito dell'ultima decodifica di data (per i log)
+    Base64Result base64Result = Base64Result::OK;
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    bool keyIs(const char* key, size_t length, const char* name) const {
+        return strlen(name) == length && memcmp(key, name, length) == 0;
+    }
+
+    // Stringa JSON: start/length puntano al contenuto tra le virgolette.
+    // escaped = true se contiene sequenze '\' (contenuto non decodificato).
+    bool readString(const char*& start, size_t& length, bool& escaped) {
+        if (!consume('"')) {
+            return false;
+        }
+        start = p;
+        escaped = false;
+        while (p < end && *p != '"') {
+            if (*p == '\\') {
+                escaped = true;
+                if (++p >= end) return false;
+            }
+            p++;
+        }
+        if (p >= end) {
+            return false;
+        }
+        length = p - start;
+        p++;  // '"' finale
+        return true;
+    }
+
+    // Numero decimale moltiplicato per 10^scale (cifre oltre scale troncate).
+    // Niente esponenti: il protocollo non li usa.
+    bool readScaled(int64_t& value, uint8_t scale) {
+        skipWhitespace();
+        bool negative = false;
+        if (p < end && *p == '-') {
+            negative = true;
+            p++;
+        }
+        if (p >= end || *p < '0' || *p > '9') {
+            return false;
+        }
+        uint64_t v = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            v = v * 10 + (uint64_t)(*p++ - '0');
+            if (v > 1000000000000ULL) return false;  // Fuori da ogni campo txpk
+        }
+        uint8_t digits = 0;
+        if (p < end && *p == '.') {
+            p++;
+            if (p >= end || *p < '0' || *p > '9') {
+                return false;
+            }
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (digits < scale) {
+                    v = v * 10 + (uint64_t)(*p - '0');
+                    digits++;
+                }
+                p++;
+            }
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            return false;
+        }
+        for (; digits < scale; digits++) {
+            v *= 10;
+        }
+        value = negative ? -(int64_t)v : (int64_t)v;
+        return true;
+    }
+
+    // Intero senza parte decimale (tmst 1.5 non è un istante valido)
+    bool readInteger(int64_t& value, int64_t minValue, int64_t maxValue) {
+        const char* start = p;
+        if (!readScaled(value, 0)) {
+            return false;
+        }
+        if (memchr(start, '.', p - start) != nullptr) {
+            return false;
+        }
+        return value >= minValue && value <= maxValue;
+    }
+
+    bool readBool(bool& value) {
+        skipWhitespace();
+        if (end - p >= 4 && memcmp(p, "true", 4) == 0) {
+            value = true;
+            p += 4;
+            return true;
+        }
+        if (end - p >= 5 && memcmp(p, "false", 5) == 0) {
+            value = false;
+            p += 5;
+            return true;
+        }
+        return false;
+    }
+
+    // Salta un valore qualsiasi (stringa, numero, literal, oggetto, array)
+    bool skipValue(uint8_t depth) {
+        skipWhitespace();
+        if (p >= end || depth > TXPK_PARSER_MAX_DEPTH) {
+            return false;
+        }
+        char c = *p;
+        if (c == '"') {
+            const char* start;
+            size_t length;
+            bool escaped;
+            return readString(start, length, escaped);
+        }
+        if (c == '{' || c == '[') {
+            char close = (c == '{') ? '}' : ']';
+            p++;
+            if (consume(close)) {
+                return true;
+            }
+            do {
+                if (c == '{') {
+                    const char* key;
+                    size_t keyLength;
+                    bool escaped;
+                    if (!readString(key, keyLength, escaped) || !consume(':')) {
+                        return false;
+                    }
+                }
+                if (!skipValue(depth + 1)) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(close);
+        }
+        // Numero o literal (true/false/null)
+        const char* start = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+               *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            p++;
+        }
+        return p > start;
+    }
+
+    // Campi dell'oggetto txpk. data viene decodificato al volo in payload.
+    TxpkParseResult parseTxpkObject(DownlinkTxParams& tx, uint8_t* payload, size_t payloadSize,
+                                    size_t& payloadLength) {
+        bool hasData = false;
+        bool hasSize = false;
+        int64_t size = 0;
+
+        if (!consume('{')) {
+            return TxpkParseResult::INVALID_JSON;
+        }
+        if (!consume('}')) {
+            do {
+                const char* key;
+                size_t keyLength;
+                bool escaped;
+                if (!readString(key, keyLength, escaped) || !consume(':')) {
+                    return TxpkParseResult::INVALID_JSON;
+                }
+
+                int64_t number;
+                bool flag;
+                const char* str;
+                size_t strLength;
+
+                if (keyIs(key, keyLength, "data")) {
+                    if (!readString(str, strLength, escaped)) {
+                        return TxpkParseResult::INVALID_JSON;
+                    }
+                    if (escaped) {
+                        return TxpkParseResult::INVALID_DATA;  // Il base64 non ha escape
+                    }
+                    base64Result = base64Decode(str, strLength, payload, payloadSize, payloadLength);
+                    if (base64Result != Base64Result::OK) {
+                        return TxpkParseResult::INVALID_DATA;
+                    }
+                    hasData = true;
+                } else if (keyIs(key, keyLength, "tmst")) {
+                    if (!readInteger(number, 0, UINT32_MAX)) return TxpkParseResult::INVALID_FIELD;
+                    tx.tmst = (uint32_t)number;
+                    tx.flags |= DOWNLINK_FLAG_HAS_TMST;
+                } else if (keyIs(key, keyLength, "tmms")) {
+                    // Solo la presenza: il valore (ms GPS) supera i limiti di readScaled
+                    if (!skipValue(0)) return TxpkParseResult::INVALID_FIELD;
+                    tx.flags |= DOWNLINK_FLAG_HAS_TMMS;
+                } else if (keyIs(key, keyLength, "freq")) {
+                    // MHz con fino a 6 decimali → Hz esatti, senza float
+                    if (!readScaled(number, 6) || number <= 0 || number > UINT32_MAX) {
+                        return TxpkParseResult::INVALID_FIELD;
+                    }
+                    tx.freqHz = (uint32_t)number;
+                } else if (keyIs(key, keyLength, "powe")) {
+                    if (!readInteger(number, -128, 127)) return TxpkParseResult::INVALID_FIELD;
+                    tx.power = (int8_t)number;
+                } else if (keyIs(key, keyLength, "prea")) {
+                    if (!readInteger(number, 0, UINT16_MAX)) return TxpkParseResult::INVALID_FIELD;
+                    tx.preamble = (uint16_t)number;
+                } else if (keyIs(key, keyLength, "size")) {
+                    if (!readInteger(size, 0, UINT16_MAX)) return TxpkParseResult::INVALID_FIELD;
+                    hasSize = true;
+                } else if (keyIs(key, keyLength, "imme")) {
+                    if (!readBool(flag)) return TxpkParseResult::INVALID_FIELD;
+                    if (flag) tx.flags |= DOWNLINK_FLAG_IMMEDIATE;
+                    else tx.flags &= ~DOWNLINK_FLAG_IMMEDIATE;
+                } else if (keyIs(key, keyLength, "ipol")) {
+                    if (!readBool(flag)) return TxpkParseResult::INVALID_FIELD;
+                    if (flag) tx.flags |= DOWNLINK_FLAG_INVERT_IQ;
+                    else tx.flags &= ~DOWNLINK_FLAG_INVERT_IQ;
+                } else if (keyIs(key, keyLength, "datr")) {
+                    uint8_t sf;
+                    uint16_t bwKHz;
+                    if (!readString(str, strLength, escaped) ||
+                        !parseLoRaDataRate(str, strLength, sf, bwKHz)) {
+                        return TxpkParseResult::INVALID_FIELD;
+                    }
+                    // BW fuori da 125/250/500 (es: "SF9BW62"): non trasmissibile
+                    LoRaBandwidth bandwidth = loraBandwidthFromKHz(bwKHz);
+                    if (bandwidth == LoRaBandwidth::UNSET) {
+                        return TxpkParseResult::INVALID_FIELD;
+                    }
+                    tx.sf = sf;
+                    tx.bandwidth = bandwidth;
+                } else if (keyIs(key, keyLength, "codr")) {
+                    if (!readString(str, strLength, escaped)) return TxpkParseResult::INVALID_FIELD;
+                    tx.crDenom = parseCodingRateDenom(str, strLength);
+                    if (tx.crDenom == 0) return TxpkParseResult::INVALID_FIELD;
+                } else if (keyIs(key, keyLength, "modu")) {
+                    // Il gateway trasmette solo LoRa
+                    if (!readString(str, strLength, escaped) || strLength != 4 ||
+                        memcmp(str, "LORA", 4) != 0) {
+                        return TxpkParseResult::INVALID_FIELD;
+                    }
+                } else if (!skipValue(0)) {
+                    return TxpkParseResult::INVALID_JSON;
+                }
+            } while (consume(','));
+
+            if (!consume('}')) {
+                return TxpkParseResult::INVALID_JSON;
+            }
+        }
+
+        if (!hasData) {
+            return TxpkParseResult::MISSING_DATA;
+        }
+        if (hasSize && (size_t)size != payloadLength) {
+            return TxpkParseResult::SIZE_MISMATCH;
+        }
+        return TxpkParseResult::OK;
+    }
+
+public:
+    // Analizza il JSON di un PULL_RESP ({"txpk":{...}}, length byte, non
+    // serve terminatore). Riempie tx e decodifica data in payload.
+    TxpkParseResult parse(const char* json, size_t length, DownlinkTxParams& tx,
+                          uint8_t* payload, size_t payloadSize, size_t& payloadLength) {
+        p = json;
+        end = json + length;
+        tx = DownlinkTxParams();
+        payloadLength = 0;
+        base64Result = Base64Result::OK;
+
+        bool hasTxpk = false;
+        if (!consume('{')) {
+            return TxpkParseResult::INVALID_JSON;
+        }
+        if (!consume('}')) {
+            do {
+                const char* key;
+                size_t keyLength;
+                bool escaped;
+                if (!readString(key, keyLength, escaped) || !consume(':')) {
+                    return TxpkParseResult::INVALID_JSON;
+                }
+                if (keyIs(key, keyLength, "txpk")) {
+                    TxpkParseResult result = parseTxpkObject(tx, payload, payloadSize, payloadLength);
+                    if (result != TxpkParseResult::OK) {
+                        return result;
+                    }
+                    hasTxpk = true;
+                } else if (!skipValue(0)) {
+                    return TxpkParseResult::INVALID_JSON;
+                }
+            } while (consume(','));
+
+            if (!consume('}')) {
+                return TxpkParseResult::INVALID_JSON;
+            }
+        }
+
+        // Dopo l'oggetto sono ammessi solo spazi e '\0' finali
+        skipWhitespace();
+        while (p < end && *p == '\0') {
+            p++;
+        }
+        if (p != end) {
+            return TxpkParseResult::INVALID_JSON;
+        }
+        return hasTxpk ? TxpkParseResult::OK : TxpkParseResult::MISSING_TXPK;
+    }
+
+    Base64Result getBase64Result() const {
+        return base64Result;
+    }
+};
+
+#endif // TXPK_PARSER_H
@@ -25,7 +25,9 @@
 // │  12    │   variabile│ JSON payload   │ Stringa JSON UTF-8   │
 // │        │            │                │ (null-terminated)    │
 // └────────┴────────────┴────────────────┴──────────────────────┘
-#include <ArduinoJson.h>
+#include "TxpkParser.h"
+#include "DownlinkFrame.h"
+#include "TxAck.h"
 // ===========================
 // ENUM PER TIPI MESSAGGIO SEMTECH UDP
 // ===========================
@@ -107,119 +109,11 @@ struct LoRaWANHeader {
 };
 #pragma pack(pop)
 
-// ===========================
-// STRUCT PER CAMPI TXPK (downlink)
-// ===========================
-struct TxPkData {
-    // Campi obbligatori
-    char data[512];           // Base64 payload (max ~384 bytes payload LoRaWAN)
-    
-    // Campi opzionali con valori di default
-    bool imme = false;        // Immediate transmission (Classe C)
-    uint32_t tmst = 0;       // Timestamp microsecondi
-    float freq = 0.0;        // Frequenza MHz
-    uint8_t rfch = 0;        // RF chain
-    uint8_t powe = 14;       // Potenza dBm
-    char modu[8] = "LORA";   // Modulazione
-    char datr[16] = "";      // Data rate (es: "SF7BW125")
-    char codr[8] = "4/5";    // Coding rate
-    uint16_t fdev = 0;       // Frequency deviation
-    bool ipol = true;        // Invert polarity
-    uint16_t prea = 8;       // Preamble length
-    uint16_t size = 0;       // Dimensione payload
-    
-    // Flag per indicare quali campi sono presenti
-    bool has_imme = false;
-    bool has_tmst = false;
-    bool has_freq = false;
-    bool has_powe = false;
-    bool has_modu = false;
-    bool has_datr = false;
-    bool has_codr = false;
-    bool has_size = false;
-    
-    // Metodo per parsare da JSON
-    bool parseFromJson(JsonObject &txpk) {
-
-        Serial.println("[TxPkData] parseFromJson:");
-        serializeJsonPretty(txpk, Serial);
-        Serial.println();
-        
-        // Campo obbligatorio
-        if (!txpk.containsKey("data")) {
-            return false;
-        }
-        strncpy(data, txpk["data"] | "", sizeof(data) - 1);
-        data[sizeof(data) - 1] = '\0';
-        
-        // Campi opzionali
-        if (txpk.containsKey("imme")) {
-            imme = txpk["imme"] | false;
-            has_imme = true;
-        }
-        
-        if (txpk.containsKey("tmst")) {
-            tmst = txpk["tmst"] | 0;
-            has_tmst = true;
-        }
-        
-        if (txpk.containsKey("freq")) {
-            freq = txpk["freq"] | 0.0;
-            has_freq = true;
-        }
-        
-        if (txpk.containsKey("powe")) {
-            powe = txpk["powe"] | 14;
-            has_powe = true;
-        }
-        
-        if (txpk.containsKey("modu")) {
-            strncpy(modu, txpk["modu"] | "LORA", sizeof(modu) - 1);
-            has_modu = true;
-        }
-        
-        if (txpk.containsKey("datr")) {
-            strncpy(datr, txpk["datr"] | "", sizeof(datr) - 1);
-            has_datr = true;
-        }
-        
-        if (txpk.containsKey("codr")) {
-            strncpy(codr, txpk["codr"] | "4/5", sizeof(codr) - 1);
-            has_codr = true;
-        }
-        
-        if (txpk.containsKey("size")) {
-            size = txpk["size"] | 0;
-            has_size = true;
-        }
-        
-        return true;
-    }
-};
-
-// ===========================
-// STRUCT PER DATI PULL RESPONSE (livello alto)
-// ===========================
-struct PullResponseData {
-    TxPkData txpk;                    // Dati JSON txpk
-    LoRaWANHeader lorawanHeader;     // Header LoRaWAN estratto
-    uint8_t decodedPayload[256];     // Payload decodificato (base64 → binario)
-    size_t decodedLength = 0;         // Lunghezza payload decodificato
-    uint8_t fport = 0;                // FPort estratto
-    bool isMacCommand = false;        // true se FPort == 0
-    uint32_t devAddr = 0;             // DevAddr estratto (per comodità)
-    
-    bool isValid() const {
-        return decodedLength > 0 && strlen(txpk.data) > 0;
-    }
-    
-    void printDebug() const {
-        Serial.printf("[PullResponseData] Classe C: %s\n", txpk.imme ? "SI" : "NO");
-        Serial.printf("[PullResponseData] DevAddr: 0x%08X\n", devAddr);
-        Serial.printf("[PullResponseData] FPort: %d\n", fport);
-        Serial.printf("[PullResponseData] MAC Command: %s\n", isMacCommand ? "SI" : "NO");
-        Serial.printf("[PullResponseData] Payload size: %zu bytes\n", decodedLength);
-    }
+// Esito di SemtechUdpPackage::getPullResponse(), per il log del chiamante
+struct PullResponseResult {
+    TxpkParseResult parse = TxpkParseResult::OK;
+    Base64Result base64 = Base64Result::OK;   // Solo con parse INVALID_DATA
+    size_t decodedLength = 0;
 };
 
 // ===========================
@@ -285,7 +179,6 @@ public:
         // Estrae payload JSON
         size_t jsonStartOffset = hasGatewayId ? 12 : 4;
         if (length > jsonStartOffset) {
-            Serial.printf("[SemtechUdpPackage] JSON start at offset: %zu\n", jsonStartOffset);
             jsonPayload = &buffer[jsonStartOffset];
             jsonPayloadLength = bufferLength - jsonStartOffset;
         }
@@ -334,9 +227,14 @@ public:
         return jsonPayloadLength;
     }
     
-    // Estrae i dati PULL_RESP (solo se è un PULL_RESP)
-    // Ritorna true se estrazione riuscita, false altrimenti
-    bool getPullResponse(PullResponseData& result) const {
+    // Estrae i dati PULL_RESP (solo se è un PULL_RESP) scrivendoli
+    // direttamente in frame, tipicamente lo slot riservato nel ring downlink.
+    // Ritorna true se estrazione riuscita, false altrimenti: in quel caso il
+    // chiamante non pubblica lo slot e frame va considerato spazzatura.
+    // Nessuna stampa: l'esito per il log del chiamante è in result.
+    bool getPullResponse(DownlinkFrame& frame, PullResponseResult& result) const {
+        result = PullResponseResult();
+
         // Verifica che sia un PULL_RESP
         if (getMessageType() != SemtechMessageType::PULL_RESP) {
             return false;
@@ -347,73 +245,45 @@ public:
             return false;
         }
         
-        // Parse JSON
-        StaticJsonDocument<512> doc;
-        DeserializationError error = deserializeJson(
-            doc, 
-            (const char*)jsonPayload, 
-            jsonPayloadLength
+        // Parse txpk in un solo passaggio: data decodificato direttamente nello slot
+        DownlinkInfo& info = frame.info;
+        info.token = getToken();
+        size_t decodedLength = 0;
+        TxpkParser parser;
+        TxpkParseResult parseResult = parser.parse(
+            (const char*)jsonPayload,
+            jsonPayloadLength,
+            info.tx,
+            frame.payload,
+            sizeof(frame.payload),
+            decodedLength
         );
-
-        if (error) {
-            Serial.printf("[SemtechUdpPackage] ❌ Errore parsing JSON: %s\n", error.c_str());
-            Serial.print("[SemtechUdpPackage] JSON raw: ");
-            for (int i = 0; i < jsonPayloadLength && i < 100; i++) {
-                Serial.printf("%c", jsonPayload[i]);
-            }
-            Serial.println();
-            return false;
-        }
-        Serial.printf("[SemtechUdpPackage] jsonPayloadLength: %zu\n", jsonPayloadLength);
         
-        // Verifica presenza campo txpk
-        if (!doc.containsKey("txpk")) {
-            Serial.printf("[SemtechUdpPackage] ❌ JSON: txpk non trovato\n");
+        result.parse = parseResult;
+        result.decodedLength = decodedLength;
+        if (parseResult != TxpkParseResult::OK) {
+            if (parseResult == TxpkParseResult::INVALID_DATA) {
+                result.base64 = parser.getBase64Result();
+            }
             return false;
         }
-        
-        // Parse oggetto txpk
-        JsonObject txpkObj = doc["txpk"];
-
-        if (!result.txpk.parseFromJson(txpkObj)) {
-            Serial.println("[SemtechUdpPackage] ❌ Errore parsing JSON: txpkObj");
+        if (decodedLength < 8) {
             return false;
         }
-
-
-
-        const char* base64Data = result.txpk.data;
-        Serial.printf("[SemtechUdpPackage] Downlink data (base64): %s\n", base64Data);
-        
-        // Decodifica base64 payload
-        result.decodedLength = decodeBase64(
-            base64Data, 
-            result.decodedPayload, 
-            sizeof(result.decodedPayload)
-        );
-        Serial.printf("[SemtechUdpPackage] Decoded length: %zu\n",
-                      result.decodedLength);
-        Serial.printf("[SemtechUdpPackage] Decoded payload: ");
-        for (size_t i = 0; i < result.decodedLength; i++) {
-            Serial.printf("%02X ", result.decodedPayload[i]);
-        }
-        Serial.println();
-        if (result.decodedLength == 0 || result.decodedLength < 8) {
-            return false;
-        }
-
+        info.length = (uint8_t)decodedLength;
         
         // Parse header LoRaWAN
-        memcpy(&result.lorawanHeader, result.decodedPayload, sizeof(LoRaWANHeader));
-        result.devAddr = result.lorawanHeader.devAddr;
+        LoRaWANHeader lorawanHeader;
+        memcpy(&lorawanHeader, frame.payload, sizeof(LoRaWANHeader));
+        info.devAddr = lorawanHeader.devAddr;
         
-        // Estrai FPort e determina se è MAC command
-        uint8_t foptsLen = result.lorawanHeader.getFOptsLen();
+        // Estrai FPort (0 = MAC command)
+        uint8_t foptsLen = lorawanHeader.getFOptsLen();
         size_t fportPos = 8 + foptsLen;
         
-        if (fportPos < result.decodedLength - 4) {  // -4 per MIC
-            result.fport = result.decodedPayload[fportPos];
-            result.isMacCommand = (result.fport == 0);
+        info.fport = 0;
+        if (fportPos < decodedLength - 4) {  // -4 per MIC
+            info.fport = frame.payload[fportPos];
         }
         
         return true;
@@ -431,235 +301,109 @@ public:
 };
 
 // ===========================
-// STRUCT COMPLETA PER PULL_RESP (compatibilità con codice esistente)
-// ===========================
-struct PullRespPacket {
-    uint16_t token;
-    PullResponseData responseData;
-
-    bool isValid() const {
-        return responseData.isValid();
-    }
-
-};
-
-// ===========================
-// CLASSE PER GESTIONE CODA DOWNLINK
+// FINESTRE RX PENDENTI (Classe A)
 // ===========================
-#ifndef MAX_DOWNLINK_QUEUE_SIZE
-#define MAX_DOWNLINK_QUEUE_SIZE 10  // Massimo 10 messaggi totali in coda
+// Ogni uplink apre un record con il suo tmst (contatore concentratore, µs).
+// Il PULL_RESP che arriva dopo (in modo asincrono) viene associato al record
+// tramite txpk.tmst (o DevAddr) e messo nella coda downlink all'istante
+// esatto, mentre la radio resta in ricezione. Tempi tmst a 32 bit (wrap-safe).
+#ifndef MAX_PENDING_RX_WINDOWS
+#define MAX_PENDING_RX_WINDOWS 8  // Uplink con finestre RX aperte contemporaneamente
 #endif
 
-#ifndef MAX_DOWNLINK_PER_DEVADDR
-#define MAX_DOWNLINK_PER_DEVADDR 2  // Massimo 2 messaggi per DevAddr (RX1 + RX2)
-#endif
+struct PendingRxWindow {
+    bool active = false;
+    uint32_t devAddr = 0;
+    uint32_t rxTmst = 0;                 // tmst dell'uplink
+};
 
-class DownlinkQueue {
+class PendingRxWindows {
 private:
-    PullRespPacket queue[MAX_DOWNLINK_QUEUE_SIZE];
-    uint8_t count = 0;  // Numero elementi attualmente nella coda
-    
-    // Trova il primo slot vuoto (ritorna MAX_DOWNLINK_QUEUE_SIZE se pieno)
-    uint8_t findEmptySlot() const {
-        for (uint8_t i = 0; i < MAX_DOWNLINK_QUEUE_SIZE; i++) {
-            if (!queue[i].isValid()) {
-                return i;
-            }
-        }
-        return MAX_DOWNLINK_QUEUE_SIZE;  // Coda piena
-    }
+    PendingRxWindow windows[MAX_PENDING_RX_WINDOWS];
     
 public:
-    // Costruttore: inizializza la coda
-    DownlinkQueue() {
-        clear();
-    }
-    
-    // Aggiunge un elemento alla coda (copia)
-    // Ritorna true se aggiunto con successo, false se:
-    //   - Coda piena (MAX_DOWNLINK_QUEUE_SIZE raggiunto)
-    //   - Limite per DevAddr raggiunto (MAX_DOWNLINK_PER_DEVADDR)
-    bool add(const PullRespPacket& packet) {
-        // Controllo 1: Coda totale piena?
-        if (count >= MAX_DOWNLINK_QUEUE_SIZE) {
-            return false;  // Coda piena
-        }
-        
-        // Controllo 2: Limite per DevAddr raggiunto?
-        uint8_t countForDevAddr = countByDevAddr(packet.responseData.devAddr);
-        if (countForDevAddr >= MAX_DOWNLINK_PER_DEVADDR) {
-            return false;  // Limite per DevAddr raggiunto
+    // Registra un uplink ricevuto a rxTmst.
+    // Un record ancora aperto per lo stesso DevAddr viene sostituito.
+    // Ritorna nullptr se la tabella è piena.
+    PendingRxWindow* open(uint32_t devAddr, uint32_t rxTmst) {
+        PendingRxWindow* slot = findWaiting(devAddr);
+        for (uint8_t i = 0; slot == nullptr && i < MAX_PENDING_RX_WINDOWS; i++) {
+            if (!windows[i].active) {
+                slot = &windows[i];
+            }
         }
-        
-        // Trova slot vuoto
-        uint8_t slot = findEmptySlot();
-        if (slot >= MAX_DOWNLINK_QUEUE_SIZE) {
-            return false;  // Nessuno slot vuoto trovato (non dovrebbe mai succedere qui)
+        if (slot == nullptr) {
+            return nullptr;
         }
         
-        // Copia il pacchetto nello slot
-        queue[slot] = packet;
-        count++;
-        return true;
+        slot->active = true;
+        slot->devAddr = devAddr;
+        slot->rxTmst = rxTmst;
+        return slot;
     }
     
-    // Ritorna il numero di elementi nella coda
-    uint8_t size() const {
-        return count;
-    }
-    
-    // Ritorna true se la coda è vuota
-    bool isEmpty() const {
-        return count == 0;
-    }
-    
-    // Ritorna true se la coda è piena
-    bool isFull() const {
-        return count >= MAX_DOWNLINK_QUEUE_SIZE;
-    }
-    
-    // Verifica se si può aggiungere un elemento per un DevAddr specifico
-    bool canAddForDevAddr(uint32_t devAddr) const {
-        if (count >= MAX_DOWNLINK_QUEUE_SIZE) {
-            return false;
+    // Record aperto per DevAddr
+    PendingRxWindow* findWaiting(uint32_t devAddr) {
+        for (uint8_t i = 0; i < MAX_PENDING_RX_WINDOWS; i++) {
+            if (windows[i].active && windows[i].devAddr == devAddr) {
+                return &windows[i];
+            }
         }
-        uint8_t countForDev = countByDevAddr(devAddr);
-        return countForDev < MAX_DOWNLINK_PER_DEVADDR;
+        return nullptr;
     }
     
-    // Ritorna il numero di slot disponibili per un DevAddr specifico
-    uint8_t availableSlotsForDevAddr(uint32_t devAddr) const {
-        uint8_t countForDev = countByDevAddr(devAddr);
-        if (countForDev >= MAX_DOWNLINK_PER_DEVADDR) {
-            return 0;
+    // Record il cui uplink dista esattamente un numero intero di secondi da
+    // txTmst (il NS calcola txpk.tmst = rxpk.tmst + RX delay).
+    // Funziona anche per i join-accept, dove il DevAddr non è leggibile.
+    PendingRxWindow* findWaitingByTmst(uint32_t txTmst, uint32_t maxDelayUs) {
+        for (uint8_t i = 0; i < MAX_PENDING_RX_WINDOWS; i++) {
+            if (windows[i].active) {
+                uint32_t delay = txTmst - windows[i].rxTmst;
+                if (delay > 0 && delay <= maxDelayUs && delay % 1000000 == 0) {
+                    return &windows[i];
+                }
+            }
         }
-        return MAX_DOWNLINK_PER_DEVADDR - countForDev;
+        return nullptr;
     }
     
-    // Trova il primo elemento con un specifico DevAddr
-    PullRespPacket* findFirstByDevAddr(uint32_t devAddr) {
-        for (uint8_t i = 0; i < MAX_DOWNLINK_QUEUE_SIZE; i++) {
-            if (queue[i].isValid() && queue[i].responseData.devAddr == devAddr) {
-                return &queue[i];
-            }
+    void close(PendingRxWindow* window) {
+        if (window != nullptr) {
+            *window = PendingRxWindow();
         }
-        return nullptr;
     }
     
-    // Trova il primo elemento con immediate=true (Classe C)
-    PullRespPacket* findFirstImmediate() {
-        for (uint8_t i = 0; i < MAX_DOWNLINK_QUEUE_SIZE; i++) {
-            if (queue[i].isValid() && queue[i].responseData.txpk.imme) {
-                return &queue[i];
+    // Chiude i record più vecchi di maxAgeUs.
+    // Ritorna il numero di record chiusi.
+    uint8_t expire(uint32_t now, uint32_t maxAgeUs) {
+        uint8_t expired = 0;
+        for (uint8_t i = 0; i < MAX_PENDING_RX_WINDOWS; i++) {
+            if (windows[i].active && now - windows[i].rxTmst > maxAgeUs) {
+                windows[i] = PendingRxWindow();
+                expired++;
             }
         }
-        return nullptr;
+        return expired;
     }
     
-    // Conta quanti elementi ci sono per un specifico DevAddr
-    uint8_t countByDevAddr(uint32_t devAddr) const {
+    uint8_t activeCount() const {
         uint8_t cnt = 0;
-        for (uint8_t i = 0; i < MAX_DOWNLINK_QUEUE_SIZE; i++) {
-            if (queue[i].isValid() && queue[i].responseData.devAddr == devAddr) {
-                cnt++;
-            }
+        for (uint8_t i = 0; i < MAX_PENDING_RX_WINDOWS; i++) {
+            if (windows[i].active) cnt++;
         }
         return cnt;
     }
+};
 
-        // Elimina un elemento dalla coda dato il suo indice
-    // Ritorna true se eliminato con successo
-    bool removeAt(uint8_t index) {
-        // Verifica che l'indice sia valido
-        if (index >= MAX_DOWNLINK_QUEUE_SIZE) {
-            return false;
-        }
-        
-        // Verifica che l'elemento sia valido (non vuoto)
-        if (!queue[index].isValid()) {
-            return false;
-        }
-        
-        // Invalida l'elemento (resetta a zero)
-        memset(&queue[index], 0, sizeof(PullRespPacket));
-        
-        // Decrementa il contatore
-        count--;
-        
-        return true;
-    }
-
-    // Elimina un elemento dalla coda dato il puntatore
-    bool remove(PullRespPacket* packet) {
-        if (packet == nullptr) return false;
-        uint8_t index = (packet - queue);
-        if (index >= MAX_DOWNLINK_QUEUE_SIZE) {
-            return false;
-        }
-        return removeAt(index);
-    }
-
-
-  
-
-    // Accede a un elemento per indice (senza validazione)
-    PullRespPacket& operator[](uint8_t index) {
-        return queue[index];
-    }
-    
-    const PullRespPacket& operator[](uint8_t index) const {
-        return queue[index];
-    }
-    
-    
-    // Svuota completamente la coda
-    void clear() {
-        memset(queue, 0, sizeof(queue));
-        count = 0;
-    }
-    
-
-    
-    // Stampa informazioni di debug sulla coda
-    void printDebug() const {
-        Serial.printf("[QUEUE] Elementi nella coda: %d/%d\n", count, MAX_DOWNLINK_QUEUE_SIZE);
-        Serial.printf("[QUEUE] Limite per DevAddr: %d messaggi\n", MAX_DOWNLINK_PER_DEVADDR);
-        
-        // Raggruppa per DevAddr
-        uint32_t seenDevAddrs[10] = {0};
-        uint8_t seenCount = 0;
-        
-        for (uint8_t i = 0; i < MAX_DOWNLINK_QUEUE_SIZE; i++) {
-            if (queue[i].isValid()) {
-                bool alreadySeen = false;
-                for (uint8_t j = 0; j < seenCount; j++) {
-                    if (seenDevAddrs[j] == queue[i].responseData.devAddr) {
-                        alreadySeen = true;
-                        break;
-                    }
-                }
-                
-                if (!alreadySeen) {
-                    seenDevAddrs[seenCount++] = queue[i].responseData.devAddr;
-                }
-            }
-        }
-        
-        // Stampa per ogni DevAddr
-        for (uint8_t i = 0; i < seenCount; i++) {
-            uint32_t devAddr = seenDevAddrs[i];
-            uint8_t countForDev = countByDevAddr(devAddr);
-            Serial.printf("[QUEUE] DevAddr 0x%08X: %d/%d messaggi\n", 
-                         devAddr, countForDev, MAX_DOWNLINK_PER_DEVADDR);
-            
-            // Stampa dettagli slot
-            for (uint8_t j = 0; j < MAX_DOWNLINK_QUEUE_SIZE; j++) {
-                if (queue[j].isValid() && queue[j].responseData.devAddr == devAddr) {
-                    Serial.printf("[QUEUE]   Slot %d: ClasseC=%s, FPort=%d, Token=0x%04X\n",
-                                 j, queue[j].responseData.txpk.imme ? "SI" : "NO", 
-                                 queue[j].responseData.fport, queue[j].token);
-                }
-            }
-        }
-    }
+// ===========================
+// RECORD UPLINK (radio task → network task)
+// ===========================
+// Frame LoRa già letto dalla radio, passato al network task tramite SpscRing.
+// Dimensione fissa: nessuna allocazione nel percorso radio.
+struct RxFrame {
+    uint32_t tmst = 0;            // Contatore concentratore (µs) alla ricezione
+    float rssi = 0.0;             // RSSI pacchetto (dBm)
+    float snr = 0.0;              // SNR pacchetto (dB)
+    uint16_t length = 0;          // Lunghezza payload
+    uint8_t payload[256];         // Payload LoRa grezzo
 };
@@ -2,52 +2,17 @@
 #include <ArduinoJson.h>
 #include <time.h>
 #include <WiFi.h>
+#include <esp_timer.h>
 
 // ===========================
-// BASE64 ENCODING/DECODING
+// TEMPO CONCENTRATORE (tmst)
 // ===========================
-String encodeBase64(uint8_t* data, size_t length) {
-    const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    String result;
-    
-    for (size_t i = 0; i < length; i += 3) {
-        uint32_t b = (data[i] << 16) | ((i + 1 < length ? data[i + 1] : 0) << 8) | (i + 2 < length ? data[i + 2] : 0);
-        
-        result += base64_chars[(b >> 18) & 0x3F];
-        result += base64_chars[(b >> 12) & 0x3F];
-        result += (i + 1 < length) ? base64_chars[(b >> 6) & 0x3F] : '=';
-        result += (i + 2 < length) ? base64_chars[b & 0x3F] : '=';
-    }
-    
-    return result;
-}
-
-size_t decodeBase64(const char* base64Str, uint8_t* output, size_t maxLen) {
-    const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    size_t inLen = strlen(base64Str);
-    size_t outLen = 0;
-    
-    uint32_t val = 0;
-    int valb = -8;
-    
-    for (size_t i = 0; i < inLen; i++) {
-        char c = base64Str[i];
-        if (c == '=') break;
-        
-        const char* pos = strchr(base64_chars, c);
-        if (pos == nullptr) continue;
-        
-        val = (val << 6) | (pos - base64_chars);
-        valb += 6;
-        
-        if (valb >= 0) {
-            if (outLen >= maxLen) break;
-            output[outLen++] = (val >> valb) & 0xFF;
-            valb -= 8;
-        }
-    }
-    
-    return outLen;
+// Contatore libero a 32 bit in µs (esp_timer, wrap ogni ~71.6 minuti).
+// Base tempi unica per rxpk.tmst e txpk.tmst, come il concentratore SX1301.
+// Monotono: il wrap è gestito con aritmetica modulare (tmstDelta()).
+// Sempre inline: viene letto anche dalla ISR DIO1 in IRAM.
+inline __attribute__((always_inline)) uint32_t tmstNow() {
+    return (uint32_t)esp_timer_get_time();
 }
 
 // ===========================
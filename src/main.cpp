@@ -8,11 +8,13 @@
  * - OLED display
  * - WiFi connectivity
  * - NTP time synchronization
+ * - Radio task e network task su core separati (FreeRTOS),
+ *   collegati da ring buffer lock-free SPSC
  */
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WiFiUdp.h>
+#include <lwip/sockets.h>
 #include <SPI.h>
 #include <Wire.h>
 #include <RadioLib.h>
@@ -25,6 +27,25 @@
 #include "variant.h"
 #include "common.h"
 #include "TypeDef.h"
+#include "SpscRing.h"
+#include "DownlinkScheduler.h"
+#include "DownlinkQueue.h"
+#include "Airtime.h"
+#include "RxpkWriter.h"
+#include "BlockPool.h"
+#define LOG_TIMESTAMP() tmstNow()
+#include "Log.h"
+#define TRACE_CLOCK() ESP.getCycleCount()
+#define TRACE_CYCLES_PER_US (F_CPU / 1000000)
+#include "Trace.h"
+#include "StallProfiler.h"
+#include "DeafTime.h"
+#include "RadioIrq.h"
+#include "RxReadout.h"
+#include "EchoFilter.h"
+#include "TxStaging.h"
+#include "RadioProfile.h"
+#include "DutyCycle.h"
 
 // ===========================
 // OLED DISPLAY
@@ -40,12 +61,50 @@ U8G2_SSD1306_128X64_NONAME_F_HW_I2C display(U8G2_R0, /* reset=*/ RESET_OLED);
 // RADIO CONFIGURATION
 // ===========================
 SPIClass loraSPI(HSPI);
-SX1262 radio = new Module(LORA_CS, LORA_DIO1, LORA_RESET, LORA_DIO2, loraSPI);
+
+// HAL Arduino di RadioLib con contatore: ogni comando SPI (nostro o
+// interno a RadioLib) apre una transazione. Usato solo dal radio task
+// (e da setup() prima che parta).
+class CountingSpiHal : public ArduinoHal {
+public:
+    explicit CountingSpiHal(SPIClass& spi) : ArduinoHal(spi) {}
+    
+    void spiBeginTransaction() override {
+        transactions++;
+        ArduinoHal::spiBeginTransaction();
+    }
+    
+    uint32_t transactions = 0;
+};
+
+CountingSpiHal loraHal(loraSPI);
+SX1262 radio = new Module(&loraHal, LORA_CS, LORA_DIO1, LORA_RESET, LORA_DIO2);
+
+// Bus per lettura a raffica e TX in due fasi (RxReadout.h, TxStaging.h):
+// comandi grezzi sul Module
+struct RadioLibBus {
+    Module* mod;
+    
+    bool read(const uint8_t* cmd, uint8_t cmdLen, uint8_t* data, size_t len) {
+        return mod->SPIreadStream((uint8_t*)cmd, cmdLen, data, len) == RADIOLIB_ERR_NONE;
+    }
+    
+    bool write(const uint8_t* cmd, uint8_t cmdLen, const uint8_t* data, size_t len) {
+        return mod->SPIwriteStream((uint8_t*)cmd, cmdLen, (uint8_t*)data, len) == RADIOLIB_ERR_NONE;
+    }
+};
+
+// Transazioni SPI dell'ultima lettura di un pacchetto (payload + stato)
+uint32_t rxReadoutTransactions = 0;
+uint32_t rxReadoutErrors = 0;
 
 // ===========================
 // NETWORK CONFIGURATION
 // ===========================
-WiFiUDP udpClient;
+// Socket UDP non bloccante verso il NS: letto e scritto solo dal network
+// task, il task udp_watch si limita a select() per svegliarlo
+int udpSocket = -1;
+struct sockaddr_in serverAddr;
 IPAddress serverIP;
 
 const char* version = "1.0.0";
@@ -54,6 +113,7 @@ const char* version = "1.0.0";
 // GATEWAY STATE
 // ===========================
 uint64_t gatewayId = 0;
+RxpkWriter rxpkWriter;  // Buffer PUSH_DATA rxpk, usato solo dal network task
 uint32_t packetsReceived = 0;
 uint32_t packetsForwarded = 0;
 unsigned long lastDisplayUpdate = 0;
@@ -61,24 +121,183 @@ unsigned long lastNtpUpdate = 0;
 unsigned long lastPullData = 0;
 bool radioInitialized = false;
 
-
-// Interrupt flag for packet reception
-volatile bool packetReceived = false;
-
-// Flag per ignorare la ricezione subito dopo downlink
-bool justTransmitted = false;
+// Eco dei downlink: ring delle ultime TX (solo radio task)
+#define ECHO_RING_SIZE 4
+EchoFilter<ECHO_RING_SIZE> echoFilter;
 
 // Debug counters
 uint32_t totalInterrupts = 0;
 uint32_t crcErrors = 0;
 uint32_t timeouts = 0;
 uint32_t otherErrors = 0;
+uint32_t headerErrors = 0;
+uint32_t irqStaleEvents = 0;   // Eventi DIO1 con flag già consumati (burst)
+
+// ===========================
+// TASK CONFIGURATION
+// ===========================
+// Radio task: ISR → readout → timestamp. Sul core applicativo, a priorità
+// più alta di loop() (che resta per OTA, display, NTP e statistiche).
+// Network task: serializzazione → UDP → PULL_RESP. Sul core 0 insieme
+// allo stack WiFi/lwIP, così una send lenta non ritarda mai la radio.
+#ifndef RADIO_TASK_CORE
+#define RADIO_TASK_CORE 1
+#endif
+#ifndef RADIO_TASK_PRIORITY
+#define RADIO_TASK_PRIORITY 5
+#endif
+#ifndef NETWORK_TASK_CORE
+#define NETWORK_TASK_CORE 0
+#endif
+#ifndef NETWORK_TASK_PRIORITY
+#define NETWORK_TASK_PRIORITY 4
+#endif
+#define RADIO_TASK_STACK 6144
+#define NETWORK_TASK_STACK 8192
+#define NETWORK_TASK_IDLE_MS 100  // Attesa massima senza eventi (PULL_DATA, stat)
+#define UDP_WATCH_TASK_STACK 2048
+
+// Eventi notificati al radio task (bit di xTaskNotify)
+#define RADIO_EVT_DIO1      (1UL << 0)  // IRQ DIO1 dalla radio
+#define RADIO_EVT_DOWNLINK  (1UL << 1)  // Nuovo downlink nel ring
+#define RADIO_EVT_STANDBY   (1UL << 2)  // Radio in standby (OTA)
+#define RADIO_EVT_RESUME    (1UL << 3)  // Radio di nuovo in ascolto
+#define RADIO_EVT_TX_TIMER  (1UL << 4)  // Timer one-shot: pre-roll del prossimo downlink
+
+// Ring buffer tra i task (dimensioni potenza di 2)
+#define UPLINK_RING_SIZE 8
+#define DOWNLINK_RING_SIZE 4
+
+SpscRing<RxFrame, UPLINK_RING_SIZE> uplinkRing;             // radio → network
+SpscRing<DownlinkFrame, DOWNLINK_RING_SIZE> downlinkRing;   // network → radio
+SpscRing<TxAck, 8> txAckRing;                               // radio → network (esito TX_ACK)
+uint32_t uplinkRingDrops = 0;
+uint32_t downlinkRingDrops = 0;
+uint32_t txAckRingDrops = 0;     // Scritto solo dal radio task
+
+// Buffer di cattura RX: gli slot liberi di uplinkRing. Con il ring pieno
+// il frame si cattura qui (solo radio task) e poi si scarta.
+RxFrame rxSpareFrame;
+
+// Riarmo RX: da RxDone (tmst della ISR) a startReceive() completato.
+// Obiettivo: sotto RX_REARM_BUDGET_US, la radio è sorda in questo tratto.
+#define RX_REARM_BUDGET_US 1000
+
+struct RxRearmStats {
+    uint32_t count = 0;
+    uint32_t lastUs = 0;
+    uint32_t maxUs = 0;
+    uint64_t sumUs = 0;
+    uint32_t overBudget = 0;  // Riarmi oltre RX_REARM_BUDGET_US
+} rxRearmStats;
+
+// Ricezione UDP (solo network task): a ogni passata vengono letti tutti i
+// datagram in coda in lwIP, fino al budget, in buffer del pool
+#define UDP_RX_DATAGRAM_SIZE 1024  // Datagram Semtech più grande: PULL_RESP con payload max
+#define UDP_RX_POOL_SIZE 4         // Budget a conteggio: datagram per passata
+#define UDP_RX_BUDGET_US 5000      // Budget di tempo per passata
+
+BlockPool<UDP_RX_DATAGRAM_SIZE + 1, UDP_RX_POOL_SIZE> udpRxPool;
+
+struct UdpRxStats {
+    uint32_t datagrams = 0;   // Datagram ricevuti
+    uint32_t truncated = 0;   // Scartati: più grandi di UDP_RX_DATAGRAM_SIZE
+    uint32_t invalid = 0;     // Scartati: header Semtech non valido
+    uint32_t deferred = 0;    // Passate chiuse per budget con datagram ancora in coda
+    uint32_t pushAcks = 0;    // PUSH_ACK: conferme dei PUSH_DATA, nessuna azione
+    
+    // Latenza arrivo datagram (socket leggibile) → PULL_RESP nel ring
+    uint32_t enqueued = 0;
+    uint32_t lastLatencyUs = 0;
+    uint32_t maxLatencyUs = 0;
+    uint64_t sumLatencyUs = 0;
+} udpRxStats;
+
+// Log differiti dei percorsi caldi: un ring per task produttore,
+// formattati e scritti su Serial dal task di log a bassa priorità
+#define LOG_RING_SIZE 64
+#define LOG_TASK_CORE 0
+#define LOG_TASK_PRIORITY 1
+#define LOG_TASK_STACK 3072
+#define LOG_TASK_PERIOD_MS 20
+
+LogRing<LOG_RING_SIZE> radioLog;     // Produttore: radio task
+LogRing<LOG_RING_SIZE> networkLog;   // Produttore: network task
+
+// Istogrammi per stadio della pipeline (TRACE_ENABLED = 0 li elimina).
+// Riepilogo in [STATS], dump completo con 't' su seriale.
+#if TRACE_ENABLED
+PipelineTrace pipelineTrace;
+#endif
+
+// Profiler degli stalli: tempo per sezione di ogni iterazione di loop() e
+// del network task. Budget 0 = ToA del frame LoRaWAN più corto con la
+// configurazione radio (calcolato in setup)
+#ifndef STALL_BUDGET_US
+#define STALL_BUDGET_US 0
+#endif
+#define STALL_MIN_FRAME_SIZE 13  // MHDR + FHDR + MIC senza FPort/payload
+
+enum LoopSection : uint8_t {
+    LOOP_OTA, LOOP_DISPLAY, LOOP_NTP, LOOP_STATS, LOOP_SERIAL, LOOP_SECTIONS
+};
+const char* const LOOP_SECTION_NAMES[LOOP_SECTIONS] = {
+    "OTA", "DISPLAY", "NTP", "STATS", "SERIAL"
+};
+StallProfiler<LOOP_SECTIONS> loopProfiler(LOOP_SECTION_NAMES, STALL_BUDGET_US);
+
+enum NetworkSection : uint8_t {
+    NET_UPLINK, NET_TX_ACK, NET_PULL_DATA, NET_UDP_RX, NET_STAT, NET_SECTIONS
+};
+const char* const NETWORK_SECTION_NAMES[NET_SECTIONS] = {
+    "UPLINK", "TX_ACK", "PULL_DATA", "UDP_RX", "STAT"
+};
+StallProfiler<NET_SECTIONS> networkProfiler(NETWORK_SECTION_NAMES, STALL_BUDGET_US);
+
+enum RadioSection : uint8_t {
+    RADIO_IRQ, RADIO_DL_QUEUE, RADIO_DL_SCHEDULED, RADIO_DL_CLASS_C, RADIO_SECTIONS
+};
+const char* const RADIO_SECTION_NAMES[RADIO_SECTIONS] = {
+    "IRQ", "DL_QUEUE", "DL_SCHED", "DL_CLASS_C"
+};
+StallProfiler<RADIO_SECTIONS> radioProfiler(RADIO_SECTION_NAMES, STALL_BUDGET_US);
+
+TaskHandle_t udpWatchTaskHandle = nullptr;
+// tmst in cui udp_watch ha visto il socket leggibile (0 = già consumato)
+volatile uint32_t udpReadableTmst = 0;
+
+TaskHandle_t radioTaskHandle = nullptr;
+TaskHandle_t networkTaskHandle = nullptr;
+
+// Eventi ricevuti ma non ancora gestiti (solo radio task)
+uint32_t radioPendingEvents = 0;
+
+// Attesa massima del radio task senza eventi: chiude le finestre del
+// ledger del tempo sordo anche quando non succede nulla
+#define RADIO_TASK_TICK_MS 1000
+
+// Intervalli con la radio fuori RX, per motivo (scritto dal radio task)
+DeafTimeLedger deafTime;
+
+// Eventi DIO1 dalla ISR, in ordine, con il tmst del fronte (RxDone):
+// "RX finished" come il concentratore Semtech, indipendente da log e
+// tempi di lettura SPI. Ring pieno = overrun contato.
+#define RADIO_IRQ_RING_SIZE 8
+RadioIrqQueue<RADIO_IRQ_RING_SIZE> radioIrqs;
 
 // ===========================
 // INTERRUPT SERVICE ROUTINE
 // ===========================
 void IRAM_ATTR setPacketReceivedFlag() {
-    packetReceived = true;
+    // Prima di tutto: il timestamp dell'evento, in coda per il radio task
+    radioIrqs.pushFromIsr(tmstNow());
+    
+    if (radioTaskHandle == nullptr) return;
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    xTaskNotifyFromISR(radioTaskHandle, RADIO_EVT_DIO1, eSetBits, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken) {
+        portYIELD_FROM_ISR();
+    }
 }
 
 // ===========================
@@ -102,24 +321,146 @@ void initWiFi();
 void initOTA();
 void initLoRa();
 void initNTP();
-void sendUdpPacket(const char* jsonData);
-void handleLoRaPacket();
+void startGatewayTasks();
+void radioTask(void* param);
+void networkTask(void* param);
+void initUdpSocket();
+void udpWatchTask(void* param);
+void logTask(void* param);
+void flushLogEntry(const LogEntry& entry);
+void printTraceSummary();
+void printStallSummary();
+void printDeafTimeSummary();
+void printDownlinkQueueMemory();
+int restartReceive();
+void recordRxRearm(uint32_t rxDoneTmst);
+void dumpTraceHistograms();
+void dumpTxStartErrorHistogram();
+size_t writeSemtechHeader(uint8_t* out, uint16_t token, SemtechMessageType type);
+void sendDatagram(const uint8_t* data, size_t length);
+void handleRadioIrqs();
+uint16_t readRadioIrqStatus();
+void handleLoRaPacket(const RadioIrqEvent& irq);
+void forwardUplink(const RxFrame& frame);
 void sendStatPacket();
 void sendPullData();
-void handleUdpDownlink();
-void sendDownlinkResponse(unsigned long rxTimestamp, PullRespPacket *pullRespPacket);
-bool transmitDownlink(uint8_t* data, size_t length, unsigned long rxTimestamp);
-void sendTxAck(uint16_t token);
+bool drainUdpDatagrams();
+void handleUdpDatagram(const uint8_t* data, size_t length, uint32_t arrivalTmst);
+bool startDownlinkTx(const DownlinkEntry& entry);
+RadioProfile downlinkProfile(const DownlinkTxParams& tx);
+bool applyRadioProfile(const RadioProfile& profile, bool forTx, uint16_t token);
+int restoreRxProfile(uint16_t token);
+void finishDownlinkTx(uint32_t doneTmst, bool timedOut);
+void sendTxAck(const TxAck& ack);
+void queueTxAck(const TxAck& ack);
+void queueTxAck(uint16_t token, TxAckError error);
 void decodeLoRaWANPacket(uint8_t *data, size_t length);
 
 
 
+// Coda downlink e finestre RX: accessibili solo dal radio task
 DownlinkQueue dowQueue = DownlinkQueue();
+PendingRxWindows rxWindows;
+
+// Età massima di un uplink in attesa di PULL_RESP (join-accept RX2 = 6 s)
+#define RX_WINDOW_MAX_DELAY_US 7000000UL
+
+// Scheduler downlink su txpk.tmst + timer one-shot esp_timer
+DownlinkScheduler txScheduler;
+esp_timer_handle_t txTimer = nullptr;
+// Stato del timer, solo radio task: azzerato quando arriva RADIO_EVT_TX_TIMER
+bool txTimerArmed = false;
+uint32_t txTimerTargetTmst = 0;
+uint32_t txTimerErrors = 0;     // start/stop di esp_timer falliti
+
+// Downlink in trasmissione (solo radio task): SetTx dato, la fine arriva
+// come TxDone su DIO1. Il payload è già nel buffer della radio, quindi il
+// blocco del pool torna libero subito.
+struct TxInFlight {
+    bool active = false;
+    bool immediate = false;    // Classe C
+    uint16_t token = 0;
+    uint16_t length = 0;
+    uint32_t hash = 0;         // echoHash del payload, per l'EchoFilter
+    uint32_t txTmst = 0;       // Istante richiesto (Classe A)
+    uint32_t rxTmst = 0;       // Uplink associato (0 = nessuno)
+    uint32_t startTmst = 0;    // Comando TX (SetTx / startTransmit)
+    uint32_t airtimeUs = 0;
+    int32_t startErrorUs = 0;
+    int8_t powerDbm = 0;       // Potenza usata
+    bool powerLimited = false; // powe del txpk ridotta a TX_MAX_POWER_DBM
+} txInFlight;
+
+// Senza TxDone entro ToA + margine la TX è considerata persa
+#define TX_DONE_TIMEOUT_MARGIN_US 100000UL
+
+struct TxDurationStats {
+    uint32_t count = 0;          // TX concluse con TxDone
+    uint32_t lastUs = 0;         // Comando TX → TxDone (tmst della ISR)
+    uint32_t lastAirtimeUs = 0;  // ToA calcolato dello stesso frame
+    uint32_t maxUs = 0;
+    uint32_t startErrors = 0;    // Avvio TX fallito
+    uint32_t timeouts = 0;       // Nessun TxDone entro il margine
+} txDurationStats;
+
+// TX in due fasi (TxStaging.h): preparazione nel pre-roll, SetTx all'istante
+struct TxStageStats {
+    uint32_t prepared = 0;
+    uint32_t maxPrepareUs = 0;
+    uint32_t overBudget = 0;     // Preparazioni oltre TX_PREPARE_BUDGET_US
+    uint32_t firedLate = 0;      // Pronte dopo l'istante, ma nella tolleranza
+    uint32_t abandoned = 0;      // Pronte oltre la tolleranza: TX annullata
+} txStageStats;
+
+// Potenza massima per i downlink (powe del txpk limitata a questo valore)
+#ifndef TX_MAX_POWER_DBM
+#define TX_MAX_POWER_DBM LORA_OUTPUT_POWER
+#endif
+
+// Profili radio (RadioProfile.h): RX dalla config, TX dal txpk. La cache
+// scrive solo i parametri che cambiano tra RX e TX (solo radio task)
+RadioShadow radioShadow;
+RadioProfile rxProfile;
+
+// Banda ammessa per i downlink (EU868): fuori banda TX_ACK TX_FREQ
+#ifndef TX_FREQ_MIN_HZ
+#define TX_FREQ_MIN_HZ 863000000UL
+#endif
+#ifndef TX_FREQ_MAX_HZ
+#define TX_FREQ_MAX_HZ 870000000UL
+#endif
+
+// Duty cycle EU868 (DutyCycle.h): ogni TX partita è registrata; con
+// DUTY_CYCLE_ENFORCE i downlink oltre il budget della sottobanda sono
+// rifiutati con DUTY_CYCLE_TX_ACK (COLLISION_PACKET per i NS che non
+// conoscono DUTY_CYCLE). Solo radio task
+#ifndef DUTY_CYCLE_ENFORCE
+#define DUTY_CYCLE_ENFORCE 1
+#endif
+#ifndef DUTY_CYCLE_TX_ACK
+#define DUTY_CYCLE_TX_ACK TxAckError::DUTY_CYCLE
+#endif
+DutyCycleLedger dutyCycle;
+
+// TX_ACK inviati per esito (indice TxAckError, solo network task)
+uint32_t txAckSent[TX_ACK_ERROR_COUNT] = {};
+
+struct RadioSwitchStats {
+    uint32_t switches = 0;       // Cambi di profilo (RX → TX e TX → RX)
+    uint32_t writes = 0;         // Transazioni SPI eseguite
+    uint32_t saved = 0;          // Transazioni evitate dalla cache
+    uint8_t lastWrites = 0;
+    uint8_t lastSaved = 0;
+    uint32_t errors = 0;
+} radioSwitchStats;
 
 // ===========================
 // SETUP
 // ===========================
 void setup() {
+    // Radio sorda (REINIT) dall'avvio fino al primo startReceive()
+    deafTime.begin(tmstNow());
+    
     // Initialize USB Serial
     Serial.begin(115200);
     
@@ -155,9 +496,28 @@ void setup() {
     // Generate Gateway ID from MAC
     generateGatewayId(&gatewayId);
     
+    // Campi costanti del PUSH_DATA (frequenza arrotondata a 100 Hz)
+    rxpkWriter.init(gatewayId, (uint32_t)(LORA_FREQUENCY * 10000.0 + 0.5) * 100,
+                    LORA_SPREADING_FACTOR, (uint16_t)LORA_BANDWIDTH, LORA_CODING_RATE);
+    
     // Initialize LoRa radio
     initLoRa();
     
+    // Budget degli stalli: un'iterazione più lunga può coprire un intero frame
+    if (STALL_BUDGET_US == 0) {
+        uint32_t budgetUs = loraTimeOnAirUs(LORA_SPREADING_FACTOR, (uint32_t)(LORA_BANDWIDTH * 1000.0),
+                                            LORA_CODING_RATE, LORA_PREAMBLE_LENGTH,
+                                            STALL_MIN_FRAME_SIZE, LORA_CRC);
+        loopProfiler.setBudgetUs(budgetUs);
+        networkProfiler.setBudgetUs(budgetUs);
+        radioProfiler.setBudgetUs(budgetUs);
+    }
+    Serial.printf("[STALL] Budget per iterazione: %lu us\n", loopProfiler.getBudgetUs());
+    
+    // Avvia radio task e network task
+    startGatewayTasks();
+    printDownlinkQueueMemory();
+    
     digitalWrite(LED_PIN, HIGH);  // LED off
     
     Serial.println("\n===================================");
@@ -165,48 +525,449 @@ void setup() {
     Serial.println("===================================\n");
 }
 
-void processDownlinkQueue() {
-  PullRespPacket *pullRespPacket = dowQueue.findFirstImmediate();
-  if (pullRespPacket) {
-    pullRespPacket->responseData.txpk.data;
+// ===========================
+// RADIO TASK
+// ===========================
+// Attende eventi dal radio task (ISR, ring downlink, OTA) fino a timeout.
+// Gli eventi si accumulano in radioPendingEvents finché non vengono gestiti.
+uint32_t waitRadioEvents(TickType_t timeout) {
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, timeout);
+    radioPendingEvents |= events;
+    return radioPendingEvents;
+}
 
-    radio.invertIQ(true);
-    int state = radio.transmit(pullRespPacket->responseData.txpk.data, pullRespPacket->responseData.txpk.size);
-    radio.invertIQ(false);
-    digitalWrite(LED_PIN, HIGH);
-    justTransmitted = true;
+// Time-on-air del downlink con i parametri del txpk (default: config radio)
+uint32_t downlinkAirtimeUs(const DownlinkInfo& info) {
+    const DownlinkTxParams& tx = info.tx;
+    uint8_t sf = tx.sf != 0 ? tx.sf : LORA_SPREADING_FACTOR;
+    uint16_t bwKHz = loraBandwidthKHz(tx.bandwidth);
+    if (bwKHz == 0) {
+        bwKHz = (uint16_t)LORA_BANDWIDTH;
+    }
+    uint8_t crDenom = tx.crDenom != 0 ? tx.crDenom : LORA_CODING_RATE;
+    // Downlink LoRaWAN: header esplicito, senza CRC
+    return loraTimeOnAirUs(sf, bwKHz * 1000UL, crDenom, tx.preamble, info.length, false);
+}
 
-    if (state == RADIOLIB_ERR_NONE) {
-      Serial.println("[PULL] ✅ Messaggio Classe C trasmesso con successo!");
-      sendTxAck(pullRespPacket->token);
-      dowQueue.remove(pullRespPacket);
-      stats.tx_emitted++;
+// Secondi dall'avvio (esp_timer a 64 bit): base tempo del duty cycle
+uint32_t uptimeSeconds() {
+    return (uint32_t)(esp_timer_get_time() / 1000000LL);
+}
+
+// Parametri del txpk che il gateway non può rispettare, prima della coda
+TxAckError checkDownlinkParams(const DownlinkTxParams& tx) {
+    if (tx.hasTmms() && !tx.hasTmst() && !tx.isImmediate()) {
+        return TxAckError::GPS_UNLOCKED;  // Solo tempo GPS: nessun GPS a bordo
+    }
+    if (tx.freqHz != 0 && (tx.freqHz < TX_FREQ_MIN_HZ || tx.freqHz > TX_FREQ_MAX_HZ)) {
+        return TxAckError::TX_FREQ;
+    }
+    if (tx.power < SX1262_POWER_MIN_DBM) {
+        return TxAckError::TX_POWER;  // Sopra il massimo si riduce (avviso nel TX_ACK)
+    }
+    return TxAckError::NONE;
+}
+
+// Inserisce un downlink nella coda JIT: Classe C nella lane immediata,
+// Classe A programmati su txpk.tmst (o RX1 dall'uplink se manca tmst)
+void enqueueDownlink(const DownlinkFrame& frame) {
+    const DownlinkTxParams& tx = frame.info.tx;
+    uint32_t devAddr = frame.info.devAddr;
+    uint16_t token = frame.info.token;
+    uint32_t airtimeUs = downlinkAirtimeUs(frame.info);
+    QueueResult result;
+    
+    TxAckError paramsError = checkDownlinkParams(tx);
+    if (paramsError != TxAckError::NONE) {
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, QUEUE_TX_PARAMS, devAddr, (uint8_t)paramsError);
+        queueTxAck(token, paramsError);
+        return;
+    }
+    
+    // Canale fuori dalle sottobande o budget già esaurito: subito
+    // TX_ACK, il NS può usare l'altra finestra (RX1 e RX2 sono in
+    // sottobande diverse)
+    RadioProfile profile = downlinkProfile(tx);
+    int8_t band = eu868SubBand(profile.freqHz, profile.bwKHz * 1000UL);
+    if (band < 0) {
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, QUEUE_TX_PARAMS, devAddr, (uint8_t)TxAckError::TX_FREQ);
+        queueTxAck(token, TxAckError::TX_FREQ);
+        return;
+    }
+    #if DUTY_CYCLE_ENFORCE
+    if (dutyCycle.check(band, airtimeUs, uptimeSeconds()) != DutyCycleResult::OK) {
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, QUEUE_DUTY_CYCLE, devAddr, band,
+                  dutyCycle.usedUs(band, uptimeSeconds()), airtimeUs);
+        queueTxAck(token, DUTY_CYCLE_TX_ACK);
+        return;
+    }
+    #endif
+    
+    if (tx.isImmediate()) {
+        result = dowQueue.addImmediate(frame, airtimeUs);
+        if (result == QueueResult::OK) {
+            LOG_DEFER(radioLog, LOG_LEVEL_INFO, QUEUE_CLASS_C, devAddr, airtimeUs);
+        }
     } else {
-      Serial.println("[PULL] ❌ Errore trasmissione messaggio Classe C");
+        uint32_t now = tmstNow();
+        PendingRxWindow* window = nullptr;
+        uint32_t txTmst;
+        if (tx.hasTmst()) {
+            // Il NS ha già calcolato l'istante: basta associarlo all'uplink
+            txTmst = tx.tmst;
+            window = rxWindows.findWaitingByTmst(txTmst, RX_WINDOW_MAX_DELAY_US);
+            if (window == nullptr) {
+                window = rxWindows.findWaiting(devAddr);
+            }
+        } else {
+            // Senza tmst: RX1 dall'ultimo uplink del DevAddr
+            window = rxWindows.findWaiting(devAddr);
+            if (window == nullptr) {
+                LOG_DEFER(radioLog, LOG_LEVEL_WARN, QUEUE_NO_WINDOW, devAddr);
+                queueTxAck(token, TxAckError::TOO_LATE);
+                return;
+            }
+            txTmst = window->rxTmst + RX1_DELAY * 1000UL;
+        }
+        
+        TxTiming timing = txScheduler.check(txTmst, now);
+        if (timing != TxTiming::OK) {
+            LOG_DEFER(radioLog, LOG_LEVEL_WARN, QUEUE_TIMING, devAddr, (uint8_t)timing, txTmst, now);
+            queueTxAck(token, timing == TxTiming::TOO_EARLY ? TxAckError::TOO_EARLY : TxAckError::TOO_LATE);
+            return;
+        }
+        
+        uint32_t rxTmst = window != nullptr ? window->rxTmst : 0;
+        result = dowQueue.schedule(frame, txTmst, airtimeUs, rxTmst);
+        if (result == QueueResult::OK) {
+            LOG_DEFER(radioLog, LOG_LEVEL_INFO, QUEUE_SCHEDULED, devAddr, txTmst,
+                      tmstDelta(txTmst, now), airtimeUs);
+            rxWindows.close(window);
+        }
+    }
+    
+    if (result != QueueResult::OK) {
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, QUEUE_REJECTED, devAddr, (uint8_t)result);
+        // Coda piena, limite per DevAddr o sovrapposizione: il NS può
+        // provare la finestra successiva
+        queueTxAck(token, TxAckError::COLLISION_PACKET);
+        LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, QUEUE_STATE, dowQueue.size(), DownlinkQueue::capacity(),
+                  dowQueue.immediateSize());
+    }
+}
+
+// Sposta i downlink ricevuti dal network task nella coda del radio task
+void drainDownlinkRing() {
+    uint8_t expired = rxWindows.expire(tmstNow(), RX_WINDOW_MAX_DELAY_US);
+    if (expired > 0) {
+        LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, RXWIN_EXPIRED, expired);
     }
+    
+    DownlinkFrame* frame;
+    while ((frame = downlinkRing.front()) != nullptr) {
+        TRACE_BEGIN(enqueueStart);
+        enqueueDownlink(*frame);
+        TRACE_END(pipelineTrace, DL_ENQUEUE, enqueueStart);
+        downlinkRing.release();
+    }
+    radioPendingEvents &= ~RADIO_EVT_DOWNLINK;
+}
+
+// Trasmette il primo downlink Classe C, se finisce prima del prossimo programmato
+void processDownlinkQueue() {
+  if (txInFlight.active) {
+    return;  // Radio occupata: si riprova al TxDone
+  }
+  DownlinkEntry *entry = dowQueue.nextImmediate();
+  if (entry) {
+    DownlinkEntry *next = dowQueue.nextScheduled();
+    if (next && tmstDelta(next->txTmst, tmstNow()) <
+                (int32_t)(entry->airtimeUs + txScheduler.getPreRollUs())) {
+      return;  // Invaderebbe il prossimo downlink programmato: dopo
+    }
+    // Stesso percorso della Classe A; esito e TX_ACK al TxDone.
+    // Anche se l'avvio fallisce il downlink esce dalla coda: niente
+    // tentativi ripetuti a ogni iterazione
+    startDownlinkTx(*entry);
+    dowQueue.popImmediate();
   }
 }
+
+// Ferma il timer TX. ESP_ERR_INVALID_STATE = già scaduto (la notifica è in
+// arrivo o già consegnata): non è un errore.
+void stopTxTimer() {
+    esp_err_t err = esp_timer_stop(txTimer);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        txTimerErrors++;
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, TX_TIMER_STOP_ERROR, (int32_t)err);
+    }
+    txTimerArmed = false;
+}
+
+// Arma il timer one-shot per il pre-roll del prossimo downlink (O(1)).
+// Il timer si ferma sempre prima di riavviarlo: una RADIO_EVT_TX_TIMER del
+// timer precedente, consegnata dopo un riarmo, azzera txTimerArmed con il
+// nuovo timer attivo e costa solo un riarmo in più, mai un avvio rifiutato.
+void armTxTimer() {
+    DownlinkEntry* next = dowQueue.nextScheduled();
+    if (next == nullptr) {
+        if (txTimerArmed) {
+            stopTxTimer();
+        }
+        return;
+    }
+    
+    if (txTimerArmed && txTimerTargetTmst == next->txTmst) {
+        return;  // Già armato per questo downlink
+    }
+    
+    stopTxTimer();
+    uint32_t delayUs = txScheduler.timerDelayUs(next->txTmst, tmstNow());
+    esp_err_t err = esp_timer_start_once(txTimer, delayUs > 0 ? delayUs : 1);
+    if (err != ESP_OK) {
+        // Non armato: si riprova al prossimo risveglio del radio task
+        txTimerErrors++;
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, TX_TIMER_START_ERROR, next->txTmst, delayUs, (int32_t)err);
+        return;
+    }
+    txTimerArmed = true;
+    txTimerTargetTmst = next->txTmst;
+}
+
+// Trasmette i downlink programmati il cui istante è dentro il pre-roll
+void serviceScheduledDownlinks() {
+    DownlinkEntry* entry = dowQueue.nextScheduled();
+    
+    while (entry != nullptr) {
+        uint32_t now = tmstNow();
+        uint16_t token = entry->info.token;
+        
+        if (txScheduler.check(entry->txTmst, now) == TxTiming::TOO_LATE) {
+            LOG_DEFER(radioLog, LOG_LEVEL_WARN, TX_MISSED, token, -tmstDelta(entry->txTmst, now));
+            queueTxAck(token, TxAckError::TOO_LATE);
+            dowQueue.popScheduled();
+        } else if (txScheduler.inPreRoll(entry->txTmst, now)) {
+            if (txInFlight.active) {
+                break;  // TX in corso: si riprova al TxDone (o diventa TOO_LATE)
+            }
+            // Esito e TX_ACK al TxDone
+            startDownlinkTx(*entry);
+            dowQueue.popScheduled();
+            break;  // Una TX alla volta
+        } else {
+            break;  // Il prossimo non è ancora dovuto: ci pensa il timer
+        }
+        
+        entry = dowQueue.nextScheduled();
+    }
+    
+    armTxTimer();
+}
+
+// Callback esp_timer (task esp_timer): sveglia il radio task per il pre-roll.
+// Non tocca txTimerArmed, che appartiene al radio task.
+void txTimerCallback(void* arg) {
+    xTaskNotify(radioTaskHandle, RADIO_EVT_TX_TIMER, eSetBits);
+}
+
+void radioTask(void* param) {
+    bool standby = false;
+    
+    for (;;) {
+        // Blocca finché non arriva un evento (ISR, ring, timer TX): nessun
+        // polling. Con una TX in corso l'attesa si ferma alla sua scadenza.
+        uint32_t events = radioPendingEvents;
+        if (events == 0) {
+            TickType_t timeout = pdMS_TO_TICKS(RADIO_TASK_TICK_MS);
+            if (txInFlight.active) {
+                int32_t remainingUs = tmstDelta(txInFlight.startTmst + txInFlight.airtimeUs +
+                                                TX_DONE_TIMEOUT_MARGIN_US, tmstNow());
+                TickType_t txTimeout = remainingUs > 0 ? pdMS_TO_TICKS(remainingUs / 1000) + 1 : 0;
+                if (txTimeout < timeout) {
+                    timeout = txTimeout;
+                }
+            }
+            events = waitRadioEvents(timeout);
+        }
+        radioPendingEvents = 0;
+        if (events & RADIO_EVT_TX_TIMER) {
+            txTimerArmed = false;  // One-shot scaduto
+        }
+        radioProfiler.begin(tmstNow());
+        deafTime.tick(tmstNow());
+        
+        if (events & RADIO_EVT_STANDBY) {
+            standby = true;
+            if (radioInitialized) {
+                deafTime.enter(DeafReason::OTA, tmstNow());
+                radio.standby();
+            }
+        }
+        if (events & RADIO_EVT_RESUME) {
+            standby = false;
+            if (radioInitialized) {
+                restartReceive();
+            }
+        }
+        if (standby) {
+            radioProfiler.end(tmstNow());
+            continue;
+        }
+        
+        // Prima la ricezione (e il TxDone): la radio torna subito in ascolto
+        if (radioInitialized && !radioIrqs.isEmpty()) {
+            handleRadioIrqs();
+        }
+        // TxDone mai arrivato: si chiude la TX per non restare sordi
+        if (txInFlight.active &&
+            tmstReached(txInFlight.startTmst + txInFlight.airtimeUs + TX_DONE_TIMEOUT_MARGIN_US, tmstNow())) {
+            finishDownlinkTx(tmstNow(), true);
+        }
+        radioProfiler.mark(RADIO_IRQ, tmstNow());
+        
+        drainDownlinkRing();
+        radioProfiler.mark(RADIO_DL_QUEUE, tmstNow());
+        
+        #if AUTO_DOWNLINK_ENABLED
+        serviceScheduledDownlinks();
+        #endif
+        radioProfiler.mark(RADIO_DL_SCHEDULED, tmstNow());
+        processDownlinkQueue();
+        radioProfiler.mark(RADIO_DL_CLASS_C, tmstNow());
+        
+        if (radioProfiler.end(tmstNow())) {
+            LOG_DEFER(radioLog, LOG_LEVEL_WARN, RADIO_STALL, radioProfiler.getLastIterationUs(),
+                      radioProfiler.worstSection(), radioProfiler.worstSectionUs());
+        }
+    }
+}
+
+// ===========================
+// NETWORK TASK
+// ===========================
+void networkTask(void* param) {
+    unsigned long lastStatTime = 0;
+    
+    for (;;) {
+        networkProfiler.begin(tmstNow());
+        
+        // Uplink dal radio task → PUSH_DATA
+        RxFrame* frame;
+        while ((frame = uplinkRing.front()) != nullptr) {
+            forwardUplink(*frame);
+            uplinkRing.release();
+        }
+        networkProfiler.mark(NET_UPLINK, tmstNow());
+        
+        // TX_ACK per i downlink trasmessi dal radio task
+        TxAck ack;
+        while (txAckRing.pop(ack)) {
+            sendTxAck(ack);
+        }
+        networkProfiler.mark(NET_TX_ACK, tmstNow());
+        
+        // Send PULL_DATA to ChirpStack periodically (every 5 seconds)
+        if (millis() - lastPullData > 5000) {
+            sendPullData();
+            lastPullData = millis();
+        }
+        networkProfiler.mark(NET_PULL_DATA, tmstNow());
+        
+        // Tutti i datagram da ChirpStack in coda (ACK, PULL_RESP)
+        bool moreDatagrams = drainUdpDatagrams();
+        networkProfiler.mark(NET_UDP_RX, tmstNow());
+        
+        // Send statistics every 300 seconds
+        if (lastStatTime == 0 || millis() - lastStatTime > 300000) {
+            sendStatPacket();
+            lastStatTime = millis();
+        }
+        networkProfiler.mark(NET_STAT, tmstNow());
+        
+        if (networkProfiler.end(tmstNow())) {
+            LOG_DEFER(networkLog, LOG_LEVEL_WARN, NET_STALL, networkProfiler.getLastIterationUs(),
+                      networkProfiler.worstSection(), networkProfiler.worstSectionUs());
+        }
+        
+        // Con budget esaurito si riparte subito dai datagram rimasti.
+        // Altrimenti si riarma udp_watch e si dorme fino al prossimo evento:
+        // uplink, TX_ACK o datagram in arrivo.
+        if (!moreDatagrams) {
+            xTaskNotifyGive(udpWatchTaskHandle);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_TASK_IDLE_MS));
+        }
+    }
+}
+
+// ===========================
+// LOG TASK
+// ===========================
+// Scrive un record differito su Serial: testo formattato o frame binario
+void flushLogEntry(const LogEntry& entry) {
+    #if LOG_FLUSH_BINARY
+    static const uint8_t sync[2] = {LOG_FRAME_SYNC0, LOG_FRAME_SYNC1};
+    Serial.write(sync, sizeof(sync));
+    Serial.write((const uint8_t*)&entry, sizeof(entry));
+    #else
+    char line[160];
+    size_t length = logFormatEntry(entry, line, sizeof(line) - 1);
+    line[length++] = '\n';
+    Serial.write((const uint8_t*)line, length);
+    #endif
+}
+
+// Priorità minima: una scrittura USB-CDC bloccata ferma solo questo task
+void logTask(void* param) {
+    for (;;) {
+        const LogEntry* entry;
+        bool flushed = false;
+        while ((entry = radioLog.front()) != nullptr) {
+            flushLogEntry(*entry);
+            radioLog.release();
+            flushed = true;
+        }
+        while ((entry = networkLog.front()) != nullptr) {
+            flushLogEntry(*entry);
+            networkLog.release();
+            flushed = true;
+        }
+        if (!flushed) {
+            vTaskDelay(pdMS_TO_TICKS(LOG_TASK_PERIOD_MS));
+        }
+    }
+}
+
+void startGatewayTasks() {
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = txTimerCallback;
+    timerArgs.name = "tx_sched";
+    esp_timer_create(&timerArgs, &txTimer);
+    
+    initUdpSocket();
+    
+    xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, nullptr,
+                            LOG_TASK_PRIORITY, nullptr, LOG_TASK_CORE);
+    xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr,
+                            NETWORK_TASK_PRIORITY, &networkTaskHandle, NETWORK_TASK_CORE);
+    xTaskCreatePinnedToCore(udpWatchTask, "udp_watch", UDP_WATCH_TASK_STACK, nullptr,
+                            NETWORK_TASK_PRIORITY, &udpWatchTaskHandle, NETWORK_TASK_CORE);
+    xTaskCreatePinnedToCore(radioTask, "radio", RADIO_TASK_STACK, nullptr,
+                            RADIO_TASK_PRIORITY, &radioTaskHandle, RADIO_TASK_CORE);
+    
+    Serial.printf("[TASK] Radio task su core %d, network task su core %d\n",
+                  RADIO_TASK_CORE, NETWORK_TASK_CORE);
+}
 // ===========================
 // MAIN LOOP
 // ===========================
 void loop() {
+    loopProfiler.begin(tmstNow());
+    
     // Handle OTA updates
+    // Radio e UDP sono gestiti da radioTask / networkTask
     ArduinoOTA.handle();
-    
-    // Send PULL_DATA to ChirpStack periodically (every 5 seconds)
-    if (millis() - lastPullData > 5000) {
-        sendPullData();
-        lastPullData = millis();
-    }
-    
-    // Check for UDP packets from ChirpStack (downlink)
-    handleUdpDownlink();
-    processDownlinkQueue();
-    
-    // Handle incoming LoRa packets only when interrupt flag is set
-    if (radioInitialized && packetReceived) {
-        handleLoRaPacket();
-    }
+    loopProfiler.mark(LOOP_OTA, tmstNow());
     
     // Update display periodically
     #if DISPLAY_ENABLED
@@ -215,19 +976,14 @@ void loop() {
         lastDisplayUpdate = millis();
     }
     #endif
+    loopProfiler.mark(LOOP_DISPLAY, tmstNow());
     
     // Update NTP periodically
     if (millis() - lastNtpUpdate > NTP_UPDATE_INTERVAL) {
         initNTP();
         lastNtpUpdate = millis();
     }
-    
-    // Send statistics every 300 seconds
-    static unsigned long lastStatTime = 0;
-    if (lastStatTime == 0 || millis() - lastStatTime > 300000) {
-        sendStatPacket();
-        lastStatTime = millis();
-    }
+    loopProfiler.mark(LOOP_NTP, tmstNow());
     
     // Debug: stampa statistiche ogni 10 secondi
     static unsigned long lastDebugTime = 0;
@@ -239,16 +995,222 @@ void loop() {
         Serial.printf("[STATS] Errori CRC: %lu\n", crcErrors);
         Serial.printf("[STATS] Timeout: %lu\n", timeouts);
         Serial.printf("[STATS] Altri errori: %lu\n", otherErrors);
+        Serial.printf("[STATS] Errori header: %lu, eventi IRQ senza flag: %lu, IRQ persi (ring pieno): %lu\n",
+                      headerErrors, irqStaleEvents, radioIrqs.getOverruns());
+        Serial.printf("[STATS] Ring uplink scartati: %lu\n", uplinkRingDrops);
+        Serial.printf("[STATS] Eco TX: fronti TxDone %lu, eco soppressi %lu, pacchetti dopo TX conservati %lu\n",
+                      echoFilter.getTxEdges(), echoFilter.getEchoes(), echoFilter.getPreserved());
+        Serial.printf("[STATS] SPI: transazioni totali %lu, ultima lettura pacchetto %lu, errori lettura %lu\n",
+                      loraHal.transactions, rxReadoutTransactions, rxReadoutErrors);
+        Serial.printf("[STATS] Profili radio: cambi %lu, transazioni SPI %lu, evitate dalla cache %lu (ultimo cambio %u/%u), errori %lu\n",
+                      radioSwitchStats.switches, radioSwitchStats.writes, radioSwitchStats.saved,
+                      radioSwitchStats.lastWrites, radioSwitchStats.lastSaved, radioSwitchStats.errors);
+        Serial.printf("[STATS] Riarmo RX dopo RxDone (us): ultimo %lu, max %lu, medio %lu su %lu, oltre %d us: %lu\n",
+                      rxRearmStats.lastUs, rxRearmStats.maxUs,
+                      rxRearmStats.count > 0 ? (uint32_t)(rxRearmStats.sumUs / rxRearmStats.count) : 0,
+                      rxRearmStats.count, RX_REARM_BUDGET_US, rxRearmStats.overBudget);
+        Serial.printf("[STATS] Ring downlink scartati: %lu, TX_ACK persi (ring pieno): %lu\n",
+                      downlinkRingDrops, txAckRingDrops);
+        Serial.print("[STATS] Duty cycle EU868 (ms usati/budget nell'ultima ora, rifiuti):");
+        for (int8_t band = 0; band < EU868_SUB_BANDS; band++) {
+            Serial.printf(" %lu/%lu (%lu)", dutyCycle.getUsedUs(band) / 1000,
+                          EU868_BANDS[band].budgetUs / 1000, dutyCycle.getRejected(band));
+        }
+        Serial.println();
+        Serial.print("[STATS] TX_ACK inviati:");
+        for (uint8_t i = 0; i < TX_ACK_ERROR_COUNT; i++) {
+            Serial.printf(" %s %lu", txAckErrorToString((TxAckError)i), txAckSent[i]);
+        }
+        Serial.println();
+        Serial.printf("[STATS] Log differiti persi: radio %lu, network %lu\n",
+                      radioLog.getDropped(), networkLog.getDropped());
+        Serial.printf("[STATS] UDP ricevuti: %lu, PUSH_ACK: %lu, troncati: %lu, non validi: %lu, budget esaurito: %lu\n",
+                      udpRxStats.datagrams, udpRxStats.pushAcks, udpRxStats.truncated, udpRxStats.invalid,
+                      udpRxStats.deferred);
+        Serial.printf("[STATS] PULL_RESP arrivo → coda (us): ultimo %lu, max %lu, medio %lu su %lu\n",
+                      udpRxStats.lastLatencyUs, udpRxStats.maxLatencyUs,
+                      udpRxStats.enqueued > 0 ? (uint32_t)(udpRxStats.sumLatencyUs / udpRxStats.enqueued) : 0,
+                      udpRxStats.enqueued);
+        // Stack minimo rimasto libero (byte su ESP32) dall'avvio dei task
+        Serial.printf("[STATS] Stack libero min: radio %u/%d, network %u/%d bytes\n",
+                      (unsigned)uxTaskGetStackHighWaterMark(radioTaskHandle), RADIO_TASK_STACK,
+                      (unsigned)uxTaskGetStackHighWaterMark(networkTaskHandle), NETWORK_TASK_STACK);
+        Serial.printf("[STATS] Errore avvio TX (us): ultimo %ld, min %ld, max %ld, medio %lu su %lu TX\n",
+                      (long)txScheduler.getLastErrorUs(), (long)txScheduler.getMinErrorUs(),
+                      (long)txScheduler.getMaxErrorUs(), txScheduler.getMeanAbsErrorUs(),
+                      txScheduler.getTxCount());
+        Serial.printf("[STATS] Errore avvio TX (us): p1 %ld, p50 %ld, p99 %ld (istogramma: comando 't')\n",
+                      (long)txScheduler.getErrorPercentileUs(1), (long)txScheduler.getErrorPercentileUs(50),
+                      (long)txScheduler.getErrorPercentileUs(99));
+        Serial.printf("[STATS] TX in due fasi: %lu preparate (max %lu us, oltre %d us: %lu), in ritardo %lu, annullate %lu, errori timer %lu\n",
+                      txStageStats.prepared, txStageStats.maxPrepareUs, TX_PREPARE_BUDGET_US,
+                      txStageStats.overBudget, txStageStats.firedLate, txStageStats.abandoned,
+                      txTimerErrors);
+        Serial.printf("[STATS] Durata TX (us): ultima %lu (ToA %lu), max %lu su %lu TX, avvii falliti %lu, senza TxDone %lu\n",
+                      txDurationStats.lastUs, txDurationStats.lastAirtimeUs, txDurationStats.maxUs,
+                      txDurationStats.count, txDurationStats.startErrors, txDurationStats.timeouts);
+        printTraceSummary();
+        printStallSummary();
+        printDeafTimeSummary();
         Serial.printf("[STATS] Radio in ascolto: %s\n", radioInitialized ? "SI" : "NO");
         Serial.printf("[STATS] WiFi: %s\n", WiFi.isConnected() ? "OK" : "DISCONNESSO");
         Serial.println("[STATS] ===============================\n");
         lastDebugTime = millis();
     }
+    loopProfiler.mark(LOOP_STATS, tmstNow());
+    
+    // Comandi seriali: 't' = dump istogrammi della pipeline, 'r' = azzera
+    while (Serial.available() > 0) {
+        int command = Serial.read();
+        if (command == 't') {
+            dumpTraceHistograms();
+        } else if (command == 'r') {
+            #if TRACE_ENABLED
+            pipelineTrace.reset();
+            Serial.println("[TRACE] Istogrammi azzerati");
+            #endif
+        }
+    }
+    loopProfiler.mark(LOOP_SERIAL, tmstNow());
+    
+    // Stampa fuori dall'iterazione misurata
+    if (loopProfiler.end(tmstNow())) {
+        LOG_W("[STALL] loop: iterazione %lu us oltre il budget di %lu us, colpa di %s (%lu us)\n",
+              loopProfiler.getLastIterationUs(), loopProfiler.getBudgetUs(),
+              loopProfiler.sectionName(loopProfiler.worstSection()), loopProfiler.worstSectionUs());
+    }
     
     // Small delay to prevent watchdog issues
     delay(1);
 }
 
+// ===========================
+// TRACE DELLA PIPELINE (loop)
+// ===========================
+// Una riga per stadio con campioni: conteggio, p50, p99, max
+void printTraceSummary() {
+    #if TRACE_ENABLED
+    char line[96];
+    for (uint8_t i = 0; i < (uint8_t)TraceStage::COUNT; i++) {
+        TraceStage stage = (TraceStage)i;
+        if (pipelineTrace.histogram(stage).count == 0) {
+            continue;
+        }
+        if (pipelineTrace.formatSummary(stage, line, sizeof(line)) > 0) {
+            Serial.printf("[STATS] %s\n", line);
+        }
+    }
+    #endif
+}
+
+// Occupazione di memoria della coda downlink
+void printDownlinkQueueMemory() {
+    Serial.printf("[QUEUE] Memoria: %u bytes per %d downlink (%u bytes/downlink)\n",
+                  (unsigned)sizeof(DownlinkQueue), DownlinkQueue::capacity(),
+                  (unsigned)(sizeof(DownlinkQueue) / DownlinkQueue::capacity()));
+    Serial.printf("[QUEUE]   Metadati: %u bytes/elemento, frame: blocchi da %u bytes\n",
+                  (unsigned)sizeof(DownlinkEntry), (unsigned)DOWNLINK_MAX_FRAME_SIZE);
+}
+
+// Tempo sordo della radio: ultimo minuto completo e dall'avvio, per motivo
+void printDeafTimeSummary() {
+    uint16_t permille = deafTime.getLastWindowPermille();
+    Serial.printf("[STATS] Radio sorda ultimo minuto: %u.%u%%", permille / 10, permille % 10);
+    for (uint8_t i = 0; i < (uint8_t)DeafReason::COUNT; i++) {
+        DeafReason reason = (DeafReason)i;
+        uint16_t reasonPermille = deafTime.getLastWindowPermille(reason);
+        Serial.printf("%s %s %u.%u%%", i == 0 ? " (" : ",", deafReasonToString(reason),
+                      reasonPermille / 10, reasonPermille % 10);
+    }
+    Serial.println(")");
+    
+    uint64_t uptimeUs = (uint64_t)millis() * 1000;
+    uint64_t deafUs = deafTime.getTotalUs();
+    uint32_t totalPermille = uptimeUs > 0 ? (uint32_t)(deafUs * 1000 / uptimeUs) : 0;
+    Serial.printf("[STATS] Radio sorda dall'avvio: %lu ms (%lu.%lu%%), ora: %s\n",
+                  (uint32_t)(deafUs / 1000), totalPermille / 10, totalPermille % 10,
+                  deafTime.isDeaf() ? deafReasonToString(deafTime.currentReason()) : "IN ASCOLTO");
+}
+
+// Profiler degli stalli: p50/p99/max per sezione, iterazioni oltre budget
+void printStallSummary() {
+    char line[96];
+    Serial.printf("[STATS] Stalli loop: %lu iterazioni oltre %lu us\n",
+                  loopProfiler.getOverBudgetCount(), loopProfiler.getBudgetUs());
+    for (uint8_t i = 0; i <= LOOP_SECTIONS; i++) {
+        if (loopProfiler.formatSection(i, line, sizeof(line)) > 0) {
+            Serial.printf("[STATS]   loop %s\n", line);
+        }
+    }
+    Serial.printf("[STATS] Stalli network: %lu iterazioni oltre %lu us\n",
+                  networkProfiler.getOverBudgetCount(), networkProfiler.getBudgetUs());
+    for (uint8_t i = 0; i <= NET_SECTIONS; i++) {
+        if (networkProfiler.formatSection(i, line, sizeof(line)) > 0) {
+            Serial.printf("[STATS]   network #%u %s\n", i, line);
+        }
+    }
+    
+    // Disponibilità del radio task: quota di tempo passata in attesa di
+    // eventi dall'ultimo riepilogo (una TX non lo blocca più per il ToA)
+    static uint64_t lastRadioBusyUs = 0;
+    static uint32_t lastSummaryTmst = 0;
+    uint32_t now = tmstNow();
+    uint64_t busyUs = radioProfiler.getBusyUs();
+    uint32_t elapsedUs = now - lastSummaryTmst;
+    uint32_t busyPermille = elapsedUs > 0 ? (uint32_t)((busyUs - lastRadioBusyUs) * 1000 / elapsedUs) : 0;
+    if (busyPermille > 1000) {
+        busyPermille = 1000;
+    }
+    lastRadioBusyUs = busyUs;
+    lastSummaryTmst = now;
+    Serial.printf("[STATS] Radio task: disponibile %lu.%lu%%, %lu iterazioni oltre %lu us\n",
+                  (1000 - busyPermille) / 10, (1000 - busyPermille) % 10,
+                  radioProfiler.getOverBudgetCount(), radioProfiler.getBudgetUs());
+    for (uint8_t i = 0; i <= RADIO_SECTIONS; i++) {
+        if (radioProfiler.formatSection(i, line, sizeof(line)) > 0) {
+            Serial.printf("[STATS]   radio #%u %s\n", i, line);
+        }
+    }
+}
+
+// Istogramma completo: tutti i bucket non vuoti di ogni stadio
+void dumpTraceHistograms() {
+    #if TRACE_ENABLED
+    char line[96];
+    Serial.println("\n[TRACE] ===== ISTOGRAMMI PIPELINE =====");
+    for (uint8_t i = 0; i < (uint8_t)TraceStage::COUNT; i++) {
+        TraceStage stage = (TraceStage)i;
+        if (pipelineTrace.formatSummary(stage, line, sizeof(line)) > 0) {
+            Serial.printf("[TRACE] %s (%s)\n", line, traceStageDescription(stage));
+        }
+        for (uint8_t bucket = 0; bucket < TRACE_BUCKETS; bucket++) {
+            if (pipelineTrace.formatBucket(stage, bucket, line, sizeof(line)) > 0) {
+                Serial.printf("[TRACE] %s\n", line);
+            }
+        }
+    }
+    #else
+    Serial.println("[TRACE] Tracepoint disabilitati (TRACE_ENABLED = 0)");
+    #endif
+    dumpTxStartErrorHistogram();
+    Serial.println("[TRACE] ===============================\n");
+}
+
+// Distribuzione con segno dell'errore di avvio TX (startErrorUs dei
+// TX_DONE), per confrontare TX_TWO_PHASE 0 e 1
+void dumpTxStartErrorHistogram() {
+    char line[48];
+    Serial.printf("[TRACE] Errore avvio TX: %lu TX, p1 %ld, p50 %ld, p99 %ld, min %ld, max %ld us (TX_TWO_PHASE %d)\n",
+                  txScheduler.getTxCount(), (long)txScheduler.getErrorPercentileUs(1),
+                  (long)txScheduler.getErrorPercentileUs(50), (long)txScheduler.getErrorPercentileUs(99),
+                  (long)txScheduler.getMinErrorUs(), (long)txScheduler.getMaxErrorUs(), TX_TWO_PHASE);
+    for (uint8_t bucket = 0; bucket < DownlinkScheduler::errorBucketCount(); bucket++) {
+        if (txScheduler.formatErrorBucket(bucket, line, sizeof(line)) > 0) {
+            Serial.printf("[TRACE]   %s\n", line);
+        }
+    }
+}
+
 // ===========================
 // DISPLAY FUNCTIONS
 // ===========================
@@ -383,9 +1345,9 @@ void initOTA() {
         display.sendBuffer();
         #endif
         
-        // Ferma la radio durante l'aggiornamento
-        if (radioInitialized) {
-            radio.standby();
+        // Ferma la radio durante l'aggiornamento (lo fa il radio task)
+        if (radioTaskHandle != nullptr) {
+            xTaskNotify(radioTaskHandle, RADIO_EVT_STANDBY, eSetBits);
         }
     });
     
@@ -442,8 +1404,8 @@ void initOTA() {
         #endif
         
         // Riavvia la radio
-        if (radioInitialized) {
-            radio.startReceive();
+        if (radioTaskHandle != nullptr) {
+            xTaskNotify(radioTaskHandle, RADIO_EVT_RESUME, eSetBits);
         }
     });
     
@@ -571,8 +1533,17 @@ void initLoRa() {
     Serial.printf("[LORA] CRC: %s\n", LORA_CRC ? "SI" : "NO");
     Serial.println("[LORA] ====================================\n");
     
+    // Profilo RX: impostato da begin(), la cache parte da qui
+    rxProfile.freqHz = (uint32_t)(LORA_FREQUENCY * 1000000.0 + 0.5);
+    rxProfile.sf = LORA_SPREADING_FACTOR;
+    rxProfile.bwKHz = (uint16_t)LORA_BANDWIDTH;
+    rxProfile.crDenom = LORA_CODING_RATE;
+    rxProfile.powerDbm = LORA_OUTPUT_POWER;
+    rxProfile.invertIq = false;
+    radioShadow.assume(rxProfile, true);
+    
     // Start receiving
-    state = radio.startReceive();
+    state = restartReceive();
     if (state == RADIOLIB_ERR_NONE) {
         Serial.println("[LORA] ✅ Started receiving - In ascolto per pacchetti...\n");
     } else {
@@ -585,48 +1556,190 @@ void initLoRa() {
 // ===========================
 // LORA PACKET HANDLING
 // ===========================
-void handleLoRaPacket() {
-    Serial.println("\n[RX] ===== HANDLING LORA PACKET =====");
-    uint8_t rxBuffer[256];
+// Rimette la radio in RX e chiude l'intervallo sordo in corso;
+// se fallisce la radio resta sorda per REINIT
+int restartReceive() {
+    int state = radio.startReceive();
+    if (state == RADIOLIB_ERR_NONE) {
+        radioShadow.rxRestarted();
+        deafTime.leave(tmstNow());
+    } else {
+        radioShadow.invalidate();
+        deafTime.enter(DeafReason::REINIT, tmstNow());
+    }
+    return state;
+}
+
+// Latenza RxDone → radio di nuovo in RX (solo radio task)
+void recordRxRearm(uint32_t rxDoneTmst) {
+    uint32_t latencyUs = tmstNow() - rxDoneTmst;
+    rxRearmStats.count++;
+    rxRearmStats.lastUs = latencyUs;
+    rxRearmStats.sumUs += latencyUs;
+    if (latencyUs > rxRearmStats.maxUs) {
+        rxRearmStats.maxUs = latencyUs;
+    }
+    if (latencyUs > RX_REARM_BUDGET_US) {
+        rxRearmStats.overBudget++;
+    }
+    TRACE_US(pipelineTrace, RX_REARM, latencyUs);
+}
+
+// Registro IRQ dell'SX126x (GetIrqStatus), senza cancellarlo
+uint16_t readRadioIrqStatus() {
+    uint8_t data[2] = {0, 0};
+    radio.getMod()->SPIreadStream(RADIOLIB_SX126X_CMD_GET_IRQ_STATUS, data, 2);
+    return ((uint16_t)data[0] << 8) | data[1];
+}
+
+// Gestisce in ordine tutti gli eventi DIO1 accodati dalla ISR.
+// Lo stato IRQ si cattura per primo: dice già cosa è successo
+void handleRadioIrqs() {
+    RadioIrqEvent* irq;
+    while ((irq = radioIrqs.front()) != nullptr) {
+        irq->status = readRadioIrqStatus();
+        handleLoRaPacket(*irq);
+        radioIrqs.release();
+    }
+}
+
+void handleLoRaPacket(const RadioIrqEvent& irq) {
+    RadioIrqKind kind = classifyRadioIrq(irq.status);
     
     // Conta interrupt totali
     totalInterrupts++;
     
-    // Reset interrupt flag
-    packetReceived = false;
+    // Fine del downlink in corso: prima dell'eco e del TxDone inatteso
+    if (kind == RadioIrqKind::TX_DONE && txInFlight.active) {
+        finishDownlinkTx(irq.tmst, false);
+        return;
+    }
+    
+    // Fronte TxDone della nostra trasmissione (tmst dentro la TX): il
+    // percorso TX ha già cancellato i flag e riavviato l'RX
+    bool noPacket = (kind == RadioIrqKind::NONE || kind == RadioIrqKind::TX_DONE);
+    if (noPacket && echoFilter.isTxEdge(irq.tmst)) {
+        LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, RX_ECHO_IGNORED, irq.seq, echoFilter.getTxEdges());
+        if (kind == RadioIrqKind::TX_DONE) {
+            deafTime.enter(DeafReason::PROCESSING, irq.tmst);
+            restartReceive();
+        }
+        return;
+    }
+    
+    // Flag già consumati da un evento precedente (fronti ravvicinati):
+    // la radio è già stata riavviata, niente da leggere
+    if (kind == RadioIrqKind::NONE) {
+        irqStaleEvents++;
+        LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, RX_IRQ_STALE, irq.seq, irqStaleEvents);
+        return;
+    }
+    
+    // Da RxDone la radio non ascolta più fino a restartReceive()
+    deafTime.enter(DeafReason::PROCESSING, irq.tmst);
     
-    // Se abbiamo appena trasmesso, ignora questo pacchetto (potrebbe essere il nostro eco)
-    if (justTransmitted) {
-        Serial.println("[DEBUG] Ignorato pacchetto subito dopo trasmissione (eco)");
-        justTransmitted = false;
-        radio.startReceive();
+    // TxDone fuori da ogni TX registrata: radio in standby, solo riavvio
+    if (kind == RadioIrqKind::TX_DONE) {
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, RX_IRQ_UNEXPECTED, irq.status);
+        restartReceive();
         return;
     }
     
-    Serial.printf("[DEBUG] Interrupt #%lu - Lettura dati radio...\n", totalInterrupts);
+    LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, RX_IRQ, totalInterrupts, irq.seq, irq.status);
+    
+    // Errori noti dallo stato IRQ: nessuna lettura inutile
+    if (kind == RadioIrqKind::HEADER_ERROR) {
+        headerErrors++;
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, RX_HEADER_ERROR, headerErrors);
+        restartReceive();
+        return;
+    }
+    if (kind == RadioIrqKind::OTHER) {
+        otherErrors++;
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, RX_IRQ_UNEXPECTED, irq.status);
+        restartReceive();
+        return;
+    }
+    
+    // tmst di RxDone catturato dalla ISR (prima della lettura e dei log)
+    uint32_t rxTmst = irq.tmst;
+    
+    // Buffer di cattura: direttamente lo slot libero del ring uplink (N
+    // buffer, nessuna copia). Con il ring pieno si cattura nello slot di
+    // riserva: la FIFO va comunque svuotata e la radio riarmata subito.
+    RxFrame* frame = uplinkRing.reserve();
+    bool captured = (frame != nullptr);
+    if (!captured) {
+        frame = &rxSpareFrame;
+    }
     
     // Check if packet available
-    int state = radio.readData(rxBuffer, sizeof(rxBuffer));
+    TRACE_US(pipelineTrace, RX_ISR_TO_READ, tmstNow() - rxTmst);
+    // CRC e timeout si sanno già dallo stato IRQ: lettura solo per RxDone
+    TRACE_BEGIN(readStart);
+    uint32_t spiStart = loraHal.transactions;
+    int state;
+    RxPacketInfo info;
+    if (kind == RadioIrqKind::CRC_ERROR) {
+        state = RADIOLIB_ERR_CRC_MISMATCH;
+    } else if (kind == RadioIrqKind::TIMEOUT) {
+        state = RADIOLIB_ERR_RX_TIMEOUT;
+    } else {
+        // Payload + stato del pacchetto in 4 transazioni (RxReadout.h)
+        RadioLibBus bus = { radio.getMod() };
+        RxReadoutResult result = readRxPacket(bus, frame->payload, sizeof(frame->payload),
+                                              (uint32_t)(LORA_BANDWIDTH * 1000.0), info);
+        if (result == RxReadoutResult::OK) {
+            state = RADIOLIB_ERR_NONE;
+        } else {
+            rxReadoutErrors++;
+            LOG_DEFER(radioLog, LOG_LEVEL_ERROR, RX_READOUT_ERROR, (uint8_t)result);
+            state = RADIOLIB_ERR_SPI_CMD_FAILED;
+        }
+    }
+    TRACE_END(pipelineTrace, RX_READ, readStart);
     
     
     if (state == RADIOLIB_ERR_NONE) {
-        // Packet received successfully
-        // Cattura il timestamp SUBITO per calcolo preciso finestre RX
-        unsigned long rxTimestamp = millis();
+        // Percorso veloce: FIFO + RSSI/SNR nel buffer di cattura, poi la
+        // radio torna subito in ascolto. Tutto il resto (header, log,
+        // finestre RX, inoltro) lavora sulla copia catturata.
+        frame->tmst = rxTmst;
+        frame->length = info.length < sizeof(frame->payload) ? info.length : sizeof(frame->payload);
+        frame->rssi = info.rssi;
+        frame->snr = info.snr;
+        rxReadoutTransactions = loraHal.transactions - spiStart;
+        restartReceive();
+        recordRxRearm(rxTmst);
         
         digitalWrite(LED_PIN, LOW);  // LED on
         
-        size_t packetLength = radio.getPacketLength();
-        float rssi = radio.getRSSI();
-        float snr = radio.getSNR();
+        const uint8_t* rxBuffer = frame->payload;
+        size_t packetLength = frame->length;
+        
+        // Copia di un nostro downlink recente: non va inoltrata
+        if (echoFilter.check(rxBuffer, packetLength, rxTmst) == EchoVerdict::ECHO) {
+            LOG_DEFER(radioLog, LOG_LEVEL_INFO, RX_ECHO_SUPPRESSED, packetLength,
+                      echoFilter.getLastEchoAgeUs(), echoFilter.getEchoes());
+            digitalWrite(LED_PIN, HIGH);  // LED off
+            return;
+        }
         
         stats.rx_received++;
         stats.rx_ok++;
         
-        Serial.println("\n[RX] ---------------- LORA PACKET RECEIVED ----------------");
-        Serial.printf("[RX] Length: %d bytes\n", packetLength);
-        Serial.printf("[RX] RSSI: %.2f dBm\n", rssi);
-        Serial.printf("[RX] SNR: %.2f dB\n", snr);
+        LoRaWANHeader lorawanHeader;
+        memcpy(&lorawanHeader, rxBuffer, sizeof(LoRaWANHeader));
+        
+        // Solo record binari: il testo lo produce il task di log
+        LOG_DEFER(radioLog, LOG_LEVEL_INFO, RX_FRAME, packetLength, lroundf(frame->rssi),
+                  lroundf(frame->snr * 10.0f), rxTmst, tmstNow() - rxTmst);
+        LOG_DEFER(radioLog, LOG_LEVEL_INFO, RX_HEADER, lorawanHeader.devAddr, lorawanHeader.fcnt,
+                  lorawanHeader.mhdr, lorawanHeader.fctrl, lorawanHeader.getFOptsLen());
+        LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, RX_SIGNAL, lroundf(info.signalRssi), info.freqErrorHz,
+                  rxReadoutTransactions);
+        
+        #if LOG_LEVEL >= LOG_LEVEL_VERBOSE
         Serial.print("[RX] Data (HEX): ");
         for (size_t i = 0; i < packetLength; i++) {
             Serial.printf("%02X ", rxBuffer[i]);
@@ -641,177 +1754,165 @@ void handleLoRaPacket() {
             }
         }
         Serial.println();
+        Serial.printf("[RX] ACK: %s, FPending: %s\n",
+                      lorawanHeader.getACK() ? "SI" : "NO", lorawanHeader.getFPending() ? "SI" : "NO");
+        #endif
         
-        PullRespPacket *pullRespPacket = nullptr;
-        LoRaWANHeader lorawanHeader;
-        memcpy(&lorawanHeader, rxBuffer, sizeof(LoRaWANHeader));
-        Serial.printf("[RX] MHDR: 0x%02X\n", lorawanHeader.mhdr);
-        Serial.printf("[RX] DevAddr: 0x%08X\n", lorawanHeader.devAddr);
-        Serial.printf("[RX] FCtrl: 0x%02X\n", lorawanHeader.fctrl);
-        Serial.printf("[RX] FCnt: 0x%04X\n", lorawanHeader.fcnt);
-        Serial.printf("[RX] FOptsLen: %d\n", lorawanHeader.getFOptsLen());
-        Serial.printf("[RX] ACK: %s\n", lorawanHeader.getACK() ? "SI" : "NO");
-        Serial.printf("[RX] FPending: %s\n", lorawanHeader.getFPending() ? "SI" : "NO");
-        
-        // Forward to ChirpStack
-        if (WiFi.isConnected()) {
-            // Create JSON packet
-            StaticJsonDocument<512> doc;
-            JsonArray rxpk_array = doc.createNestedArray("rxpk");
-            JsonObject rxpk = rxpk_array.createNestedObject();
-            
-            // Get current time
-            struct timeval tv;
-            gettimeofday(&tv, NULL);
-            uint32_t tmst = (uint32_t)(tv.tv_sec * 1000000 + tv.tv_usec);
-            
-            rxpk["tmst"] = tmst;
-            rxpk["freq"] = LORA_FREQUENCY;
-            rxpk["chan"] = 0;
-            rxpk["rfch"] = 0;
-            rxpk["stat"] = 1;
-            rxpk["modu"] = "LORA";
-            
-            char datr[16];
-            snprintf(datr, sizeof(datr), "SF%dBW%.0f", LORA_SPREADING_FACTOR, LORA_BANDWIDTH);
-            rxpk["datr"] = datr;
-            
-            char codr[8];
-            snprintf(codr, sizeof(codr), "4/%d", LORA_CODING_RATE);
-            rxpk["codr"] = codr;
-            
-            rxpk["rssi"] = (int)rssi;
-            rxpk["lsnr"] = snr;
-            rxpk["size"] = packetLength;
-            rxpk["data"] = encodeBase64(rxBuffer, packetLength);
-            
-            String jsonString;
-            serializeJson(doc, jsonString);
-            
-            Serial.println("[GW] Forwarding LORA PACKET to ChirpStack:");
-            Serial.println(jsonString);
-            
-            sendUdpPacket(jsonString.c_str());
-            stats.rx_fw++;
-            
-            // IMPORTANTE: ChirpStack invia downlink SOLO come risposta a PULL_DATA!
-            // Invia PULL_DATA subito dopo PUSH_DATA per richiedere downlink dalla coda
-            sendPullData();
-            
-            // Aspetta attivamente il PULL_RESP (con timeout 500ms per dare tempo a ChirpStack)
-            unsigned long waitStart = millis();
-            unsigned long waitTime = 700;
-
-            bool pullRespReceived = false;
-            
-            Serial.printf("[GW] ⚡ Attesa PULL_RESP for addr: 0x%08X downlink to queue after uplink (%lu ms), max wait time: %lu ms\n", lorawanHeader.devAddr, millis() - waitStart, waitTime);
-            while (millis() - waitStart < waitTime) {  // Max 500ms di attesa (aumentato da 200ms)
-                handleUdpDownlink(); // Controlla continuamente se arriva
-                                   // PULL_RESP
-
-                    
-                pullRespPacket = dowQueue.findFirstByDevAddr(lorawanHeader.devAddr);
-                if (pullRespPacket) {
-                    pullRespReceived = true;
-                    Serial.printf("[GW] ⚡ PULL_RESP ricevuto dopo uplink (%lu ms)\n", millis() - waitStart);
-                    Serial.printf("[GW] %d messaggio/i in coda, sarà/anno trasmesso/i nelle finestre RX1/RX2\n", dowQueue.size());
-                    break;
-                }
-            //   if (dowQueue.findFirstByDevAddr(uint32_t devAddr)) {
-                
-            //   }
-                
-                // Se abbiamo ricevuto un nuovo downlink, esci dal loop
-                // if (downlinkQueueCount > 0 || pendingDownlink.pending) {
-                //     pullRespReceived = true;
-                //     Serial.printf("[PULL] ⚡ PULL_RESP ricevuto dopo uplink (%lu ms)\n", millis() - waitStart);
-                //     Serial.printf("[PULL] %d messaggio/i in coda, sarà/anno trasmesso/i nelle finestre RX1/RX2\n", downlinkQueueCount);
-                //     break;
-                // }
-                
-                delay(5);  // Piccolo delay per non saturare la CPU
-            }
-            
-            if (!pullRespReceived) {
-                Serial.println("[PULL] Nessun PULL_RESP entro 500ms (normale se coda vuota)");
-                Serial.println("[PULL] Nota: I downlink dalla coda possono arrivare anche dopo PULL_DATA periodici");
-            }
-            
+        // Pubblica lo slot catturato al network task (PUSH_DATA + PULL_DATA)
+        if (captured) {
+            uplinkRing.commit();
+            xTaskNotifyGive(networkTaskHandle);
         } else {
-            Serial.println("[UDP] ERROR: WiFi disconnected, packet not forwarded");
+            uplinkRingDrops++;
+            LOG_DEFER(radioLog, LOG_LEVEL_ERROR, RX_RING_FULL);
         }
-
         
-        Serial.println("[RX] =============================\n");
-        digitalWrite(LED_PIN, HIGH);  // LED off
-        
-        // Invia risposta "OK" al nodo se abilitato
+        // Apre le finestre RX1/RX2: il PULL_RESP verrà associato quando arriva
         #if AUTO_DOWNLINK_ENABLED
-        if (lorawanHeader.devAddr != 0 && pullRespPacket) {
-          sendDownlinkResponse(rxTimestamp, pullRespPacket);
-        } else {
-            Serial.println("[DOWNLINK] DevAddr non valido o PULL_RESP non trovato, skip downlink");
+        if (lorawanHeader.devAddr != 0 && WiFi.isConnected()) {
+            if (rxWindows.open(lorawanHeader.devAddr, rxTmst)) {
+                LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, RXWIN_OPEN, lorawanHeader.devAddr,
+                          rxWindows.activeCount());
+            } else {
+                LOG_DEFER(radioLog, LOG_LEVEL_WARN, RXWIN_FULL);
+            }
         }
         #endif
-        radio.startReceive();
+        
+        digitalWrite(LED_PIN, HIGH);  // LED off
         
     } else if (state == RADIOLIB_ERR_RX_TIMEOUT) {
         // Timeout - nessun pacchetto ricevuto
+        restartReceive();
         timeouts++;
-        Serial.printf("[DEBUG] Timeout (totale: %lu) - Nessun pacchetto\n", timeouts);
-        radio.startReceive();
+        LOG_DEFER(radioLog, LOG_LEVEL_DEBUG, RX_TIMEOUT, timeouts);
     } else if (state == RADIOLIB_ERR_CRC_MISMATCH) {
         // CRC ERROR - MA I DATI SONO ARRIVATI!
         // Per LoRaWAN, accettiamo comunque (ha il suo MIC per verificare)
+        restartReceive();
+        recordRxRearm(rxTmst);
         crcErrors++;
-        Serial.printf("[DEBUG] CRC ERROR (totale: %lu)\n", crcErrors);
-        radio.startReceive();
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, RX_CRC_ERROR, crcErrors);
     } else {
         // Altri errori
+        restartReceive();
         otherErrors++;
-        Serial.printf("\n[RX] ===== ERROR %d =====\n", state);
-        Serial.printf("[RX] Totale altri errori: %lu\n", otherErrors);
-        Serial.println("[RX] ======================\n");
-        radio.startReceive();
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, RX_ERROR, state, otherErrors);
     }
 }
 
 // ===========================
-// UDP FUNCTIONS
+// UPLINK FORWARDING (network task)
 // ===========================
-void sendUdpPacket(const char* jsonData) {
+void forwardUplink(const RxFrame& frame) {
+    // Forward to ChirpStack
     if (!WiFi.isConnected()) {
-        Serial.println("[UDP] ERROR: WiFi not connected");
+        LOG_DEFER(networkLog, LOG_LEVEL_WARN, UDP_NOT_CONNECTED, (uint8_t)SemtechMessageType::PUSH_DATA);
         return;
     }
     
-    udpClient.beginPacket(serverIP, SERVER_PORT);
+    TRACE_US(pipelineTrace, UL_QUEUE, tmstNow() - frame.tmst);
+    
+    // Datagram PUSH_DATA completo nel buffer del writer (campi costanti già pronti)
+    TRACE_BEGIN(serializeStart);
+    size_t length = rxpkWriter.build((uint16_t)esp_random(), frame.tmst, (int16_t)frame.rssi,
+                                     (int16_t)lroundf(frame.snr * 10.0f),
+                                     frame.payload, frame.length);
+    TRACE_END(pipelineTrace, UL_SERIALIZE, serializeStart);
+    if (length == 0) {
+        LOG_DEFER(networkLog, LOG_LEVEL_ERROR, UL_TOO_LARGE, RXPK_DATAGRAM_SIZE, frame.tmst, frame.length);
+        return;
+    }
     
-    // Protocol version (always 0x02)
-    udpClient.write((uint8_t)0x02);
+    LOG_DEFER(networkLog, LOG_LEVEL_DEBUG, UL_FORWARDED, frame.tmst, frame.length, length);
     
-    // Random token
-    uint16_t token = random(0xFFFF);
-    udpClient.write((uint8_t)(token >> 8));
-    udpClient.write((uint8_t)(token & 0xFF));
+    TRACE_BEGIN(sendStart);
+    sendDatagram(rxpkWriter.data(), length);
+    TRACE_END(pipelineTrace, UL_SEND, sendStart);
+    TRACE_US(pipelineTrace, UL_TOTAL, tmstNow() - frame.tmst);
+    stats.rx_fw++;
     
-    // Identifier: PUSH_DATA = 0x00
-    udpClient.write((uint8_t)0x00);
+    // IMPORTANTE: ChirpStack invia downlink SOLO come risposta a PULL_DATA!
+    // Invia PULL_DATA subito dopo PUSH_DATA per richiedere downlink dalla coda
+    sendPullData();
+}
 
-    // Gateway ID (8 bytes)
-    for (int i = 7; i >= 0; i--) {
-        udpClient.write((uint8_t)((gatewayId >> (i * 8)) & 0xFF));
+// ===========================
+// UDP FUNCTIONS
+// ===========================
+// Socket non bloccante legato a una porta effimera: i PULL_RESP arrivano
+// all'indirizzo da cui parte il PULL_DATA, cioè questo socket.
+void initUdpSocket() {
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(SERVER_PORT);
+    serverAddr.sin_addr.s_addr = (uint32_t)serverIP;
+    
+    udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udpSocket < 0) {
+        Serial.printf("[UDP] ❌ Errore creazione socket: %d\n", errno);
+        return;
+    }
+    fcntl(udpSocket, F_SETFL, fcntl(udpSocket, F_GETFL, 0) | O_NONBLOCK);
+    
+    struct sockaddr_in localAddr;
+    memset(&localAddr, 0, sizeof(localAddr));
+    localAddr.sin_family = AF_INET;
+    localAddr.sin_port = 0;
+    localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(udpSocket, (struct sockaddr*)&localAddr, sizeof(localAddr)) < 0) {
+        Serial.printf("[UDP] ❌ Errore bind socket: %d\n", errno);
+    }
+}
+
+// Blocca in select() sul socket e sveglia il network task appena arriva un
+// datagram. Poi attende che il network task abbia svuotato il socket
+// (altrimenti select() ritornerebbe subito di nuovo).
+void udpWatchTask(void* param) {
+    for (;;) {
+        if (udpSocket < 0) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(udpSocket, &readSet);
+        struct timeval timeout = {1, 0};
+        
+        if (select(udpSocket + 1, &readSet, nullptr, nullptr, &timeout) > 0) {
+            udpReadableTmst = tmstNow();
+            xTaskNotifyGive(networkTaskHandle);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_TASK_IDLE_MS));
+        }
+    }
+}
+
+// Header Semtech a 12 byte: version, token, identifier, Gateway ID
+size_t writeSemtechHeader(uint8_t* out, uint16_t token, SemtechMessageType type) {
+    out[0] = 0x02;
+    out[1] = (uint8_t)(token >> 8);
+    out[2] = (uint8_t)(token & 0xFF);
+    out[3] = (uint8_t)type;
+    for (int i = 0; i < 8; i++) {
+        out[4 + i] = (uint8_t)((gatewayId >> ((7 - i) * 8)) & 0xFF);
+    }
+    return 12;
+}
+
+// Invia un datagram già completo (header incluso) con una sola sendto
+void sendDatagram(const uint8_t* data, size_t length) {
+    // Tipo messaggio (byte 3 dell'header) per i log
+    if (!WiFi.isConnected() || udpSocket < 0) {
+        LOG_DEFER(networkLog, LOG_LEVEL_WARN, UDP_NOT_CONNECTED, data[3]);
+        return;
     }
     
-    // JSON data
-    udpClient.print(jsonData);
-    
-    int result = udpClient.endPacket();
+    int result = sendto(udpSocket, data, length, 0,
+                        (struct sockaddr*)&serverAddr, sizeof(serverAddr));
     
-    if (result) {
-        Serial.println("[SEND UDP PACKET] Packet sent successfully");
-    } else {
-        Serial.println("[SEND UDP PACKET] ERROR: Failed to send packet");
+    if (result != (int)length) {
+        LOG_DEFER(networkLog, LOG_LEVEL_ERROR, UDP_SEND_ERROR, data[3], length, errno);
     }
 }
 
@@ -835,227 +1936,427 @@ void sendStatPacket() {
     stat["ackr"] = 100.0;
     stat["dwnb"] = stats.tx_received;
     stat["txnb"] = stats.tx_emitted;
+    // Estensione: % di tempo con la radio fuori RX nell'ultimo minuto
+    stat["deaf"] = deafTime.getLastWindowPermille() / 10.0;
     
-    String jsonString;
-    serializeJson(doc, jsonString);
+    // PUSH_DATA con header e JSON nello stesso buffer
+    uint8_t datagram[12 + 256];
+    size_t length = writeSemtechHeader(datagram, (uint16_t)esp_random(), SemtechMessageType::PUSH_DATA);
+    length += serializeJson(doc, (char*)datagram + length, sizeof(datagram) - length);
     
-    Serial.println("[STAT] Sending statistics:");
-    Serial.println(jsonString);
-    
-    sendUdpPacket(jsonString.c_str());
+    sendDatagram(datagram, length);
+    LOG_DEFER(networkLog, LOG_LEVEL_DEBUG, STAT_SENT, stats.rx_received, stats.rx_ok, stats.rx_fw,
+              stats.tx_received, stats.tx_emitted);
 }
 
 // ===========================
 // PULL_DATA - Chiede downlink a ChirpStack
 // ===========================
 void sendPullData() {
-//   Serial.println("---- SEND PULL_DATA ----");
-  unsigned long startMillis = millis();
     if (!WiFi.isConnected()) return;
     
-    udpClient.beginPacket(serverIP, SERVER_PORT);
-    
-    // Protocol version (always 0x02)
-    udpClient.write((uint8_t)0x02);
+    uint32_t start = tmstNow();
+    uint8_t datagram[12];
+    writeSemtechHeader(datagram, (uint16_t)esp_random(), SemtechMessageType::PULL_DATA);
+    sendDatagram(datagram, sizeof(datagram));
+    LOG_DEFER(networkLog, LOG_LEVEL_DEBUG, PULL_DATA_SENT, tmstNow() - start);
+}
+
+// ===========================
+// Riceve i datagram UDP da ChirpStack
+// ===========================
+// Prima svuota il socket (fino a UDP_RX_POOL_SIZE datagram o UDP_RX_BUDGET_US),
+// poi li elabora. Ritorna true se il budget è finito prima della coda.
+bool drainUdpDatagrams() {
+    struct PendingDatagram {
+        uint8_t* buffer;
+        size_t length;
+        uint32_t arrivalTmst;
+    };
+    PendingDatagram pending[UDP_RX_POOL_SIZE];
+    uint8_t count = 0;
+    bool budgetExhausted = false;
+    uint32_t start = tmstNow();
     
-    // Random token
-    uint16_t token = random(0xFFFF);
-    udpClient.write((uint8_t)(token >> 8));
-    udpClient.write((uint8_t)(token & 0xFF));
+    // Arrivo = istante in cui udp_watch ha visto il socket leggibile;
+    // per i datagram successivi, l'istante di lettura
+    uint32_t readableTmst = udpReadableTmst;
+    udpReadableTmst = 0;
     
-    // Identifier: PULL_DATA = 0x02
-    udpClient.write((uint8_t)0x02);
+    if (udpSocket < 0) {
+        return false;
+    }
     
-    // Gateway ID (8 bytes)
-    for (int i = 7; i >= 0; i--) {
-        udpClient.write((uint8_t)((gatewayId >> (i * 8)) & 0xFF));
+    for (;;) {
+        if (count == UDP_RX_POOL_SIZE || tmstDelta(tmstNow(), start) > UDP_RX_BUDGET_US) {
+            // Rinvio solo se il socket ha ancora datagram in coda: la
+            // lettura (MSG_PEEK) non li consuma
+            uint8_t probe;
+            if (recv(udpSocket, &probe, 1, MSG_PEEK | MSG_DONTWAIT) > 0) {
+                budgetExhausted = true;
+                udpRxStats.deferred++;
+            }
+            break;
+        }
+        
+        // Un byte in più del massimo per riconoscere i datagram troncati
+        uint8_t* buffer = udpRxPool.allocate();
+        int len = recv(udpSocket, buffer, UDP_RX_DATAGRAM_SIZE + 1, MSG_DONTWAIT);
+        if (len <= 0) {
+            udpRxPool.release(buffer);
+            break;  // Nessun altro datagram (EWOULDBLOCK)
+        }
+        udpRxStats.datagrams++;
+        
+        if (len > UDP_RX_DATAGRAM_SIZE) {
+            // Un PULL_RESP troncato non è decodificabile: scartato intero
+            udpRxStats.truncated++;
+            LOG_DEFER(networkLog, LOG_LEVEL_WARN, UDP_RX_TRUNCATED, UDP_RX_DATAGRAM_SIZE, udpRxStats.truncated);
+            udpRxPool.release(buffer);
+            continue;
+        }
+        
+        pending[count].buffer = buffer;
+        pending[count].length = (size_t)len;
+        pending[count].arrivalTmst = readableTmst != 0 ? readableTmst : tmstNow();
+        readableTmst = 0;
+        count++;
     }
     
-    udpClient.endPacket();
-    unsigned long endMillis = millis();
-    Serial.printf("[PULL] Sent PULL_DATA to ChirpStack in: %lu ms\n", endMillis - startMillis);
+    for (uint8_t i = 0; i < count; i++) {
+        handleUdpDatagram(pending[i].buffer, pending[i].length, pending[i].arrivalTmst);
+        udpRxPool.release(pending[i].buffer);
+    }
+    return budgetExhausted;
 }
 
 // ===========================
-// Gestisce pacchetti UDP da ChirpStack
+// Gestisce un datagram UDP da ChirpStack
 // ===========================
-void handleUdpDownlink() {
-    int packetSize = udpClient.parsePacket();
-    if (packetSize == 0) return;  // Nessun pacchetto
-    
-    Serial.printf("[handleUdpDownlink] Received packet size: %d\n", packetSize);
-    
-    uint8_t udpBuffer[512];
-    int len = udpClient.read(udpBuffer, sizeof(udpBuffer));
-
-    if (len < 4)
-      return; // Pacchetto troppo corto
-    if (len > sizeof(udpBuffer)) {
-      Serial.println("[handleUdpDownlink] ❌ Pacchetto troppo grande");
-      return;
-    }
-
+void handleUdpDatagram(const uint8_t* data, size_t length, uint32_t arrivalTmst) {
     SemtechUdpPackage packet;
-    if (!packet.initFromBuffer(udpBuffer, len)) {
-        Serial.println("[handleUdpDownlink] ❌ Errore parsing SemtechUdpPackage");
+    if (!packet.initFromBuffer(data, length)) {
+        udpRxStats.invalid++;
+        LOG_DEFER(networkLog, LOG_LEVEL_WARN, UDP_RX_INVALID, length, udpRxStats.invalid);
         return;
     }
 
     if (packet.getMessageType() == SemtechMessageType::PULL_ACK) {
       return;
+    }else  if (packet.getMessageType() == SemtechMessageType::PUSH_ACK) {
+      // Risposta a ogni PUSH_DATA: solo contata
+      udpRxStats.pushAcks++;
+      return;
     }else  if (packet.getMessageType() == SemtechMessageType::PULL_RESP) {
-      PullResponseData responseData;
-      if (packet.getPullResponse(responseData)) {
-        Serial.println("[handleUdpDownlink] ✅ PULL_RESP ricevuto - downlink disponibile!");
-        responseData.printDebug();
-
-        PullRespPacket pullRespPacket;
-        pullRespPacket.token = packet.getToken();
-        pullRespPacket.responseData = responseData;
-        if (dowQueue.add(pullRespPacket)) {
-            Serial.println("[handleUdpDownlink] ✅ PULL_RESP aggiunto alla coda");
-        } else {
-            dowQueue.printDebug();
-            Serial.println("[handleUdpDownlink] ❌ PULL_RESP scartato: coda piena");
+      // Reserve → parse → commit: il PULL_RESP viene decodificato
+      // direttamente nello slot del ring verso il radio task (la coda è sua)
+      DownlinkFrame* frame = downlinkRing.reserve();
+      if (frame == nullptr) {
+        downlinkRingDrops++;
+        LOG_DEFER(networkLog, LOG_LEVEL_ERROR, PULL_RESP_RING_FULL);
+        TxAck ack;
+        ack.token = packet.getToken();
+        ack.error = TxAckError::COLLISION_PACKET;
+        sendTxAck(ack);
+        return;
+      }
+      TRACE_BEGIN(parseStart);
+      PullResponseResult parseResult;
+      bool parsed = packet.getPullResponse(*frame, parseResult);
+      TRACE_END(pipelineTrace, DL_PARSE, parseStart);
+      if (parsed) {
+        LOG_DEFER(networkLog, LOG_LEVEL_DEBUG, PULL_RESP_INFO, frame->info.token, frame->info.fport,
+                  frame->info.fport == 0, frame->info.tx.isImmediate());
+        uint16_t token = frame->info.token;
+        uint32_t devAddr = frame->info.devAddr;
+        uint8_t frameLength = frame->info.length;
+
+        downlinkRing.commit();
+        xTaskNotify(radioTaskHandle, RADIO_EVT_DOWNLINK, eSetBits);
+        
+        uint32_t latencyUs = tmstNow() - arrivalTmst;
+        udpRxStats.enqueued++;
+        udpRxStats.lastLatencyUs = latencyUs;
+        udpRxStats.sumLatencyUs += latencyUs;
+        if (latencyUs > udpRxStats.maxLatencyUs) {
+            udpRxStats.maxLatencyUs = latencyUs;
         }
+        LOG_DEFER(networkLog, LOG_LEVEL_INFO, PULL_RESP_QUEUED, token, devAddr, frameLength, latencyUs);
       }else{
-        Serial.println("[handleUdpDownlink] ❌ PULL_RESP scartato: errore parsing PullResponseData");
+        // Slot non pubblicato: il prossimo reserve() lo riusa
+        LOG_DEFER(networkLog, LOG_LEVEL_WARN, PULL_RESP_PARSE_ERROR, packet.getToken(),
+                  (uint8_t)parseResult.parse, (uint8_t)parseResult.base64, parseResult.decodedLength);
         return;
       }
     } else {
-        Serial.printf("[handleUdpDownlink] ? not implemented getMessageType: 0x%02X\n", static_cast<uint8_t>(packet.getMessageType()));
-        Serial.println("[handleUdpDownlink] getMessageTypeString: " + String(packet.getMessageTypeString()));
-        packet.printDebug();
+        LOG_DEFER(networkLog, LOG_LEVEL_WARN, UDP_RX_UNHANDLED, (uint8_t)packet.getMessageType(),
+                  packet.getToken());
     }
 }
 
 
 
-unsigned long getElapsedTime(unsigned long referenceMillis) {
-  return millis() - referenceMillis;
+// ===========================
+// PROFILI RADIO
+// ===========================
+// Profilo TX dal txpk: i campi assenti prendono i valori della config
+// (come in downlinkAirtimeUs), la potenza è limitata a TX_MAX_POWER_DBM
+RadioProfile downlinkProfile(const DownlinkTxParams& tx) {
+    RadioProfile profile;
+    profile.freqHz = tx.freqHz != 0 ? tx.freqHz : rxProfile.freqHz;
+    profile.sf = tx.sf != 0 ? tx.sf : LORA_SPREADING_FACTOR;
+    profile.bwKHz = loraBandwidthKHz(tx.bandwidth);
+    if (profile.bwKHz == 0) {
+        profile.bwKHz = (uint16_t)LORA_BANDWIDTH;
+    }
+    profile.crDenom = tx.crDenom != 0 ? tx.crDenom : LORA_CODING_RATE;
+    profile.powerDbm = sx1262ClampPower(tx.power, TX_MAX_POWER_DBM);
+    profile.invertIq = tx.invertIq();
+    return profile;
+}
+
+// Porta la radio (in standby) sul profilo scrivendo solo ciò che cambia.
+// Su errore la cache si azzera: il cambio successivo riscrive tutto
+bool applyRadioProfile(const RadioProfile& profile, bool forTx, uint16_t token) {
+    RadioLibBus bus = { radio.getMod() };
+    RadioSwitchCount count;
+    RadioProfileResult result = radioShadow.apply(bus, profile, forTx, count);
+    radioSwitchStats.switches++;
+    radioSwitchStats.writes += count.writes;
+    radioSwitchStats.saved += count.saved;
+    radioSwitchStats.lastWrites = count.writes;
+    radioSwitchStats.lastSaved = count.saved;
+    if (result != RadioProfileResult::OK) {
+        radioSwitchStats.errors++;
+        radioShadow.invalidate();
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, RADIO_PROFILE_ERROR, token, (uint8_t)result);
+        return false;
+    }
+    return true;
+}
+
+// Ritorno al profilo RX dopo una TX (radio in standby) e ricezione
+int restoreRxProfile(uint16_t token) {
+    applyRadioProfile(rxProfile, false, token);
+    return restartReceive();
 }
+
 // ===========================
 // TRASMISSIONE DOWNLINK
-// Ritorna true se la trasmissione è riuscita, false altrimenti
+// Percorso unico per Classe A e Classe C, chiamato dal radio task:
+// per la Classe A (nel pre-roll) attende l'istante esatto entry.txTmst,
+// la Classe C parte subito. Trasmette sempre il payload decodificato
+// (binario, non base64!) con startTransmit(): il task non resta bloccato
+// per tutto il ToA, la fine arriva come TxDone su DIO1.
+// Ritorna true se la TX è partita, false altrimenti
 // ===========================
-bool transmitDownlink(uint8_t* data, size_t length, unsigned long rxTimestamp) {
+bool startDownlinkTx(const DownlinkEntry& entry) {
+    uint8_t* data = entry.payload;
+    size_t length = entry.info.length;
+    
     if (!radioInitialized) {
-        Serial.println("[TX_DL] Radio non inizializzata");
-        radio.startReceive();
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, TX_NOT_READY);
+        restartReceive();
+        queueTxAck(entry.info.token, TxAckError::COLLISION_PACKET);
         return false;
     }
     
-    Serial.println("\n[TX_DL] ===== TRASMISSIONE DOWNLINK =====");
-    Serial.printf("[TX_DL] Lunghezza: %d bytes\n", length);
-    Serial.print("[TX_DL] Frame (HEX): ");
-    for (size_t i = 0; i < length; i++) {
-        Serial.printf("%02X ", data[i]);
+    // Ricontrollo all'avvio: i downlink in coda insieme possono superare il
+    // budget anche se ognuno ci stava quando è stato accodato
+    RadioProfile profile = downlinkProfile(entry.info.tx);
+    int8_t band = eu868SubBand(profile.freqHz, profile.bwKHz * 1000UL);
+    #if DUTY_CYCLE_ENFORCE
+    if (dutyCycle.check(band, entry.airtimeUs, uptimeSeconds()) != DutyCycleResult::OK) {
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, TX_DUTY_CYCLE, entry.info.token, band,
+                  dutyCycle.usedUs(band, uptimeSeconds()));
+        queueTxAck(entry.info.token, DUTY_CYCLE_TX_ACK);
+        return false;
     }
-    Serial.println();
-    
-    // Calcola tempo trascorso dalla ricezione
-    unsigned long elapsed = getElapsedTime(rxTimestamp);
-    Serial.printf("[TX_DL] Tempo trascorso dalla RX: %lu ms\n", elapsed);
+    #endif
     
-    bool transmitted = false;
-    int rxWindow = 0;
+    digitalWrite(LED_PIN, LOW);
+    
+    // Da qui la radio non ascolta più: payload e parametri (IQ invertito
+    // compreso) si caricano prima dell'istante TX, fuori dalla parte critica
+    deafTime.enter(DeafReason::WAITING, tmstNow());
+    int state;
+    int32_t txError = 0;
+    uint32_t txStart;
+    
+    #if TX_TWO_PHASE
+    // Fase 1: preparazione nel pre-roll
+    RadioLibBus bus = { radio.getMod() };
+    TxStageParams params;
+    params.payload = data;
+    params.length = (uint8_t)length;
+    params.preambleLength = entry.info.tx.preamble;
+    params.invertIq = entry.info.tx.invertIq();
+    uint32_t prepareStart = tmstNow();
+    TxStageResult staged = prepareTx(bus, params);
+    if (staged == TxStageResult::OK &&
+        !applyRadioProfile(profile, true, entry.info.token)) {
+        staged = TxStageResult::PARAMS_ERROR;
+    }
+    uint32_t prepareUs = tmstNow() - prepareStart;
+    TRACE_US(pipelineTrace, TX_PREPARE, prepareUs);
+    txStageStats.prepared++;
+    if (prepareUs > txStageStats.maxPrepareUs) {
+        txStageStats.maxPrepareUs = prepareUs;
+    }
+    if (prepareUs > TX_PREPARE_BUDGET_US) {
+        txStageStats.overBudget++;
+    }
     
-    // ===== TENTATIVO RX1 =====
-    if (elapsed < RX1_DELAY) {
-        unsigned long waitTime = RX1_DELAY - elapsed;
-        Serial.printf("[TX_DL] Attendo %lu ms per finestra RX1...\n", waitTime);
-        delay(waitTime);
-        
-        unsigned long txStart = millis();
-        unsigned long actualDelay = txStart - rxTimestamp;
-        Serial.printf("[TX_DL] >>> FINESTRA RX1 (delay reale: %lu ms) <<<\n", actualDelay);
-        
-        digitalWrite(LED_PIN, LOW);
-        
-        // LoRaWAN usa IQ invertito per downlink!
-        radio.invertIQ(true);
-        
-        int state = radio.transmit(data, length);
-        
-        // Ripristina IQ normale
-        radio.invertIQ(false);
-        
-        unsigned long txEnd = millis();
-        unsigned long txDuration = txEnd - txStart;
-        
-        if (state == RADIOLIB_ERR_NONE) {
-            Serial.printf("[TX_DL] ✅ Trasmesso in RX1! (TX: %lu ms)\n", txDuration);
-            stats.tx_emitted++;
-            justTransmitted = true;
-            transmitted = true;
-            rxWindow = 1;
+    // Fase 2: SetTx all'istante esatto. Preparazione in ritardo: si
+    // trasmette subito se ancora nella tolleranza, altrimenti si rinuncia
+    bool abandon = false;
+    if (staged == TxStageResult::OK && !entry.immediate) {
+        uint32_t txStartTmst = txScheduler.txStartTmst(entry.txTmst);
+        uint32_t now = tmstNow();
+        if (!tmstReached(txStartTmst, now)) {
+            while (!tmstReached(txStartTmst, tmstNow())) {
+            }
+        } else if (txScheduler.check(entry.txTmst, now) == TxTiming::TOO_LATE) {
+            abandon = true;
         } else {
-            Serial.printf("[TX_DL] ❌ Errore RX1: %d\n", state);
+            txStageStats.firedLate++;
         }
-        
+    }
+    if (abandon) {
+        txStageStats.abandoned++;
+        radio.standby();
         digitalWrite(LED_PIN, HIGH);
-    } else {
-        Serial.printf("[TX_DL] ⚠️ RX1 persa (elapsed: %lu ms)\n", elapsed);
+        int rxState = restoreRxProfile(entry.info.token);
+        if (rxState != RADIOLIB_ERR_NONE) {
+            LOG_DEFER(radioLog, LOG_LEVEL_ERROR, RX_RESTART_ERROR, rxState);
+            radioInitialized = false;
+        }
+        LOG_DEFER(radioLog, LOG_LEVEL_WARN, TX_PREPARE_LATE, entry.info.token, prepareUs,
+                  -tmstDelta(txScheduler.txStartTmst(entry.txTmst), tmstNow()));
+        queueTxAck(entry.info.token, TxAckError::TOO_LATE);
+        return false;
     }
     
-    // ===== TENTATIVO RX2 (solo per debug, normalmente skip se RX1 OK) =====
-    if (!transmitted) {
-        elapsed = getElapsedTime(rxTimestamp);
-        
-        if (elapsed < RX2_DELAY) {
-            unsigned long waitTime = RX2_DELAY - elapsed;
-            Serial.printf("[TX_DL] Attendo %lu ms per finestra RX2...\n", waitTime);
-            delay(waitTime);
-            
-            unsigned long txStart = millis();
-            unsigned long actualDelay = txStart - rxTimestamp;
-            Serial.printf("[TX_DL] >>> FINESTRA RX2 (delay reale: %lu ms) <<<\n", actualDelay);
-            
-            digitalWrite(LED_PIN, LOW);
-            
-            radio.invertIQ(true);
-            int state = radio.transmit(data, length);
-            radio.invertIQ(false);
-            
-            unsigned long txEnd = millis();
-            unsigned long txDuration = txEnd - txStart;
-            
-            if (state == RADIOLIB_ERR_NONE) {
-                Serial.printf("[TX_DL] ✅ Trasmesso in RX2! (TX: %lu ms)\n", txDuration);
-                stats.tx_emitted++;
-                justTransmitted = true;
-                transmitted = true;
-                rxWindow = 2;
-            } else {
-                Serial.printf("[TX_DL] ❌ Errore RX2: %d\n", state);
-            }
-            
-            digitalWrite(LED_PIN, HIGH);
-        } else {
-            Serial.printf("[TX_DL] ❌ RX2 persa (elapsed: %lu ms)\n", elapsed);
+    txStart = tmstNow();
+    if (staged == TxStageResult::OK) {
+        staged = fireTx(bus);
+    }
+    state = (staged == TxStageResult::OK) ? RADIOLIB_ERR_NONE : RADIOLIB_ERR_SPI_CMD_FAILED;
+    #else
+    // Una fase: profilo e IQ prima, buffer, parametri e SetTx tutti
+    // dentro startTransmit()
+    radio.standby();
+    bool profiled = applyRadioProfile(profile, true, entry.info.token);
+    radio.invertIQ(entry.info.tx.invertIq());
+    if (!entry.immediate) {
+        uint32_t txStartTmst = txScheduler.txStartTmst(entry.txTmst);
+        while (!tmstReached(txStartTmst, tmstNow())) {
         }
     }
+    txStart = tmstNow();
+    state = profiled ? radio.startTransmit(data, length) : RADIOLIB_ERR_SPI_CMD_FAILED;
+    #endif
+    // Comando TX → SetTx completato: il jitter residuo dell'avvio
+    TRACE_US(pipelineTrace, TX_COMMAND, tmstNow() - txStart);
     
-    // ===== RIEPILOGO =====
-    if (transmitted) {
-        Serial.printf("[TX_DL] ✅ Successo! Finestra: RX%d\n", rxWindow);
-    } else {
-        Serial.println("[TX_DL] ❌ FALLITO: Nessuna finestra disponibile");
+    if (!entry.immediate) {
+        txError = txScheduler.recordTxStart(entry.txTmst, txStart);
+        TRACE_US(pipelineTrace, TX_START, txError < 0 ? -txError : txError);
     }
     
-    Serial.println("[TX_DL] ==============================\n");
+    if (state != RADIOLIB_ERR_NONE) {
+        // TX non partita: di nuovo in ascolto prima di qualsiasi log
+        radio.standby();
+        #if !TX_TWO_PHASE
+        radio.invertIQ(false);
+        #endif
+        digitalWrite(LED_PIN, HIGH);
+        int rxState = restoreRxProfile(entry.info.token);
+        if (rxState != RADIOLIB_ERR_NONE) {
+            LOG_DEFER(radioLog, LOG_LEVEL_ERROR, RX_RESTART_ERROR, rxState);
+            radioInitialized = false;
+        }
+        txDurationStats.startErrors++;
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, TX_START_FAILED, entry.info.token, state);
+        queueTxAck(entry.info.token, TxAckError::COLLISION_PACKET);
+        return false;
+    }
+    deafTime.enter(DeafReason::TX, txStart);
+    dutyCycle.record(band, entry.airtimeUs, uptimeSeconds());
+    
+    txInFlight.active = true;
+    txInFlight.immediate = entry.immediate;
+    txInFlight.token = entry.info.token;
+    txInFlight.length = (uint16_t)length;
+    txInFlight.hash = echoHash(data, length);
+    txInFlight.txTmst = entry.txTmst;
+    txInFlight.rxTmst = entry.rxTmst;
+    txInFlight.startTmst = txStart;
+    txInFlight.airtimeUs = entry.airtimeUs;
+    txInFlight.startErrorUs = txError;
+    txInFlight.powerDbm = profile.powerDbm;
+    txInFlight.powerLimited = entry.info.tx.power > profile.powerDbm;
+    
+    #if LOG_LEVEL >= LOG_LEVEL_VERBOSE
+    Serial.print("[TX_DL] Frame (HEX): ");
+    for (size_t i = 0; i < length; i++) {
+        Serial.printf("%02X ", data[i]);
+    }
+    Serial.println();
+    #endif
+    
+    return true;
+}
+
+// Chiude la TX in corso: dal TxDone (doneTmst = tmst della ISR) o per
+// timeout. Riarma subito l'RX, poi statistiche, eco, TX_ACK e log.
+void finishDownlinkTx(uint32_t doneTmst, bool timedOut) {
+    uint32_t durationUs = doneTmst - txInFlight.startTmst;
+    txInFlight.active = false;
+    
+    // Cancella i flag IRQ e porta la radio in standby
+    radio.finishTransmit();
+    #if !TX_TWO_PHASE
+    radio.invertIQ(false);
+    #endif
+    digitalWrite(LED_PIN, HIGH);
     
-    // Riavvia la ricezione
-    int state = radio.startReceive();
-    if (state == RADIOLIB_ERR_NONE) {
-        Serial.println("[LORA] Radio tornata in ascolto");
-    } else {
-        Serial.printf("[LORA] ❌ Errore riavvio ricezione: %d\n", state);
+    // Profilo RX (solo i parametri cambiati) e ricezione, prima di qualsiasi log
+    int rxState = restoreRxProfile(txInFlight.token);
+    if (rxState != RADIOLIB_ERR_NONE) {
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, RX_RESTART_ERROR, rxState);
         radioInitialized = false;
     }
     
-    // Ritorna true se la trasmissione è riuscita
-    return transmitted;
+    if (timedOut) {
+        txDurationStats.timeouts++;
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, TX_TIMEOUT, txInFlight.token, durationUs,
+                  txInFlight.airtimeUs);
+        queueTxAck(txAckForFinishedTx(txInFlight.token, true, false, 0));
+        return;
+    }
+    
+    TRACE_US(pipelineTrace, TX_DONE, durationUs);
+    txDurationStats.count++;
+    txDurationStats.lastUs = durationUs;
+    txDurationStats.lastAirtimeUs = txInFlight.airtimeUs;
+    if (durationUs > txDurationStats.maxUs) {
+        txDurationStats.maxUs = durationUs;
+    }
+    
+    stats.tx_emitted++;
+    echoFilter.recordTx(txInFlight.hash, txInFlight.length, txInFlight.startTmst, doneTmst);
+    queueTxAck(txAckForFinishedTx(txInFlight.token, false, txInFlight.powerLimited, txInFlight.powerDbm));
+    
+    if (txInFlight.immediate) {
+        LOG_DEFER(radioLog, LOG_LEVEL_INFO, TX_CLASS_C, txInFlight.token, RADIOLIB_ERR_NONE);
+    } else {
+        LOG_DEFER(radioLog, LOG_LEVEL_INFO, TX_DONE, txInFlight.txTmst, txInFlight.startErrorUs,
+                  RADIOLIB_ERR_NONE, txInFlight.length, durationUs);
+        if (txInFlight.rxTmst != 0) {
+            LOG_DEFER(radioLog, LOG_LEVEL_INFO, TX_UPLINK_DELAY, txInFlight.startTmst - txInFlight.rxTmst);
+        }
+    }
 }
 
 // ===========================
@@ -1178,77 +2479,40 @@ void decodeLoRaWANPacket(uint8_t* data, size_t length) {
 // ===========================
 // TX_ACK - Conferma trasmissione downlink a ChirpStack
 // ===========================
-void sendTxAck(uint16_t token) {
+// Header + {"txpk_ack":{...}} (formatTxAckJson(), TxAck.h)
+void sendTxAck(const TxAck& ack) {
     if (!WiFi.isConnected()) {
-        Serial.println("[TX_ACK] WiFi non connesso, skip TX_ACK");
+        LOG_DEFER(networkLog, LOG_LEVEL_WARN, UDP_NOT_CONNECTED, (uint8_t)SemtechMessageType::TX_ACK);
         return;
     }
     
-    Serial.printf("[TX_ACK] Invio TX_ACK con token 0x%04X\n", token);
-    
-    udpClient.beginPacket(serverIP, SERVER_PORT);
+    LOG_DEFER(networkLog, LOG_LEVEL_DEBUG, TX_ACK_SENT, ack.token, (uint8_t)ack.error,
+              ack.powerLimited, ack.powerDbm);
     
-    // Protocol version (always 0x02)
-    udpClient.write((uint8_t)0x02);
-    
-    // Token (stesso del PULL_RESP)
-    udpClient.write((uint8_t)(token >> 8));
-    udpClient.write((uint8_t)(token & 0xFF));
-    
-    // Identifier: TX_ACK = 0x05
-    udpClient.write((uint8_t)0x05);
-    
-    // Gateway ID (8 bytes)
-    for (int i = 7; i >= 0; i--) {
-        udpClient.write((uint8_t)((gatewayId >> (i * 8)) & 0xFF));
-    }
-    
-    int result = udpClient.endPacket();
-    
-    if (result) {
-        Serial.println("[TX_ACK] ✅ TX_ACK inviato con successo");
-    } else {
-        Serial.println("[TX_ACK] ❌ Errore invio TX_ACK");
-    }
+    // Token: stesso del PULL_RESP
+    uint8_t datagram[12 + 64];
+    size_t length = writeSemtechHeader(datagram, ack.token, SemtechMessageType::TX_ACK);
+    length += formatTxAckJson(ack, (char*)datagram + length, sizeof(datagram) - length);
+    sendDatagram(datagram, length);
+    txAckSent[(uint8_t)ack.error]++;
 }
 
-// ===========================
-// DOWNLINK RESPONSE
-// ===========================
-void sendDownlinkResponse(unsigned long rxTimestamp, PullRespPacket *pullRespPacket) {
-    if (!radioInitialized) {
-        Serial.println("[DOWNLINK] Radio non inizializzata");
-        radio.startReceive();
-        return;
-    }
-    
-    if (pullRespPacket) {
-        // Serial.printf("[DOWNLINK] ✅ %d messaggio/i in coda per DevAddr 0x%08X!\n", messagesForDevAddr, devAddr);
-        
-        // Trasmetti il primo messaggio in RX1
-        // PendingDownlink* dl1 = &downlinkQueue[indices[0]];
-        Serial.println("[DOWNLINK] 📤 Trasmissione messaggio 1 in RX1...");
-        bool tx1Success = transmitDownlink(
-            pullRespPacket->responseData.decodedPayload,  // Dati binari decodificati (non base64!)
-            pullRespPacket->responseData.decodedLength,    // Lunghezza corretta
-            rxTimestamp
-        );
-        
-        if (tx1Success) {
-            Serial.println("[DOWNLINK] ✅ Messaggio 1 trasmesso con successo, invio TX_ACK");
-            sendTxAck(pullRespPacket->token);
-
-            dowQueue.remove(pullRespPacket);
-            
-        } else {
-            Serial.println("[DOWNLINK] ❌ Trasmissione messaggio 1 fallita, NON invio TX_ACK");
-        }
-        
-        // Reset compatibilità
-        // pendingDownlink.pending = false;
-        return;
+// Chiamata dal radio task: il TX_ACK viene inviato dal network task,
+// l'unico che usa il socket UDP
+void queueTxAck(const TxAck& ack) {
+    if (txAckRing.push(ack)) {
+        xTaskNotifyGive(networkTaskHandle);
+    } else {
+        txAckRingDrops++;
+        LOG_DEFER(radioLog, LOG_LEVEL_ERROR, TX_ACK_RING_FULL, ack.token, txAckRingDrops);
     }
-    
 }
 
+// Esito senza avvisi (errori e TX mancate)
+void queueTxAck(uint16_t token, TxAckError error) {
+    TxAck ack;
+    ack.token = token;
+    ack.error = error;
+    queueTxAck(ack);
+}
 
@@ -0,0 +1,80 @@
+// ===========================
+// DATI DI PROVA CONDIVISI (test e benchmark host)
+// ===========================
+#ifndef HOST_FIXTURES_H
+#define HOST_FIXTURES_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Base64.h"
+
+// Frame LoRaWAN di prova: MHDR 0x60 (unconfirmed down), DevAddr, FCtrl,
+// FCnt, FPort 1, poi byte crescenti
+static inline void fixtureFrame(uint8_t* frame, size_t length, uint32_t devAddr) {
+    for (size_t i = 0; i < length; i++) {
+        frame[i] = (uint8_t)(i * 7 + 3);
+    }
+    if (length >= 9) {
+        frame[0] = 0x60;
+        memcpy(frame + 1, &devAddr, 4);
+        frame[5] = 0x00;
+        frame[8] = 0x01;
+    }
+}
+
+// PULL_RESP txpk come lo manda ChirpStack (RX1, finestra con tmst)
+static inline size_t fixtureTxpk(char* out, size_t size, size_t frameLength, uint32_t tmst) {
+    uint8_t frame[256];
+    char data[345];
+    fixtureFrame(frame, frameLength, 0x26011BDA);
+    base64Encode(frame, frameLength, data, sizeof(data));
+    int n = snprintf(out, size,
+                     "{\"txpk\":{\"imme\":false,\"rfch\":0,\"powe\":14,\"ant\":0,\"brd\":0,"
+                     "\"tmst\":%lu,\"freq\":868.1,\"modu\":\"LORA\",\"datr\":\"SF7BW125\","
+                     "\"codr\":\"4/5\",\"ipol\":true,\"size\":%u,\"data\":\"%s\"}}",
+                     (unsigned long)tmst, (unsigned)frameLength, data);
+    return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+}
+
+// ----- STACK HIGH-WATER -----
+// Esegue fn in un thread con uno stack riempito di un motivo noto e ritorna
+// i byte usati da fn: dal frame del chiamante al byte modificato più in
+// basso (lo stack cresce verso il basso).
+#define FIXTURE_STACK_SIZE (256 * 1024)
+#define FIXTURE_STACK_FILL 0xA5
+
+struct FixtureStackCall {
+    void (*fn)();
+    uintptr_t entry;
+};
+
+static inline void* fixtureStackTrampoline(void* arg) {
+    FixtureStackCall* call = (FixtureStackCall*)arg;
+    call->entry = (uintptr_t)__builtin_frame_address(0);
+    call->fn();
+    return nullptr;
+}
+
+static inline size_t fixtureStackUsage(void (*fn)()) {
+    static uint8_t stack[FIXTURE_STACK_SIZE] __attribute__((aligned(64)));
+    memset(stack, FIXTURE_STACK_FILL, sizeof(stack));
+    FixtureStackCall call = { fn, 0 };
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, sizeof(stack));
+    pthread_t thread;
+    pthread_create(&thread, &attr, fixtureStackTrampoline, &call);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    size_t untouched = 0;
+    while (untouched < sizeof(stack) && stack[untouched] == FIXTURE_STACK_FILL) {
+        untouched++;
+    }
+    uintptr_t lowest = (uintptr_t)(stack + untouched);
+    return call.entry > lowest ? (size_t)(call.entry - lowest) : 0;
+}
+
+#endif // HOST_FIXTURES_H
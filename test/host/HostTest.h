@@ -0,0 +1,57 @@
+// ===========================
+// MINI FRAMEWORK TEST/BENCHMARK HOST
+// ===========================
+// Nessuna dipendenza esterna: CHECK conta i fallimenti e continua, il
+// main() del test ritorna testResult() (0 = tutto ok, per make).
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static unsigned testChecks = 0;
+static unsigned testFailures = 0;
+
+#define CHECK(cond) do { \
+    testChecks++; \
+    if (!(cond)) { \
+        testFailures++; \
+        fprintf(stderr, "%s:%d: CHECK(%s) fallito\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+// Come CHECK ma stampa i due valori (interi)
+#define CHECK_EQ(actual, expected) do { \
+    testChecks++; \
+    long long a_ = (long long)(actual), e_ = (long long)(expected); \
+    if (a_ != e_) { \
+        testFailures++; \
+        fprintf(stderr, "%s:%d: %s = %lld, atteso %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+    } \
+} while (0)
+
+static inline int testResult(const char* name) {
+    if (testFailures == 0) {
+        printf("[%s] OK (%u verifiche)\n", name, testChecks);
+        return 0;
+    }
+    printf("[%s] FALLITO: %u/%u verifiche\n", name, testFailures, testChecks);
+    return 1;
+}
+
+// ----- BENCHMARK -----
+
+static inline uint64_t hostNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Impedisce al compilatore di eliminare un risultato non usato
+template <typename T>
+static inline void benchKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif // HOST_TEST_H
@@ -0,0 +1,138 @@
+// ===========================
+// BENCHMARK BASE64: 1..256 BYTE
+// ===========================
+// base64Encode()/base64Decode() (blocchi 3↔4, tabella inversa, buffer del
+// chiamante) contro gli helper originali di common.h: encodeBase64 che
+// appende alla String un carattere alla volta e decodeBase64 che cerca
+// ogni carattere con strchr() nell'alfabeto.
+// Su host la String di Arduino è std::string.
+// Ogni dimensione da 1 a 256 byte è misurata (e verificata con un round
+// trip); la tabella ne mostra una selezione e la media su tutte.
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "HostTest.h"
+#include "Base64.h"
+
+#define BENCH_ITERATIONS 10000
+#define MAX_PAYLOAD 256
+
+// ----- Helper originali (common.h) -----
+static std::string encodeBase64(uint8_t* data, size_t length) {
+    const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t b = (data[i] << 16) | ((i + 1 < length ? data[i + 1] : 0) << 8) | (i + 2 < length ? data[i + 2] : 0);
+
+        result += base64_chars[(b >> 18) & 0x3F];
+        result += base64_chars[(b >> 12) & 0x3F];
+        result += (i + 1 < length) ? base64_chars[(b >> 6) & 0x3F] : '=';
+        result += (i + 2 < length) ? base64_chars[b & 0x3F] : '=';
+    }
+
+    return result;
+}
+
+static size_t decodeBase64(const char* base64Str, uint8_t* output, size_t maxLen) {
+    const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t inLen = strlen(base64Str);
+    size_t outLen = 0;
+
+    uint32_t val = 0;
+    int valb = -8;
+
+    for (size_t i = 0; i < inLen; i++) {
+        char c = base64Str[i];
+        if (c == '=') break;
+
+        const char* pos = strchr(base64_chars, c);
+        if (pos == nullptr) continue;
+
+        val = (val << 6) | (pos - base64_chars);
+        valb += 6;
+
+        if (valb >= 0) {
+            if (outLen >= maxLen) break;
+            output[outLen++] = (val >> valb) & 0xFF;
+            valb -= 8;
+        }
+    }
+
+    return outLen;
+}
+
+static uint8_t payload[MAX_PAYLOAD];
+static uint8_t decoded[MAX_PAYLOAD];
+static char text[base64EncodedLength(MAX_PAYLOAD) + 1];
+
+struct SizeResult {
+    double encodeNs;
+    double decodeNs;
+    double oldEncodeNs;
+    double oldDecodeNs;
+};
+
+static SizeResult measure(size_t length) {
+    SizeResult result;
+    size_t textLength = base64Encode(payload, length, text, sizeof(text));
+    size_t decodedLength = 0;
+    CHECK(base64Decode(text, textLength, decoded, sizeof(decoded), decodedLength) == Base64Result::OK);
+    CHECK(decodedLength == length && memcmp(decoded, payload, length) == 0);
+    CHECK(encodeBase64(payload, length) == text);
+    CHECK(decodeBase64(text, decoded, sizeof(decoded)) == length);
+
+    uint64_t t0 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        benchKeep(base64Encode(payload, length, text, sizeof(text)));
+    }
+    uint64_t t1 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        benchKeep(base64Decode(text, textLength, decoded, sizeof(decoded), decodedLength));
+    }
+    uint64_t t2 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        std::string encoded = encodeBase64(payload, length);
+        benchKeep(encoded);
+    }
+    uint64_t t3 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        benchKeep(decodeBase64(text, decoded, sizeof(decoded)));
+    }
+    uint64_t t4 = hostNowNs();
+
+    result.encodeNs = (double)(t1 - t0) / BENCH_ITERATIONS;
+    result.decodeNs = (double)(t2 - t1) / BENCH_ITERATIONS;
+    result.oldEncodeNs = (double)(t3 - t2) / BENCH_ITERATIONS;
+    result.oldDecodeNs = (double)(t4 - t3) / BENCH_ITERATIONS;
+    return result;
+}
+
+static bool shown(size_t length) {
+    return length <= 4 || (length & (length - 1)) == 0 || length == 51 || length == 222;
+}
+
+int main() {
+    srand(9);
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)rand();
+    }
+
+    printf("[BENCH] base64 (ns)    byte  encode  String   decode  strchr\n");
+    SizeResult sum = {0, 0, 0, 0};
+    for (size_t length = 1; length <= MAX_PAYLOAD; length++) {
+        SizeResult result = measure(length);
+        sum.encodeNs += result.encodeNs;
+        sum.decodeNs += result.decodeNs;
+        sum.oldEncodeNs += result.oldEncodeNs;
+        sum.oldDecodeNs += result.oldDecodeNs;
+        if (shown(length)) {
+            printf("[BENCH]                %4u  %6.0f  %6.0f   %6.0f  %6.0f\n", (unsigned)length,
+                   result.encodeNs, result.oldEncodeNs, result.decodeNs, result.oldDecodeNs);
+        }
+    }
+    printf("[BENCH] media        1..%u  %6.0f  %6.0f   %6.0f  %6.0f\n", MAX_PAYLOAD,
+           sum.encodeNs / MAX_PAYLOAD, sum.oldEncodeNs / MAX_PAYLOAD,
+           sum.decodeNs / MAX_PAYLOAD, sum.oldDecodeNs / MAX_PAYLOAD);
+    return testResult("bench_base64");
+}
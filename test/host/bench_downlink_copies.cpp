@@ -0,0 +1,219 @@
+// ===========================
+// BENCHMARK PULL_RESP → CODA: BYTE COPIATI E STACK
+// ===========================
+// Prima: parse in un PullResponseData sullo stack (testo base64 copiato in
+// txpk.data, frame decodificato), copia in un PullRespPacket sullo stack,
+// copia nell'array della coda (strutture come nel gateway originale; con
+// ArduinoJson disponibile anche lo StaticJsonDocument<512>, altrimenti il
+// parse usa TxpkParser e il documento manca dallo stack "prima").
+// Dopo: reserve dello slot del ring, parse diretto nello slot, commit; il
+// radio task copia metadati + length byte nel pool della coda.
+//
+// Byte copiati contati a mano per ogni copia; stack misurato su un thread
+// con stack dipinto (Fixtures.h).
+#include <stdlib.h>
+#include "HostTest.h"
+#include "Fixtures.h"
+#include "TxpkParser.h"
+#include "SpscRing.h"
+#include "DownlinkQueue.h"
+#if HOST_HAVE_ARDUINOJSON
+#include <ArduinoJson.h>
+#endif
+
+#define BENCH_ITERATIONS 200000
+
+// ----- Strutture del percorso originale -----
+struct OldTxPkData {
+    char data[512];
+    bool imme = false;
+    uint32_t tmst = 0;
+    float freq = 0.0;
+    uint8_t rfch = 0;
+    uint8_t powe = 14;
+    char modu[8] = "LORA";
+    char datr[16] = "";
+    char codr[8] = "4/5";
+    uint16_t fdev = 0;
+    bool ipol = true;
+    uint16_t prea = 8;
+    uint16_t size = 0;
+    bool has[8] = {};
+};
+
+struct OldPullResponseData {
+    OldTxPkData txpk;
+    uint8_t lorawanHeader[8];
+    uint8_t decodedPayload[256];
+    size_t decodedLength = 0;
+    uint8_t fport = 0;
+    bool isMacCommand = false;
+    uint32_t devAddr = 0;
+};
+
+struct OldPullRespPacket {
+    uint16_t token;
+    OldPullResponseData responseData;
+};
+
+#define OLD_QUEUE_SIZE 10
+static OldPullRespPacket oldQueue[OLD_QUEUE_SIZE];
+
+static const char* benchJson;
+static size_t benchJsonLength;
+static size_t bytesMoved;
+
+static void copyString(char* dst, const char* src, size_t srcLength, size_t dstSize) {
+    size_t n = srcLength < dstSize - 1 ? srcLength : dstSize - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+    bytesMoved += n;
+}
+
+__attribute__((noinline)) static bool oldGetPullResponse(OldPullResponseData& result) {
+#if HOST_HAVE_ARDUINOJSON
+    StaticJsonDocument<512> doc;
+    if (deserializeJson(doc, benchJson, benchJsonLength)) {
+        return false;
+    }
+    JsonObject txpk = doc["txpk"];
+    const char* data = txpk["data"] | "";
+    copyString(result.txpk.data, data, strlen(data), sizeof(result.txpk.data));
+    result.txpk.imme = txpk["imme"] | false;
+    result.txpk.tmst = txpk["tmst"] | 0;
+    result.txpk.freq = txpk["freq"] | 0.0;
+    result.txpk.powe = txpk["powe"] | 14;
+    const char* datr = txpk["datr"] | "";
+    copyString(result.txpk.datr, datr, strlen(datr), sizeof(result.txpk.datr));
+    const char* codr = txpk["codr"] | "4/5";
+    copyString(result.txpk.codr, codr, strlen(codr), sizeof(result.txpk.codr));
+    size_t decoded = 0;
+    if (base64Decode(result.txpk.data, strlen(result.txpk.data), result.decodedPayload,
+                     sizeof(result.decodedPayload), decoded) != Base64Result::OK) {
+        return false;
+    }
+#else
+    DownlinkTxParams tx;
+    size_t decoded = 0;
+    TxpkParser parser;
+    if (parser.parse(benchJson, benchJsonLength, tx, result.decodedPayload,
+                     sizeof(result.decodedPayload), decoded) != TxpkParseResult::OK) {
+        return false;
+    }
+    const char* data = strstr(benchJson, "\"data\":\"") + 8;
+    copyString(result.txpk.data, data, strchr(data, '"') - data, sizeof(result.txpk.data));
+    copyString(result.txpk.datr, "SF7BW125", 8, sizeof(result.txpk.datr));
+    copyString(result.txpk.codr, "4/5", 3, sizeof(result.txpk.codr));
+#endif
+    bytesMoved += decoded;
+    result.decodedLength = decoded;
+    memcpy(result.lorawanHeader, result.decodedPayload, sizeof(result.lorawanHeader));
+    bytesMoved += sizeof(result.lorawanHeader);
+    memcpy(&result.devAddr, result.decodedPayload + 1, 4);
+    result.fport = result.decodedPayload[8];
+    return true;
+}
+
+__attribute__((noinline)) static bool oldHandle(uint16_t token) {
+    OldPullResponseData responseData;
+    if (!oldGetPullResponse(responseData)) {
+        return false;
+    }
+    OldPullRespPacket packet;
+    packet.token = token;
+    packet.responseData = responseData;
+    bytesMoved += sizeof(responseData);
+    oldQueue[token % OLD_QUEUE_SIZE] = packet;
+    bytesMoved += sizeof(packet);
+    return true;
+}
+
+// ----- Percorso attuale -----
+static SpscRing<DownlinkFrame, 4> downlinkRing;
+static DownlinkQueue queue;
+
+__attribute__((noinline)) static bool newNetworkHandle(uint16_t token) {
+    DownlinkFrame* frame = downlinkRing.reserve();
+    if (frame == nullptr) {
+        return false;
+    }
+    size_t decoded = 0;
+    TxpkParser parser;
+    if (parser.parse(benchJson, benchJsonLength, frame->info.tx, frame->payload,
+                     sizeof(frame->payload), decoded) != TxpkParseResult::OK) {
+        return false;    // Slot non pubblicato: nessuna copia da annullare
+    }
+    bytesMoved += sizeof(DownlinkTxParams) + decoded;
+    frame->info.token = token;
+    frame->info.length = (uint8_t)decoded;
+    memcpy(&frame->info.devAddr, frame->payload + 1, 4);
+    frame->info.fport = frame->payload[8];
+    downlinkRing.commit();
+    return true;
+}
+
+__attribute__((noinline)) static void newRadioHandle() {
+    DownlinkFrame* frame = downlinkRing.front();
+    if (frame == nullptr) {
+        return;
+    }
+    if (queue.schedule(*frame, frame->info.tx.tmst, 50000) == QueueResult::OK) {
+        bytesMoved += sizeof(DownlinkInfo) + frame->info.length;
+    }
+    downlinkRing.release();
+    queue.popScheduled();
+}
+
+// ----- Funzioni per la misura dello stack -----
+static void oldStackRun() { oldHandle(1); }
+static void newNetworkStackRun() { newNetworkHandle(1); }
+static void newRadioStackRun() { newRadioHandle(); }
+
+static void run(size_t frameLength) {
+    static char json[640];
+    benchJsonLength = fixtureTxpk(json, sizeof(json), frameLength, 1000000);
+    benchJson = json;
+
+    bytesMoved = 0;
+    oldHandle(1);
+    size_t oldBytes = bytesMoved;
+    bytesMoved = 0;
+    newNetworkHandle(1);
+    newRadioHandle();
+    size_t newBytes = bytesMoved;
+
+    size_t oldStack = fixtureStackUsage(oldStackRun);
+    size_t newNetStack = fixtureStackUsage(newNetworkStackRun);
+    size_t newRadioStack = fixtureStackUsage(newRadioStackRun);
+
+    uint64_t t0 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        oldHandle((uint16_t)i);
+    }
+    uint64_t t1 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        newNetworkHandle((uint16_t)i);
+        newRadioHandle();
+    }
+    uint64_t t2 = hostNowNs();
+
+    printf("[BENCH] frame %3u B, JSON %3u B\n", (unsigned)frameLength, (unsigned)benchJsonLength);
+    printf("[BENCH]   prima: %5u byte copiati, stack %5u B, %6.0f ns/datagramma\n",
+           (unsigned)oldBytes, (unsigned)oldStack, (double)(t1 - t0) / BENCH_ITERATIONS);
+    printf("[BENCH]   dopo:  %5u byte copiati, stack %5u B network + %u B radio, %6.0f ns/datagramma\n",
+           (unsigned)newBytes, (unsigned)newNetStack, (unsigned)newRadioStack,
+           (double)(t2 - t1) / BENCH_ITERATIONS);
+}
+
+int main() {
+#if !HOST_HAVE_ARDUINOJSON
+    printf("[BENCH] ArduinoJson non trovato: \"prima\" senza StaticJsonDocument<512>\n");
+#endif
+    printf("[BENCH] sizeof PullRespPacket %u, DownlinkFrame %u, DownlinkInfo %u\n",
+           (unsigned)sizeof(OldPullRespPacket), (unsigned)sizeof(DownlinkFrame),
+           (unsigned)sizeof(DownlinkInfo));
+    run(17);
+    run(64);
+    run(222);
+    return 0;
+}
@@ -0,0 +1,125 @@
+// ===========================
+// BENCHMARK CODA DOWNLINK: 10 / 100 / 1000 ELEMENTI
+// ===========================
+// Costo di schedule() e popScheduled() a coda stabile con n elementi
+// (ogni inserimento è seguito da un'estrazione), contro una coda ad array
+// piatto con scansioni lineari come quella sostituita: slot libero,
+// conteggio per DevAddr e sovrapposizioni all'inserimento, minimo tmst e
+// memset dello slot all'estrazione (array di n + 1 slot).
+#define MAX_DOWNLINK_QUEUE_SIZE 1024
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "DownlinkQueue.h"
+
+#define BENCH_ROUNDS 200000
+#define GRID_US 2000        // Istanti su una griglia da 2 ms
+#define AIRTIME_US 1000     // ToA 1 ms: istanti diversi non si sovrappongono
+
+// ----- Coda lineare di riferimento -----
+struct LinearSlot {
+    bool used;
+    DownlinkFrame frame;
+    uint32_t txTmst;
+    uint32_t airtimeUs;
+};
+
+struct LinearQueue {
+    LinearSlot slots[MAX_DOWNLINK_QUEUE_SIZE];
+    int capacity = MAX_DOWNLINK_QUEUE_SIZE;    // Array dimensionato per n elementi
+
+    QueueResult schedule(const DownlinkFrame& frame, uint32_t txTmst, uint32_t airtimeUs) {
+        int free = -1;
+        uint8_t count = 0;
+        for (int i = 0; i < capacity; i++) {
+            const LinearSlot& slot = slots[i];
+            if (!slot.used) {
+                if (free < 0) free = i;
+                continue;
+            }
+            if (slot.frame.info.devAddr == frame.info.devAddr) count++;
+            if (tmstDelta(slot.txTmst, txTmst + airtimeUs) < 0 &&
+                tmstDelta(slot.txTmst + slot.airtimeUs, txTmst) > 0) {
+                return QueueResult::COLLISION;
+            }
+        }
+        if (free < 0) return QueueResult::FULL;
+        if (count >= MAX_DOWNLINK_PER_DEVADDR) return QueueResult::DEVADDR_LIMIT;
+        LinearSlot& slot = slots[free];
+        slot.used = true;
+        slot.frame = frame;
+        slot.txTmst = txTmst;
+        slot.airtimeUs = airtimeUs;
+        return QueueResult::OK;
+    }
+
+    void popScheduled() {
+        int first = -1;
+        for (int i = 0; i < capacity; i++) {
+            if (slots[i].used && (first < 0 || tmstDelta(slots[i].txTmst, slots[first].txTmst) < 0)) {
+                first = i;
+            }
+        }
+        if (first >= 0) memset((void*)&slots[first], 0, sizeof(slots[first]));
+    }
+
+    void clear() { memset((void*)slots, 0, sizeof(slots)); }
+};
+
+static DownlinkQueue treeQueue;
+static LinearQueue linearQueue;
+static DownlinkFrame frame;
+
+// Istante libero casuale dopo il minimo corrente (griglia ampia: rari conflitti)
+static uint32_t randomTmst(uint32_t base) {
+    return base + (uint32_t)(rand() % (1 << 20)) * GRID_US;
+}
+
+static void setCapacity(DownlinkQueue&, uint32_t) {}
+static void setCapacity(LinearQueue& queue, uint32_t entries) { queue.capacity = (int)entries + 1; }
+
+template <typename Queue>
+static void run(const char* name, Queue& queue, uint32_t entries) {
+    queue.clear();
+    setCapacity(queue, entries);
+    srand(42);
+    uint32_t devAddr = 0;
+    uint32_t base = 0xF0000000u;    // Attraversa il wrap durante la misura
+    for (uint32_t i = 0; i < entries; ) {
+        frame.info.devAddr = devAddr++;
+        if (queue.schedule(frame, randomTmst(base), AIRTIME_US) == QueueResult::OK) i++;
+    }
+
+    uint64_t insertNs = 0, popNs = 0;
+    uint32_t inserted = 0;
+    for (uint32_t round = 0; round < BENCH_ROUNDS / entries + 1000; round++) {
+        frame.info.devAddr = devAddr++;
+        uint32_t tmst = randomTmst(base);
+        uint64_t t0 = hostNowNs();
+        QueueResult result = queue.schedule(frame, tmst, AIRTIME_US);
+        uint64_t t1 = hostNowNs();
+        if (result != QueueResult::OK) continue;
+        queue.popScheduled();
+        uint64_t t2 = hostNowNs();
+        insertNs += t1 - t0;
+        popNs += t2 - t1;
+        inserted++;
+        base += GRID_US;
+    }
+    printf("[BENCH] %-8s n=%4lu  schedule %8.1f ns  pop %8.1f ns\n", name, (unsigned long)entries,
+           (double)insertNs / inserted, (double)popNs / inserted);
+}
+
+int main() {
+    frame.info.length = 51;
+    memset(frame.payload, 0xA5, sizeof(frame.payload));
+    printf("[BENCH] DownlinkQueue: %u bytes (%u slot), frame %u bytes\n",
+           (unsigned)sizeof(DownlinkQueue), (unsigned)DownlinkQueue::capacity(),
+           (unsigned)sizeof(DownlinkFrame));
+    const uint32_t sizes[] = { 10, 100, 1000 };
+    for (uint32_t n : sizes) {
+        run("avl", treeQueue, n);
+        run("lineare", linearQueue, n);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+// ===========================
+// BENCHMARK PUSH_DATA: RxpkWriter CONTRO ArduinoJson
+// ===========================
+// RxpkWriter.build() (campi costanti pronti da init(), un solo buffer)
+// contro il percorso originale: StaticJsonDocument<512>, snprintf di
+// datr/codr, base64 in una stringa costruita carattere per carattere,
+// serializeJson in una stringa e header copiato davanti al JSON.
+// Su host la String di Arduino è std::string (crescita diversa: il numero
+// di allocazioni "prima" è indicativo).
+//
+// Le allocazioni si contano sostituendo operator new. Il confronto con
+// ArduinoJson richiede la libreria (vedi Makefile); senza, si misura solo
+// RxpkWriter.
+#include <new>
+#include <stdlib.h>
+#include <string>
+#include "HostTest.h"
+#include "RxpkWriter.h"
+#if HOST_HAVE_ARDUINOJSON
+#include <ArduinoJson.h>
+#endif
+
+#define BENCH_ITERATIONS 200000
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static uint8_t payload[255];
+static RxpkWriter writer;
+
+#if HOST_HAVE_ARDUINOJSON
+static uint8_t datagram[1024];
+
+static std::string encodeBase64(const uint8_t* data, size_t length) {
+    const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t b = (data[i] << 16) | ((i + 1 < length ? data[i + 1] : 0) << 8) |
+                     (i + 2 < length ? data[i + 2] : 0);
+        result += chars[(b >> 18) & 0x3F];
+        result += chars[(b >> 12) & 0x3F];
+        result += (i + 1 < length) ? chars[(b >> 6) & 0x3F] : '=';
+        result += (i + 2 < length) ? chars[b & 0x3F] : '=';
+    }
+    return result;
+}
+
+__attribute__((noinline)) static size_t arduinoJsonBuild(uint32_t tmst, float rssi, float snr,
+                                                         size_t length) {
+    StaticJsonDocument<512> doc;
+    JsonArray rxpkArray = doc.createNestedArray("rxpk");
+    JsonObject rxpk = rxpkArray.createNestedObject();
+    rxpk["tmst"] = tmst;
+    rxpk["freq"] = 868.1;
+    rxpk["chan"] = 0;
+    rxpk["rfch"] = 0;
+    rxpk["stat"] = 1;
+    rxpk["modu"] = "LORA";
+    char datr[16];
+    snprintf(datr, sizeof(datr), "SF%dBW%.0f", 7, 125.0);
+    rxpk["datr"] = datr;
+    char codr[8];
+    snprintf(codr, sizeof(codr), "4/%d", 5);
+    rxpk["codr"] = codr;
+    rxpk["rssi"] = (int)rssi;
+    rxpk["lsnr"] = snr;
+    rxpk["size"] = length;
+    rxpk["data"] = encodeBase64(payload, length);
+
+    std::string json;
+    serializeJson(doc, json);
+    if (12 + json.size() > sizeof(datagram)) {
+        return 0;
+    }
+    memcpy(datagram + 12, json.data(), json.size());
+    return 12 + json.size();
+}
+#endif
+
+static void run(size_t length) {
+    size_t writerBytes = writer.build(0x1234, 1000000, -87, -75, payload, length);
+
+    size_t before = allocations;
+    uint64_t t0 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        benchKeep(writer.build((uint16_t)i, i, -87, -75, payload, length));
+    }
+    uint64_t t1 = hostNowNs();
+    size_t writerAllocs = allocations - before;
+
+    printf("[BENCH] payload %3u B\n", (unsigned)length);
+    printf("[BENCH]   RxpkWriter:  %4u B datagram, %6.0f ns, %.2f allocazioni/uplink\n",
+           (unsigned)writerBytes, (double)(t1 - t0) / BENCH_ITERATIONS,
+           (double)writerAllocs / BENCH_ITERATIONS);
+    CHECK(writerBytes > 0);
+    CHECK_EQ(writerAllocs, 0);
+
+#if HOST_HAVE_ARDUINOJSON
+    size_t jsonBytes = arduinoJsonBuild(1000000, -87.0f, -7.5f, length);
+    before = allocations;
+    t0 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        benchKeep(arduinoJsonBuild(i, -87.0f, -7.5f, length));
+    }
+    t1 = hostNowNs();
+    printf("[BENCH]   ArduinoJson: %4u B datagram, %6.0f ns, %.2f allocazioni/uplink\n",
+           (unsigned)jsonBytes, (double)(t1 - t0) / BENCH_ITERATIONS,
+           (double)(allocations - before) / BENCH_ITERATIONS);
+#endif
+}
+
+int main() {
+#if !HOST_HAVE_ARDUINOJSON
+    printf("[BENCH] ArduinoJson non trovato: solo RxpkWriter\n");
+#endif
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 13 + 1);
+    }
+    writer.init(0xAABBCCDDEEFF0011ULL, 868100000, 7, 125, 5);
+    run(13);
+    run(51);
+    run(222);
+    return testResult("bench_rxpk_writer");
+}
@@ -0,0 +1,97 @@
+// ===========================
+// BENCHMARK PARSER TXPK CONTRO ArduinoJson
+// ===========================
+// TxpkParser.parse() (passata singola, data decodificato nel buffer finale)
+// contro deserializeJson in uno StaticJsonDocument<512>, lettura dei campi
+// e base64Decode del testo di data, come nel percorso originale.
+// Il confronto richiede ArduinoJson (vedi Makefile); senza, si misura solo
+// TxpkParser.
+#include "HostTest.h"
+#include "Fixtures.h"
+#include "TxpkParser.h"
+#if HOST_HAVE_ARDUINOJSON
+#include <ArduinoJson.h>
+#endif
+
+#define BENCH_ITERATIONS 200000
+
+static uint8_t payload[256];
+
+#if HOST_HAVE_ARDUINOJSON
+struct ArduinoJsonTxpk {
+    uint32_t tmst;
+    float freq;
+    int powe;
+    bool imme;
+    bool ipol;
+    char datr[16];
+    char codr[8];
+    size_t length;
+};
+
+__attribute__((noinline)) static bool arduinoJsonParse(const char* json, size_t length,
+                                                       ArduinoJsonTxpk& out) {
+    StaticJsonDocument<512> doc;
+    if (deserializeJson(doc, json, length)) {
+        return false;
+    }
+    JsonObject txpk = doc["txpk"];
+    if (txpk.isNull() || !txpk.containsKey("data")) {
+        return false;
+    }
+    out.tmst = txpk["tmst"] | 0;
+    out.freq = txpk["freq"] | 0.0;
+    out.powe = txpk["powe"] | 14;
+    out.imme = txpk["imme"] | false;
+    out.ipol = txpk["ipol"] | true;
+    strncpy(out.datr, txpk["datr"] | "", sizeof(out.datr) - 1);
+    strncpy(out.codr, txpk["codr"] | "4/5", sizeof(out.codr) - 1);
+    const char* data = txpk["data"] | "";
+    return base64Decode(data, strlen(data), payload, sizeof(payload), out.length) == Base64Result::OK;
+}
+#endif
+
+static void run(size_t frameLength) {
+    char json[640];
+    size_t length = fixtureTxpk(json, sizeof(json), frameLength, 1000000);
+    DownlinkTxParams tx;
+    size_t decoded = 0;
+    TxpkParser parser;
+    CHECK(parser.parse(json, length, tx, payload, sizeof(payload), decoded) == TxpkParseResult::OK);
+
+    uint64_t t0 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        benchKeep(parser.parse(json, length, tx, payload, sizeof(payload), decoded));
+    }
+    uint64_t t1 = hostNowNs();
+    printf("[BENCH] frame %3u B, JSON %3u B\n", (unsigned)frameLength, (unsigned)length);
+    printf("[BENCH]   TxpkParser:  %6.0f ns, %u B di parser sullo stack\n",
+           (double)(t1 - t0) / BENCH_ITERATIONS, (unsigned)sizeof(TxpkParser));
+
+#if HOST_HAVE_ARDUINOJSON
+    ArduinoJsonTxpk out;
+    if (!arduinoJsonParse(json, length, out)) {
+        // Come nel gateway originale: i downlink grandi non entrano nel documento
+        printf("[BENCH]   ArduinoJson: fallito, StaticJsonDocument<512> insufficiente\n");
+        return;
+    }
+    CHECK_EQ(out.length, decoded);
+    t0 = hostNowNs();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        benchKeep(arduinoJsonParse(json, length, out));
+    }
+    t1 = hostNowNs();
+    printf("[BENCH]   ArduinoJson: %6.0f ns, %u B di documento sullo stack\n",
+           (double)(t1 - t0) / BENCH_ITERATIONS, (unsigned)sizeof(StaticJsonDocument<512>));
+#endif
+}
+
+int main() {
+#if !HOST_HAVE_ARDUINOJSON
+    printf("[BENCH] ArduinoJson non trovato: solo TxpkParser\n");
+#endif
+    run(17);
+    run(64);
+    run(222);
+    return testResult("bench_txpk_parser");
+}
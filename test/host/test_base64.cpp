@@ -0,0 +1,152 @@
+// ===========================
+// TEST BASE64
+// ===========================
+// Round-trip per ogni lunghezza 0..255 contro un encoder di riferimento
+// bit a bit, poi i rifiuti della decodifica stretta: padding non canonico
+// o fuori posto, caratteri fuori dall'alfabeto in ogni posizione,
+// lunghezze non multiple di 4 e buffer insufficienti.
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "Base64.h"
+
+// Encoder di riferimento: 6 bit alla volta, padding a multipli di 4
+static size_t referenceEncode(const uint8_t* data, size_t length, char* out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t n = 0;
+    for (size_t bit = 0; bit < length * 8; bit += 6) {
+        uint8_t value = 0;
+        for (size_t k = 0; k < 6; k++) {
+            size_t b = bit + k;
+            uint8_t set = b < length * 8 ? (data[b / 8] >> (7 - b % 8)) & 1 : 0;
+            value = (uint8_t)((value << 1) | set);
+        }
+        out[n++] = alphabet[value];
+    }
+    while (n % 4 != 0) {
+        out[n++] = '=';
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static Base64Result decode(const char* text, uint8_t* out = nullptr, size_t outSize = 256) {
+    static uint8_t scratch[256];
+    size_t decoded = 0;
+    return base64Decode(text, strlen(text), out ? out : scratch, outSize, decoded);
+}
+
+static void roundTrip() {
+    uint8_t data[256], decoded[256];
+    char text[345], expected[345];
+    srand(2024);
+    for (int pass = 0; pass < 4; pass++) {
+        for (size_t length = 0; length <= 255; length++) {
+            for (size_t i = 0; i < length; i++) {
+                data[i] = pass == 0 ? 0x00 : pass == 1 ? 0xFF : (uint8_t)rand();
+            }
+            size_t encoded = base64Encode(data, length, text, sizeof(text));
+            CHECK_EQ(encoded, base64EncodedLength(length));
+            CHECK_EQ(referenceEncode(data, length, expected), encoded);
+            CHECK(strcmp(text, expected) == 0);
+
+            size_t decodedLength = 99;
+            CHECK(base64Decode(text, encoded, decoded, sizeof(decoded), decodedLength) == Base64Result::OK);
+            CHECK_EQ(decodedLength, length);
+            CHECK(memcmp(decoded, data, length) == 0);
+
+            // Buffer esatto basta, un byte in meno no
+            if (length > 0) {
+                CHECK(base64Decode(text, encoded, decoded, length, decodedLength) == Base64Result::OK);
+                CHECK(base64Decode(text, encoded, decoded, length - 1, decodedLength) ==
+                      Base64Result::OUTPUT_TOO_SMALL);
+                CHECK_EQ(decodedLength, 0);
+            }
+            // Encoder: serve spazio anche per il terminatore
+            CHECK_EQ(base64Encode(data, length, text, encoded), 0);
+        }
+    }
+}
+
+static void knownVectors() {
+    // RFC 4648 §10
+    const char* vectors[][2] = {
+        { "", "" }, { "f", "Zg==" }, { "fo", "Zm8=" }, { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" }, { "fooba", "Zm9vYmE=" }, { "foobar", "Zm9vYmFy" }
+    };
+    for (auto& v : vectors) {
+        char text[16];
+        base64Encode((const uint8_t*)v[0], strlen(v[0]), text, sizeof(text));
+        CHECK(strcmp(text, v[1]) == 0);
+        uint8_t out[16];
+        size_t decoded = 0;
+        CHECK(base64Decode(v[1], strlen(v[1]), out, sizeof(out), decoded) == Base64Result::OK);
+        CHECK(decoded == strlen(v[0]) && memcmp(out, v[0], decoded) == 0);
+    }
+}
+
+static void rejectPadding() {
+    // Bit inutilizzati dell'ultimo carattere diversi da zero
+    CHECK(decode("Zg==") == Base64Result::OK);
+    CHECK(decode("Zh==") == Base64Result::INVALID_PADDING);
+    CHECK(decode("Zv==") == Base64Result::INVALID_PADDING);
+    CHECK(decode("Zm8=") == Base64Result::OK);
+    CHECK(decode("Zm9=") == Base64Result::INVALID_PADDING);
+    CHECK(decode("Zm8/") == Base64Result::OK);          // Blocco completo: nessun bit scartato
+    // Padding fuori posto o eccessivo
+    CHECK(decode("====") == Base64Result::INVALID_PADDING);
+    CHECK(decode("Z===") == Base64Result::INVALID_PADDING);
+    CHECK(decode("=m8=") == Base64Result::INVALID_PADDING);
+    CHECK(decode("Zg==Zm9v") == Base64Result::INVALID_PADDING);
+    CHECK(decode("Zm=v") == Base64Result::INVALID_PADDING);
+    CHECK(decode("Zm9vZ=8=") == Base64Result::INVALID_PADDING);
+    // Padding mancante
+    CHECK(decode("Zg") == Base64Result::INVALID_LENGTH);
+    CHECK(decode("Zm8") == Base64Result::INVALID_LENGTH);
+    CHECK(decode("Zm9vY") == Base64Result::INVALID_LENGTH);
+}
+
+// Ogni byte fuori dall'alfabeto, in ogni posizione di un blocco completo
+// e del blocco finale con padding
+static void rejectCharacters() {
+    struct { const char* text; int pos; } cases[] = {
+        { "Zm9vYmE=", 0 }, { "Zm9vYmE=", 1 }, { "Zm9vYmE=", 2 }, { "Zm9vYmE=", 3 },
+        { "Zm9vYmE=", 4 }, { "Zm9vYmE=", 5 }, { "Zm9vYmE=", 6 },
+        { "Zm9vYg==", 4 }, { "Zm9vYg==", 5 }
+    };
+    const unsigned caseCount = sizeof(cases) / sizeof(cases[0]);
+    unsigned rejected = 0;
+    for (int c = 1; c < 256; c++) {
+        if (base64CharValue((uint8_t)c) >= 0 || c == '=') {
+            continue;
+        }
+        for (auto& testCase : cases) {
+            char text[9];
+            strcpy(text, testCase.text);
+            text[testCase.pos] = (char)c;
+            Base64Result result = decode(text);
+            CHECK(result == Base64Result::INVALID_CHAR);
+            rejected += result == Base64Result::INVALID_CHAR;
+        }
+    }
+    // 255 byte non nulli: 64 dell'alfabeto + '=' validi
+    CHECK_EQ(rejected, (255 - 65) * caseCount);
+
+    // Un byte 0 non termina la stringa: la lunghezza è esplicita
+    const char withNull[] = { 'Z', 'm', '\0', 'v' };
+    uint8_t out[4];
+    size_t decoded = 0;
+    CHECK(base64Decode(withNull, sizeof(withNull), out, sizeof(out), decoded) == Base64Result::INVALID_CHAR);
+    // URL-safe non è accettato
+    CHECK(decode("-_-_") == Base64Result::INVALID_CHAR);
+    CHECK(decode("Zm9v Zm9v") == Base64Result::INVALID_LENGTH);
+    CHECK(decode("Zm9\nZm9v") == Base64Result::INVALID_CHAR);
+}
+
+int main() {
+    roundTrip();
+    knownVectors();
+    rejectPadding();
+    rejectCharacters();
+    return testResult("test_base64");
+}
@@ -0,0 +1,234 @@
+// ===========================
+// TEST CODA DOWNLINK (clock tmst virtuale)
+// ===========================
+// Ordine per tmst anche a cavallo del wrap a 2^32, rilevamento delle
+// sovrapposizioni (solo predecessore e successore), limite per DevAddr,
+// lane immediata e confronti casuali con modelli banali.
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "DownlinkQueue.h"
+
+static DownlinkFrame makeFrame(uint32_t devAddr, uint8_t length, uint16_t token = 0) {
+    DownlinkFrame frame;
+    frame.info.devAddr = devAddr;
+    frame.info.token = token;
+    frame.info.length = length;
+    for (uint8_t i = 0; i < length; i++) {
+        frame.payload[i] = (uint8_t)(devAddr + i);
+    }
+    return frame;
+}
+
+static bool payloadValid(const DownlinkEntry& entry) {
+    for (uint8_t i = 0; i < entry.info.length; i++) {
+        if (entry.payload[i] != (uint8_t)(entry.info.devAddr + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static DownlinkQueue queue;
+
+static void wrapOrdering() {
+    queue.clear();
+    CHECK(queue.schedule(makeFrame(1, 10), 0x00000100u, 1000) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(2, 20), 0xFFFFF000u, 1000) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(3, 30), 0xFFFFFF00u, 100) == QueueResult::OK);
+    CHECK_EQ(queue.scheduledCount(), 3);
+
+    const uint32_t expected[] = { 0xFFFFF000u, 0xFFFFFF00u, 0x00000100u };
+    for (uint32_t tmst : expected) {
+        DownlinkEntry* next = queue.nextScheduled();
+        CHECK(next != nullptr);
+        if (next == nullptr) return;
+        CHECK_EQ(next->txTmst, tmst);
+        CHECK(payloadValid(*next));
+        queue.popScheduled();
+    }
+    CHECK(queue.nextScheduled() == nullptr);
+    CHECK(queue.isEmpty());
+}
+
+static void collisions() {
+    queue.clear();
+    // [0xFFFFFC00, 0x00000400) scavalca il wrap
+    CHECK(queue.schedule(makeFrame(1, 10), 0xFFFFFC00u, 2048) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(2, 10), 0x000003FFu, 100) == QueueResult::COLLISION);
+    CHECK(queue.schedule(makeFrame(2, 10), 0xFFFFFB00u, 257) == QueueResult::COLLISION);
+    CHECK(queue.schedule(makeFrame(2, 10), 0xFFFFFF00u, 10) == QueueResult::COLLISION);
+    // Intervalli adiacenti [a, b) non si sovrappongono
+    CHECK(queue.schedule(makeFrame(2, 10), 0x00000400u, 100) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(3, 10), 0xFFFFFB00u, 256) == QueueResult::OK);
+    CHECK_EQ(queue.scheduledCount(), 3);
+    // Le collisioni non consumano slot né contano per il DevAddr
+    CHECK_EQ(queue.countByDevAddr(2), 1);
+
+    // Il predecessore lungo copre il nuovo intervallo dopo altri inizi
+    queue.clear();
+    CHECK(queue.schedule(makeFrame(1, 10), 1000, 100) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(2, 10), 2000, 50000) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(3, 10), 60000, 100) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(4, 10), 40000, 10) == QueueResult::COLLISION);
+    CHECK(queue.schedule(makeFrame(4, 10), 500, 600) == QueueResult::COLLISION);
+    CHECK(queue.schedule(makeFrame(4, 10), 52000, 8000) == QueueResult::OK);
+
+    // FULL e DEVADDR_LIMIT prima della ricerca delle sovrapposizioni
+    CHECK(queue.schedule(makeFrame(4, 10), 1000, 100) == QueueResult::COLLISION);
+    CHECK(queue.schedule(makeFrame(4, 10), 70000, 100) == QueueResult::OK);
+    CHECK(queue.schedule(makeFrame(4, 10), 1000, 100) == QueueResult::DEVADDR_LIMIT);
+}
+
+static void limits() {
+    queue.clear();
+    CHECK(queue.schedule(makeFrame(0xAABB, 5), 1000, 100) == QueueResult::OK);
+    CHECK(queue.addImmediate(makeFrame(0xAABB, 5), 100) == QueueResult::OK);
+    CHECK(!queue.canAddForDevAddr(0xAABB));
+    CHECK(queue.schedule(makeFrame(0xAABB, 5), 5000, 100) == QueueResult::DEVADDR_LIMIT);
+    CHECK(queue.addImmediate(makeFrame(0xAABB, 5), 100) == QueueResult::DEVADDR_LIMIT);
+    queue.popImmediate();
+    CHECK(queue.canAddForDevAddr(0xAABB));
+    CHECK(queue.schedule(makeFrame(0xAABB, 5), 5000, 100) == QueueResult::OK);
+
+    queue.clear();
+    for (uint32_t i = 0; i < DownlinkQueue::capacity(); i++) {
+        CHECK(queue.schedule(makeFrame(i, DOWNLINK_MAX_FRAME_SIZE), i * 1000, 500) == QueueResult::OK);
+    }
+    CHECK(queue.isFull());
+    CHECK(queue.schedule(makeFrame(9999, 1), 0x10000000u, 500) == QueueResult::FULL);
+    CHECK(queue.schedule(makeFrame(9999, 1), 0, 500) == QueueResult::FULL);
+    CHECK(queue.addImmediate(makeFrame(9999, 1), 500) == QueueResult::FULL);
+    for (uint32_t i = 0; i < DownlinkQueue::capacity(); i++) {
+        DownlinkEntry* next = queue.nextScheduled();
+        CHECK(next != nullptr && next->txTmst == i * 1000 && payloadValid(*next));
+        queue.popScheduled();
+    }
+    CHECK(queue.isEmpty());
+}
+
+static void immediateLane() {
+    queue.clear();
+    for (uint32_t i = 0; i < 5; i++) {
+        CHECK(queue.addImmediate(makeFrame(100 + i, (uint8_t)(i + 1), (uint16_t)i), 1000) == QueueResult::OK);
+    }
+    CHECK(queue.schedule(makeFrame(200, 8), 50, 1000) == QueueResult::OK);
+    CHECK_EQ(queue.immediateSize(), 5);
+    CHECK_EQ(queue.size(), 6);
+
+    char line[112];
+    uint16_t lines = 0;
+    while (queue.formatEntry(lines, line, sizeof(line)) > 0) {
+        lines++;
+    }
+    CHECK_EQ(lines, 6);
+
+    for (uint32_t i = 0; i < 5; i++) {
+        DownlinkEntry* next = queue.nextImmediate();
+        CHECK(next != nullptr && next->info.token == i && next->immediate && payloadValid(*next));
+        queue.popImmediate();
+    }
+    CHECK(queue.nextImmediate() == nullptr);
+    CHECK_EQ(queue.size(), 1);
+}
+
+// Inserimenti/estrazioni casuali confrontati con un array ordinato
+static void randomModel() {
+    queue.clear();
+    uint32_t model[MAX_DOWNLINK_QUEUE_SIZE];
+    uint32_t modelSize = 0;
+    uint32_t base = 0xFFF00000u;     // Il clock passa per il wrap
+    uint32_t devAddr = 1;
+    srand(12345);
+
+    for (uint32_t op = 0; op < 200000; op++) {
+        if (modelSize < MAX_DOWNLINK_QUEUE_SIZE && (modelSize == 0 || rand() % 3 != 0)) {
+            // Griglia da 2 ms, ToA 1 ms: due istanti diversi non si sovrappongono
+            uint32_t tmst = base + (uint32_t)(rand() % 4096) * 2000;
+            bool taken = false;
+            for (uint32_t i = 0; i < modelSize; i++) {
+                if (model[i] == tmst) taken = true;
+            }
+            QueueResult result = queue.schedule(makeFrame(devAddr++, (uint8_t)(op % 64)), tmst, 1000);
+            CHECK(result == (taken ? QueueResult::COLLISION : QueueResult::OK));
+            if (!taken) {
+                uint32_t pos = modelSize++;
+                while (pos > 0 && tmstDelta(model[pos - 1], tmst) > 0) {
+                    model[pos] = model[pos - 1];
+                    pos--;
+                }
+                model[pos] = tmst;
+            }
+        } else {
+            DownlinkEntry* next = queue.nextScheduled();
+            CHECK(next != nullptr && next->txTmst == model[0] && payloadValid(*next));
+            queue.popScheduled();
+            memmove(model, model + 1, (--modelSize) * sizeof(model[0]));
+            base = model[0] - 1000000;   // Il tempo avanza con le estrazioni
+            if (modelSize == 0) base += 2000000;
+        }
+        CHECK_EQ(queue.scheduledCount(), modelSize);
+    }
+}
+
+// Intervalli di durata casuale confrontati con una verifica a forza bruta
+static void randomIntervals() {
+    queue.clear();
+    struct Interval { uint32_t start; uint32_t airtime; };
+    Interval model[MAX_DOWNLINK_QUEUE_SIZE];
+    uint32_t modelSize = 0;
+    uint32_t base = 0xFFFF0000u;
+    uint32_t devAddr = 1;
+    uint32_t collisions = 0;
+    srand(777);
+
+    for (uint32_t op = 0; op < 200000; op++) {
+        if (modelSize < MAX_DOWNLINK_QUEUE_SIZE && (modelSize == 0 || rand() % 3 != 0)) {
+            uint32_t start = base + (uint32_t)(rand() % 200000);
+            uint32_t airtime = 1 + (uint32_t)(rand() % 30000);
+            bool overlap = false;
+            for (uint32_t i = 0; i < modelSize; i++) {
+                overlap |= tmstDelta(model[i].start, start + airtime) < 0 &&
+                           tmstDelta(model[i].start + model[i].airtime, start) > 0;
+            }
+            QueueResult result = queue.schedule(makeFrame(devAddr++, 8), start, airtime);
+            CHECK(result == (overlap ? QueueResult::COLLISION : QueueResult::OK));
+            if (overlap) {
+                collisions++;
+            } else {
+                model[modelSize++] = { start, airtime };
+            }
+        } else {
+            uint32_t first = 0;
+            for (uint32_t i = 1; i < modelSize; i++) {
+                if (tmstDelta(model[i].start, model[first].start) < 0) first = i;
+            }
+            DownlinkEntry* next = queue.nextScheduled();
+            CHECK(next != nullptr && next->txTmst == model[first].start &&
+                  next->airtimeUs == model[first].airtime);
+            queue.popScheduled();
+            base = model[first].start;
+            model[first] = model[--modelSize];
+        }
+        CHECK_EQ(queue.scheduledCount(), modelSize);
+    }
+    CHECK(collisions > 0);
+
+    // Visita in ordine di tmst
+    char line[112];
+    uint16_t lines = 0;
+    while (queue.formatEntry(lines, line, sizeof(line)) > 0) {
+        lines++;
+    }
+    CHECK_EQ(lines, modelSize);
+}
+
+int main() {
+    wrapOrdering();
+    collisions();
+    limits();
+    immediateLane();
+    randomModel();
+    randomIntervals();
+    return testResult("test_downlink_queue");
+}
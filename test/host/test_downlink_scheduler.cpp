@@ -0,0 +1,159 @@
+// ===========================
+// TEST DOWNLINK SCHEDULER (clock tmst virtuale)
+// ===========================
+// Le formule di DownlinkScheduler.h su un contatore a 32 bit simulato:
+// confini di TOO_LATE/TOO_EARLY, pre-roll, lead e lo stesso percorso
+// del radio task (timer one-shot, sveglia nel pre-roll, busy-wait) anche a
+// cavallo del wrap a 2^32.
+#include <string.h>
+#include "HostTest.h"
+#include "DownlinkScheduler.h"
+
+#define PREROLL 2000
+#define LEAD 150
+#define LATE 1000
+#define AHEAD 10000000
+
+// Istanti "now" vicini al wrap e lontani da esso
+static const uint32_t BASES[] = { 0, 1000, 0x7FFFFFF0u, 0xFFFFFFFFu - 5000, 0xFFFFFFFFu };
+
+static void wrapArithmetic() {
+    CHECK_EQ(tmstDelta(5, 0xFFFFFFF0u), 21);
+    CHECK_EQ(tmstDelta(0xFFFFFFF0u, 5), -21);
+    CHECK(tmstReached(0xFFFFFFFFu, 0));
+    CHECK(!tmstReached(0, 0xFFFFFFFFu));
+    CHECK(tmstReached(1234, 1234));
+}
+
+static void timingBoundaries() {
+    DownlinkScheduler scheduler(PREROLL, LEAD, LATE, AHEAD);
+
+    for (uint32_t now : BASES) {
+        // Comando TX a now + remaining: target = comando + LEAD
+        #define TARGET(remaining) ((uint32_t)(now + (int32_t)(remaining) + LEAD))
+        CHECK_EQ(scheduler.txStartTmst(TARGET(0)), now);
+
+        CHECK(scheduler.check(TARGET(0), now) == TxTiming::OK);
+        CHECK(scheduler.check(TARGET(-LATE), now) == TxTiming::OK);
+        CHECK(scheduler.check(TARGET(-LATE - 1), now) == TxTiming::TOO_LATE);
+        CHECK(scheduler.check(TARGET(-500000), now) == TxTiming::TOO_LATE);
+        CHECK(scheduler.check(TARGET(AHEAD), now) == TxTiming::OK);
+        CHECK(scheduler.check(TARGET(AHEAD + 1), now) == TxTiming::TOO_EARLY);
+        // RX1/RX2 tipici
+        CHECK(scheduler.check(TARGET(1000000), now) == TxTiming::OK);
+        CHECK(scheduler.check(TARGET(2000000), now) == TxTiming::OK);
+
+        // Pre-roll: il timer sveglia PREROLL prima del comando
+        CHECK_EQ(scheduler.timerDelayUs(TARGET(1000000), now), 1000000 - PREROLL);
+        CHECK_EQ(scheduler.timerDelayUs(TARGET(PREROLL + 1), now), 1);
+        CHECK_EQ(scheduler.timerDelayUs(TARGET(PREROLL), now), 0);
+        CHECK_EQ(scheduler.timerDelayUs(TARGET(PREROLL - 1), now), 0);
+        CHECK_EQ(scheduler.timerDelayUs(TARGET(-LATE), now), 0);
+
+        CHECK(!scheduler.inPreRoll(TARGET(PREROLL + 1), now));
+        CHECK(scheduler.inPreRoll(TARGET(PREROLL), now));
+        CHECK(scheduler.inPreRoll(TARGET(0), now));
+        CHECK(scheduler.inPreRoll(TARGET(-LATE - 1), now));
+        #undef TARGET
+    }
+}
+
+// Radio task simulato: riceve il txpk a now, arma il timer, si sveglia con
+// wakeLatency di ritardo, poi busy-wait a passi di stepUs fino al comando
+static int32_t simulateTx(DownlinkScheduler& scheduler, uint32_t now, uint32_t target,
+                          uint32_t wakeLatency, uint32_t stepUs) {
+    if (scheduler.check(target, now) != TxTiming::OK) {
+        return INT32_MIN;
+    }
+    now += scheduler.timerDelayUs(target, now) + wakeLatency;
+    CHECK(scheduler.inPreRoll(target, now) || wakeLatency > PREROLL);
+    while (!tmstReached(scheduler.txStartTmst(target), now)) {
+        now += stepUs;
+    }
+    return scheduler.recordTxStart(target, now);
+}
+
+static void virtualClock() {
+    DownlinkScheduler scheduler(PREROLL, LEAD, LATE, AHEAD);
+
+    // RX1 a 1 s dall'uplink che scavalca il wrap
+    uint32_t rx = 0xFFFFFFFFu - 400000;
+    CHECK_EQ(simulateTx(scheduler, rx + 30000, rx + 1000000, 300, 1), 0);
+    // Busy-wait a passi di 7 µs: al massimo 6 µs di ritardo
+    int32_t error = simulateTx(scheduler, rx + 30000, rx + 2000000, 300, 7);
+    CHECK(error >= 0 && error < 7);
+    // Sveglia oltre il pre-roll: comando in ritardo di wake - PREROLL
+    CHECK_EQ(simulateTx(scheduler, 100, 100 + 500000, PREROLL + 400, 1), 400);
+    // txpk arrivato già dentro il pre-roll: nessun timer, solo busy-wait
+    CHECK_EQ(simulateTx(scheduler, 5000, 5000 + LEAD + 800, 0, 1), 0);
+    // Già scaduto
+    CHECK_EQ(simulateTx(scheduler, 5000 + LATE + 1, 5000 + LEAD, 0, 1), INT32_MIN);
+
+    CHECK_EQ(scheduler.getTxCount(), 4);
+    CHECK_EQ(scheduler.getMinErrorUs(), 0);
+    CHECK_EQ(scheduler.getMaxErrorUs(), 400);
+    CHECK_EQ(scheduler.getLastErrorUs(), 0);
+}
+
+static void errorStats() {
+    DownlinkScheduler scheduler(PREROLL, 0, LATE, AHEAD);
+    CHECK_EQ(scheduler.getMeanAbsErrorUs(), 0);
+    CHECK_EQ(scheduler.recordTxStart(1000, 990), -10);
+    CHECK_EQ(scheduler.recordTxStart(0xFFFFFFF0u, 20), 36);   // Dopo il wrap
+    CHECK_EQ(scheduler.recordTxStart(50, 52), 2);
+    CHECK_EQ(scheduler.getMinErrorUs(), -10);
+    CHECK_EQ(scheduler.getMaxErrorUs(), 36);
+    CHECK_EQ(scheduler.getMeanAbsErrorUs(), 16);
+}
+
+// Istogramma con segno: bucket da 5 us in ±100 us, fuori scala ai lati
+static void errorHistogram() {
+    DownlinkScheduler scheduler(PREROLL, 0, LATE, AHEAD);
+    CHECK_EQ(scheduler.getErrorPercentileUs(50), 0);
+    for (uint32_t i = 0; i < 90; i++) {
+        scheduler.recordTxStart(1000, 1000 + i % 5);   // [0, 5)
+    }
+    for (uint32_t i = 0; i < 8; i++) {
+        scheduler.recordTxStart(1000, 1012);           // [10, 15)
+    }
+    scheduler.recordTxStart(1000, 963);                // -37: [-40, -35)
+    scheduler.recordTxStart(1000, 1250);               // Oltre +100
+    CHECK_EQ(scheduler.getErrorPercentileUs(1), -36);
+    CHECK_EQ(scheduler.getErrorPercentileUs(50), 4);
+    CHECK_EQ(scheduler.getErrorPercentileUs(99), 14);
+    CHECK_EQ(scheduler.getErrorPercentileUs(100), 250);
+
+    char line[48];
+    CHECK(scheduler.formatErrorBucket(0, line, sizeof(line)) == 0);
+    CHECK(scheduler.formatErrorBucket(21, line, sizeof(line)) > 0);
+    CHECK(strcmp(line, "[0, 5) us: 90") == 0);
+    CHECK(scheduler.formatErrorBucket(13, line, sizeof(line)) > 0);
+    CHECK(strcmp(line, "[-40, -35) us: 1") == 0);
+    CHECK(scheduler.formatErrorBucket(scheduler.errorBucketCount() - 1, line, sizeof(line)) > 0);
+    CHECK(strcmp(line, ">= 100 us: 1") == 0);
+    CHECK(scheduler.formatErrorBucket(scheduler.errorBucketCount(), line, sizeof(line)) == 0);
+
+    // Estremi della scala e valori sotto: il p0 è il minimo osservato
+    DownlinkScheduler edges(PREROLL, 0, LATE, AHEAD);
+    edges.recordTxStart(1000, 900);                    // -100: primo bucket in scala
+    edges.recordTxStart(1000, 1099);                   // +99: ultimo bucket in scala
+    edges.recordTxStart(1000, 500);                    // -500: fuori scala
+    CHECK(edges.formatErrorBucket(1, line, sizeof(line)) > 0);
+    CHECK(strcmp(line, "[-100, -95) us: 1") == 0);
+    CHECK(edges.formatErrorBucket(DOWNLINK_TX_ERROR_BUCKETS, line, sizeof(line)) > 0);
+    CHECK(strcmp(line, "[95, 100) us: 1") == 0);
+    CHECK(edges.formatErrorBucket(0, line, sizeof(line)) > 0);
+    CHECK(strcmp(line, "< -100 us: 1") == 0);
+    CHECK_EQ(edges.getErrorPercentileUs(0), -500);
+    CHECK_EQ(edges.getErrorPercentileUs(50), -96);
+    CHECK_EQ(edges.getErrorPercentileUs(100), 99);
+}
+
+int main() {
+    wrapArithmetic();
+    timingBoundaries();
+    virtualClock();
+    errorStats();
+    errorHistogram();
+    return testResult("test_downlink_scheduler");
+}
@@ -0,0 +1,147 @@
+// ===========================
+// TEST DUTY CYCLE EU868
+// ===========================
+// Sottobanda del canale ai bordi ±BW/2, finestra scorrevole (scadenza
+// degli intervalli, salti oltre DUTY_CYCLE_SLOTS), limiti del budget in
+// check() con i contatori dei rifiuti e un confronto casuale con un
+// registro di tutte le TX.
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "DutyCycle.h"
+
+static void subBands() {
+    CHECK_EQ(eu868SubBand(868100000UL, 125000), 2);
+    CHECK_EQ(eu868SubBand(868500000UL, 125000), 2);
+    CHECK_EQ(eu868SubBand(869525000UL, 125000), 4);
+    CHECK_EQ(eu868SubBand(867100000UL, 125000), 1);
+
+    // Canale tutto dentro la sottobanda: bordi a ±BW/2
+    CHECK_EQ(eu868SubBand(868062500UL, 125000), 2);
+    CHECK_EQ(eu868SubBand(868062499UL, 125000), -1);
+    CHECK_EQ(eu868SubBand(868537500UL, 125000), 2);
+    CHECK_EQ(eu868SubBand(868537501UL, 125000), -1);
+    CHECK_EQ(eu868SubBand(869525000UL, 250000), 4);
+    CHECK_EQ(eu868SubBand(869525000UL, 500000), -1);
+    CHECK_EQ(eu868SubBand(863000000UL, 0), 0);
+    CHECK_EQ(eu868SubBand(870000000UL, 0), 5);
+
+    // Tra le sottobande e fuori da EU868
+    CHECK_EQ(eu868SubBand(868650000UL, 125000), -1);
+    CHECK_EQ(eu868SubBand(869300000UL, 125000), -1);
+    CHECK_EQ(eu868SubBand(870000000UL, 125000), -1);
+    CHECK_EQ(eu868SubBand(915000000UL, 125000), -1);
+    CHECK_EQ(eu868SubBand(433175000UL, 125000), -1);
+}
+
+static void expiry() {
+    DutyCycleLedger ledger;
+    ledger.record(2, 1000, 0);
+    CHECK_EQ(ledger.usedUs(2, 59), 1000);
+    CHECK_EQ(ledger.usedUs(2, 60), 1000);
+    // L'intervallo 0 resta finché la finestra non lo scavalca del tutto
+    CHECK_EQ(ledger.usedUs(2, DUTY_CYCLE_WINDOW_S + DUTY_CYCLE_BUCKET_S - 1), 1000);
+    CHECK_EQ(ledger.usedUs(2, DUTY_CYCLE_WINDOW_S + DUTY_CYCLE_BUCKET_S), 0);
+    CHECK_EQ(ledger.usedUs(1, DUTY_CYCLE_WINDOW_S + DUTY_CYCLE_BUCKET_S), 0);
+
+    // Una TX per intervallo: il totale sale fino a DUTY_CYCLE_SLOTS TX e lì resta
+    DutyCycleLedger steady;
+    for (uint32_t minute = 0; minute < 3 * DUTY_CYCLE_SLOTS; minute++) {
+        uint32_t nowS = 1000 + minute * DUTY_CYCLE_BUCKET_S;
+        steady.record(4, 500, nowS);
+        uint32_t expected = (minute + 1 < DUTY_CYCLE_SLOTS ? minute + 1 : DUTY_CYCLE_SLOTS) * 500;
+        CHECK_EQ(steady.usedUs(4, nowS), expected);
+    }
+
+    // Salto oltre tutta la finestra: tutto azzerato, poi si riparte
+    steady.record(0, 700, 500000);
+    CHECK_EQ(steady.usedUs(4, 500000), 0);
+    CHECK_EQ(steady.usedUs(0, 500000), 700);
+    // Salto di esattamente DUTY_CYCLE_SLOTS intervalli
+    CHECK_EQ(steady.usedUs(0, 500000 + DUTY_CYCLE_SLOTS * DUTY_CYCLE_BUCKET_S), 0);
+
+    // getUsedUs() non fa scorrere la finestra: valore per eccesso
+    DutyCycleLedger stale;
+    stale.record(3, 900, 0);
+    CHECK_EQ(stale.getUsedUs(3), 900);
+    CHECK_EQ(stale.usedUs(3, 100000), 0);
+    CHECK_EQ(stale.getUsedUs(3), 0);
+}
+
+static void budget() {
+    DutyCycleLedger ledger;
+    uint32_t budgetUs = EU868_BANDS[0].budgetUs;
+    ledger.record(0, budgetUs - 600000, 10);
+
+    // Esattamente il budget: ammessa. Un microsecondo in più: rifiutata
+    CHECK(ledger.check(0, 600000, 20) == DutyCycleResult::OK);
+    CHECK(ledger.check(0, 600001, 20) == DutyCycleResult::OVER_BUDGET);
+    CHECK_EQ(ledger.getRejected(0), 1);
+    // check() non registra nulla
+    CHECK_EQ(ledger.usedUs(0, 20), budgetUs - 600000);
+    ledger.record(0, 600000, 30);
+    CHECK(ledger.check(0, 1, 30) == DutyCycleResult::OVER_BUDGET);
+    CHECK(ledger.check(0, 0, 30) == DutyCycleResult::OK);
+    CHECK_EQ(ledger.getRejected(0), 2);
+
+    // Altre sottobande indipendenti
+    CHECK(ledger.check(4, 300000000UL, 30) == DutyCycleResult::OK);
+    CHECK_EQ(ledger.getRejected(4), 0);
+
+    // Il budget torna quando l'intervallo esce dalla finestra
+    uint32_t expiredS = DUTY_CYCLE_WINDOW_S + DUTY_CYCLE_BUCKET_S;
+    CHECK(ledger.check(0, budgetUs, expiredS) == DutyCycleResult::OK);
+    CHECK(ledger.check(0, budgetUs + 1, expiredS) == DutyCycleResult::OVER_BUDGET);
+    CHECK_EQ(ledger.getRejected(0), 3);
+
+    // Sottobanda non valida: nessun conteggio, nessuna registrazione
+    CHECK(ledger.check(-1, 1, 40) == DutyCycleResult::NO_BAND);
+    CHECK(ledger.check(EU868_SUB_BANDS, 1, 40) == DutyCycleResult::NO_BAND);
+    ledger.record(-1, 1000, 40);
+    CHECK_EQ(ledger.usedUs(-1, 40), 0);
+    CHECK_EQ(ledger.usedUs(EU868_SUB_BANDS, 40), 0);
+    CHECK_EQ(ledger.getRejected(-1), 0);
+    CHECK_EQ(ledger.getRejected(EU868_SUB_BANDS), 0);
+
+    for (uint8_t i = 0; i <= (uint8_t)DutyCycleResult::OVER_BUDGET; i++) {
+        CHECK(strcmp(dutyCycleResultToString((DutyCycleResult)i), "UNKNOWN") != 0);
+    }
+}
+
+// TX casuali confrontate con il registro completo: conta ogni TX il cui
+// intervallo è tra gli ultimi DUTY_CYCLE_SLOTS
+static void randomModel() {
+    struct Tx { uint32_t nowS; int8_t band; uint32_t airtimeUs; };
+    static Tx log[20000];
+    uint32_t logSize = 0;
+    DutyCycleLedger ledger;
+    uint32_t nowS = 12345;
+    srand(2024);
+
+    while (logSize < sizeof(log) / sizeof(log[0])) {
+        // Passi brevi, a volte salti di ore
+        nowS += rand() % 50 == 0 ? (uint32_t)(rand() % 20000) : (uint32_t)(rand() % 30);
+        int8_t band = (int8_t)(rand() % EU868_SUB_BANDS);
+        uint32_t airtimeUs = 1000 + (uint32_t)(rand() % 2000000);
+        ledger.record(band, airtimeUs, nowS);
+        log[logSize++] = { nowS, band, airtimeUs };
+
+        uint32_t bucket = nowS / DUTY_CYCLE_BUCKET_S;
+        for (int8_t b = 0; b < EU868_SUB_BANDS; b++) {
+            uint64_t expected = 0;
+            for (uint32_t i = logSize; i-- > 0; ) {
+                if (bucket - log[i].nowS / DUTY_CYCLE_BUCKET_S >= DUTY_CYCLE_SLOTS) break;
+                if (log[i].band == b) expected += log[i].airtimeUs;
+            }
+            CHECK_EQ(ledger.usedUs(b, nowS), expected);
+        }
+    }
+}
+
+int main() {
+    subBands();
+    expiry();
+    budget();
+    randomModel();
+    return testResult("test_duty_cycle");
+}
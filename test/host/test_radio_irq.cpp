@@ -0,0 +1,220 @@
+// ===========================
+// TEST CODA IRQ RADIO (burst di fronti DIO1)
+// ===========================
+// Un registro IRQ SX126x simulato: ogni fronte alza dei flag e accoda un
+// evento (come la ISR), il consumatore legge lo stato e lo cancella (come
+// readRadioIrqStatus() + readData()/clear). Si verificano classificazione,
+// eventi sovrapposti (flag già consumati da un evento precedente → NONE),
+// overrun a ring pieno e, con due thread a burst casuali, che ogni fronte
+// sia gestito o contato e che nessun flag resti senza un evento che lo legga.
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "RadioIrq.h"
+
+#define STRESS_EDGES 200000UL
+
+static void classification() {
+    struct { uint16_t status; RadioIrqKind kind; } cases[] = {
+        { 0,                                                    RadioIrqKind::NONE },
+        { SX126X_IRQ_RX_DONE,                                   RadioIrqKind::RX_DONE },
+        { SX126X_IRQ_RX_DONE | SX126X_IRQ_HEADER_VALID |
+          SX126X_IRQ_PREAMBLE | SX126X_IRQ_SYNC_WORD_VALID,     RadioIrqKind::RX_DONE },
+        { SX126X_IRQ_RX_DONE | SX126X_IRQ_CRC_ERR,              RadioIrqKind::CRC_ERROR },
+        { SX126X_IRQ_HEADER_ERR,                                RadioIrqKind::HEADER_ERROR },
+        { SX126X_IRQ_HEADER_ERR | SX126X_IRQ_TIMEOUT,           RadioIrqKind::HEADER_ERROR },
+        { SX126X_IRQ_TIMEOUT,                                   RadioIrqKind::TIMEOUT },
+        { SX126X_IRQ_TX_DONE,                                   RadioIrqKind::TX_DONE },
+        // RxDone e TxDone nello stesso stato: prima il pacchetto
+        { SX126X_IRQ_TX_DONE | SX126X_IRQ_RX_DONE,              RadioIrqKind::RX_DONE },
+        { SX126X_IRQ_TX_DONE | SX126X_IRQ_TIMEOUT,              RadioIrqKind::TIMEOUT },
+        { SX126X_IRQ_PREAMBLE,                                  RadioIrqKind::OTHER },
+        { SX126X_IRQ_CAD_DONE | SX126X_IRQ_CAD_DETECTED,        RadioIrqKind::OTHER },
+    };
+    for (auto& testCase : cases) {
+        CHECK(classifyRadioIrq(testCase.status) == testCase.kind);
+    }
+    for (uint8_t kind = 0; kind <= (uint8_t)RadioIrqKind::OTHER; kind++) {
+        CHECK(strcmp(radioIrqKindToString((RadioIrqKind)kind), "UNKNOWN") != 0);
+    }
+}
+
+// Radio simulata su un solo thread: fronti e consumo in un ordine scelto
+struct SimRadio {
+    RadioIrqQueue<8> queue;
+    uint16_t irq = 0;
+    uint32_t tmst = 1000;
+
+    void edge(uint16_t flags) {
+        irq |= flags;
+        queue.pushFromIsr(tmst++);
+    }
+
+    // Un evento: stato catturato per primo, poi lettura e cancellazione
+    RadioIrqKind consume() {
+        RadioIrqEvent* event = queue.front();
+        if (event == nullptr) {
+            return RadioIrqKind::OTHER;
+        }
+        event->status = irq;
+        irq = 0;
+        RadioIrqKind kind = classifyRadioIrq(event->status);
+        queue.release();
+        return kind;
+    }
+};
+
+static void overlappingEvents() {
+    // Due pacchetti prima che il task legga: il primo evento vede RxDone,
+    // il secondo trova i flag già consumati
+    SimRadio radio;
+    radio.edge(SX126X_IRQ_RX_DONE);
+    radio.edge(SX126X_IRQ_RX_DONE);
+    CHECK(radio.consume() == RadioIrqKind::RX_DONE);
+    CHECK(radio.consume() == RadioIrqKind::NONE);
+    CHECK(radio.queue.isEmpty());
+
+    // CRC errato seguito da un pacchetto valido: vince l'errore, il
+    // secondo evento è NONE (il buffer radio è già stato sovrascritto)
+    radio.edge(SX126X_IRQ_RX_DONE | SX126X_IRQ_CRC_ERR);
+    radio.edge(SX126X_IRQ_RX_DONE);
+    CHECK(radio.consume() == RadioIrqKind::CRC_ERROR);
+    CHECK(radio.consume() == RadioIrqKind::NONE);
+
+    // TxDone e RxDone ravvicinati: un solo evento con entrambi i flag
+    radio.edge(SX126X_IRQ_TX_DONE);
+    radio.edge(SX126X_IRQ_RX_DONE);
+    CHECK(radio.consume() == RadioIrqKind::RX_DONE);
+    CHECK(radio.consume() == RadioIrqKind::NONE);
+
+    // Fronte letto prima del successivo: due eventi distinti
+    radio.edge(SX126X_IRQ_TX_DONE);
+    CHECK(radio.consume() == RadioIrqKind::TX_DONE);
+    radio.edge(SX126X_IRQ_HEADER_ERR);
+    CHECK(radio.consume() == RadioIrqKind::HEADER_ERROR);
+    CHECK(radio.irq == 0);
+    CHECK_EQ(radio.queue.getOverruns(), 0);
+}
+
+static void burstOverrun() {
+    // 12 fronti con il task fermo: 8 accodati in ordine, 4 contati
+    SimRadio radio;
+    for (int i = 0; i < 12; i++) {
+        radio.edge(SX126X_IRQ_RX_DONE);
+    }
+    CHECK_EQ(radio.queue.getOverruns(), 4);
+    // Un solo pacchetto leggibile: gli altri eventi trovano i flag consumati
+    uint16_t seq = 0;
+    RadioIrqEvent* event;
+    while ((event = radio.queue.front()) != nullptr) {
+        CHECK_EQ(event->seq, seq);
+        CHECK_EQ(event->tmst, 1000 + seq);
+        CHECK_EQ(event->status, 0);
+        CHECK(radio.consume() == (seq == 0 ? RadioIrqKind::RX_DONE : RadioIrqKind::NONE));
+        seq++;
+    }
+    CHECK_EQ(seq, 8);
+
+    // I fronti persi non consumano numeri di sequenza
+    radio.edge(SX126X_IRQ_TIMEOUT);
+    CHECK_EQ(radio.queue.front()->seq, 8);
+    CHECK(radio.consume() == RadioIrqKind::TIMEOUT);
+
+    // Sequenza a 16 bit: riparte da 0 senza perdere l'ordine
+    for (uint32_t i = 0; i < 70000; i++) {
+        uint16_t expected = (uint16_t)(9 + i);
+        radio.edge(SX126X_IRQ_RX_DONE);
+        CHECK(radio.queue.front()->seq == expected);
+        radio.consume();
+    }
+    CHECK_EQ(radio.queue.getOverruns(), 4);
+}
+
+// ----- STRESS: ISR e radio task su due thread -----
+struct StressRun {
+    RadioIrqQueue<8> queue;
+    uint16_t irq = 0;              // Registro simulato (accessi atomici)
+    bool done = false;
+    uint32_t handled = 0;
+    uint32_t packets = 0;
+    uint32_t stale = 0;
+    uint32_t errors = 0;
+};
+
+static void* isrThread(void* arg) {
+    StressRun* run = (StressRun*)arg;
+    uint32_t seed = 7;
+    uint32_t edge = 0;
+    while (edge < STRESS_EDGES) {
+        // Burst di 1..12 fronti, poi la CPU al consumatore
+        uint32_t burst = 1 + rand_r(&seed) % 12;
+        for (uint32_t i = 0; i < burst && edge < STRESS_EDGES; i++, edge++) {
+            uint16_t flags = rand_r(&seed) % 10 == 0 ? (SX126X_IRQ_RX_DONE | SX126X_IRQ_CRC_ERR)
+                                                      : SX126X_IRQ_RX_DONE;
+            __atomic_fetch_or(&run->irq, flags, __ATOMIC_SEQ_CST);
+            run->queue.pushFromIsr(edge);
+        }
+        sched_yield();
+    }
+    __atomic_store_n(&run->done, true, __ATOMIC_RELEASE);
+    return nullptr;
+}
+
+static void* radioTaskThread(void* arg) {
+    StressRun* run = (StressRun*)arg;
+    uint16_t seq = 0;
+    long lastTmst = -1;
+    for (;;) {
+        RadioIrqEvent* event = run->queue.front();
+        if (event == nullptr) {
+            if (__atomic_load_n(&run->done, __ATOMIC_ACQUIRE) && run->queue.isEmpty()) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        if (event->seq != seq || (long)event->tmst <= lastTmst) {
+            run->errors++;
+        }
+        seq++;
+        lastTmst = (long)event->tmst;
+        event->status = __atomic_exchange_n(&run->irq, 0, __ATOMIC_SEQ_CST);
+        switch (classifyRadioIrq(event->status)) {
+            case RadioIrqKind::NONE:      run->stale++; break;
+            case RadioIrqKind::RX_DONE:
+            case RadioIrqKind::CRC_ERROR: run->packets++; break;
+            default:                      run->errors++; break;
+        }
+        run->handled++;
+        run->queue.release();
+    }
+    return nullptr;
+}
+
+static void stress() {
+    static StressRun run;
+    pthread_t isr, task;
+    pthread_create(&task, nullptr, radioTaskThread, &run);
+    pthread_create(&isr, nullptr, isrThread, &run);
+    pthread_join(isr, nullptr);
+    pthread_join(task, nullptr);
+
+    printf("[RADIO_IRQ] %lu fronti: %u gestiti (%u con flag, %u NONE), %u overrun\n",
+           STRESS_EDGES, run.handled, run.packets, run.stale, run.queue.getOverruns());
+    CHECK_EQ(run.errors, 0);
+    CHECK_EQ(run.handled + run.queue.getOverruns(), STRESS_EDGES);
+    CHECK_EQ(run.packets + run.stale, run.handled);
+    // Ogni flag alzato ha avuto un evento accodato dopo di lui
+    CHECK_EQ(run.irq, 0);
+    CHECK(run.packets > 0);
+}
+
+int main() {
+    classification();
+    overlappingEvents();
+    burstOverrun();
+    stress();
+    return testResult("test_radio_irq");
+}
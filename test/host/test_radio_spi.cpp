@@ -0,0 +1,343 @@
+// ===========================
+// TEST TRANSAZIONI SPI (bus finto)
+// ===========================
+// Un bus che registra ogni transazione (opcode, lunghezze) e simula i
+// registri dell'SX126x che servono: buffer RX, stato pacchetto, FEI e
+// registro IQ. Si verificano il numero e l'ordine delle transazioni di
+// readRxPacket() (RxReadout.h), dei cambi di profilo di RadioShadow
+// (RadioProfile.h, con count.writes uguale alle transazioni reali) e
+// delle due fasi di TxStaging.h, anche con un errore a ogni passo.
+#include <string.h>
+#include "HostTest.h"
+#include "RxReadout.h"
+#include "RadioProfile.h"
+#include "TxStaging.h"
+
+#define MOCK_MAX_TRANSACTIONS 16
+
+struct MockBus {
+    struct Transaction {
+        uint8_t opcode;
+        uint8_t cmdLen;
+        size_t length;
+        bool write;
+    };
+    Transaction log[MOCK_MAX_TRANSACTIONS];
+    uint8_t count = 0;
+    int failAt = -1;              // Indice della transazione che fallisce
+
+    // Stato simulato della radio
+    uint8_t buffer[256];
+    uint8_t rxLength = 20;
+    uint8_t rxOffset = 0x80;
+    uint8_t packetStatus[3] = { 180, (uint8_t)(int8_t)-30, 190 };
+    uint8_t fei[3] = { 0x00, 0x03, 0xE8 };
+    uint8_t iqRegister = 0x0D;
+    uint8_t lastWrite[256];
+    size_t lastWriteLength = 0;
+
+    MockBus() {
+        for (size_t i = 0; i < sizeof(buffer); i++) {
+            buffer[i] = (uint8_t)i;
+        }
+    }
+
+    bool record(const uint8_t* cmd, uint8_t cmdLen, size_t length, bool write) {
+        uint8_t index = count;
+        if (count < MOCK_MAX_TRANSACTIONS) {
+            log[count] = { cmd[0], cmdLen, length, write };
+        }
+        count++;
+        return (int)index != failAt;
+    }
+
+    bool read(const uint8_t* cmd, uint8_t cmdLen, uint8_t* data, size_t length) {
+        if (!record(cmd, cmdLen, length, false)) {
+            return false;
+        }
+        switch (cmd[0]) {
+            case SX126X_CMD_GET_RX_BUFFER_STATUS:
+                data[0] = rxLength;
+                data[1] = rxOffset;
+                return true;
+            case SX126X_CMD_READ_BUFFER:
+                memcpy(data, buffer + cmd[1], length);
+                return true;
+            case SX126X_CMD_GET_PACKET_STATUS:
+                memcpy(data, packetStatus, 3);
+                return true;
+            case SX126X_CMD_READ_REGISTER:
+                if (((cmd[1] << 8) | cmd[2]) == SX126X_REG_FREQ_ERROR) {
+                    memcpy(data, fei, 3);
+                    return true;
+                }
+                if (((cmd[1] << 8) | cmd[2]) == SX126X_REG_IQ_POLARITY) {
+                    data[0] = iqRegister;
+                    return true;
+                }
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    bool write(const uint8_t* cmd, uint8_t cmdLen, const uint8_t* data, size_t length) {
+        if (!record(cmd, cmdLen, length, true)) {
+            return false;
+        }
+        memcpy(lastWrite, data, length);
+        lastWriteLength = length;
+        if (cmd[0] == SX126X_CMD_WRITE_REGISTER && ((cmd[1] << 8) | cmd[2]) == SX126X_REG_IQ_POLARITY) {
+            iqRegister = data[0];
+        }
+        return true;
+    }
+
+    bool sequence(const uint8_t* opcodes, uint8_t n) const {
+        if (count != n) {
+            return false;
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            if (log[i].opcode != opcodes[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void reset() {
+        count = 0;
+        failAt = -1;
+    }
+};
+
+// ----- LETTURA PACCHETTO -----
+static void rxReadout() {
+    MockBus bus;
+    uint8_t payload[256];
+    RxPacketInfo info;
+
+    // Quattro transazioni, payload in una sola lettura dall'offset
+    CHECK(readRxPacket(bus, payload, sizeof(payload), 125000, info) == RxReadoutResult::OK);
+    const uint8_t full[] = { SX126X_CMD_GET_RX_BUFFER_STATUS, SX126X_CMD_READ_BUFFER,
+                             SX126X_CMD_GET_PACKET_STATUS, SX126X_CMD_READ_REGISTER };
+    CHECK(bus.sequence(full, sizeof(full)));
+    CHECK_EQ(bus.log[1].cmdLen, 2);
+    CHECK_EQ(bus.log[1].length, 20);
+    CHECK_EQ(bus.log[3].cmdLen, 3);
+    CHECK_EQ(info.length, 20);
+    CHECK_EQ(info.offset, 0x80);
+    CHECK(payload[0] == 0x80 && payload[19] == 0x80 + 19);
+    CHECK(info.rssi == -90.0f);
+    CHECK(info.snr == -7.5f);
+    CHECK(info.signalRssi == -95.0f);
+    CHECK_EQ(info.freqErrorHz, 121);
+
+    // Pacchetto più lungo del buffer: troncato, lunghezza ricevuta riportata
+    bus.reset();
+    CHECK(readRxPacket(bus, payload, 8, 125000, info) == RxReadoutResult::OK);
+    CHECK_EQ(bus.log[1].length, 8);
+    CHECK_EQ(info.length, 20);
+
+    // Pacchetto vuoto: niente ReadBuffer
+    bus.reset();
+    bus.rxLength = 0;
+    CHECK(readRxPacket(bus, payload, sizeof(payload), 125000, info) == RxReadoutResult::OK);
+    const uint8_t empty[] = { SX126X_CMD_GET_RX_BUFFER_STATUS, SX126X_CMD_GET_PACKET_STATUS,
+                              SX126X_CMD_READ_REGISTER };
+    CHECK(bus.sequence(empty, sizeof(empty)));
+    bus.rxLength = 20;
+
+    // Errore a ogni passo: ci si ferma lì; la FEI è facoltativa
+    const RxReadoutResult expected[] = { RxReadoutResult::BUFFER_STATUS_ERROR,
+                                         RxReadoutResult::PAYLOAD_ERROR,
+                                         RxReadoutResult::PACKET_STATUS_ERROR,
+                                         RxReadoutResult::OK };
+    for (int step = 0; step < 4; step++) {
+        bus.reset();
+        bus.failAt = step;
+        CHECK(readRxPacket(bus, payload, sizeof(payload), 125000, info) == expected[step]);
+        CHECK_EQ(bus.count, step + 1);
+    }
+    CHECK_EQ(info.freqErrorHz, 0);
+
+    // FEI: segno a 20 bit e scala con la banda
+    const uint8_t negative[3] = { 0x0F, 0xFC, 0x18 };     // -1000
+    const uint8_t minimum[3] = { 0x08, 0x00, 0x00 };      // -524288
+    CHECK_EQ(sx126xFreqErrorHz(negative, 125000), -121);
+    CHECK_EQ(sx126xFreqErrorHz(bus.fei, 500000), 484);
+    CHECK_EQ(sx126xFreqErrorHz(minimum, 500000), -253952);
+}
+
+// ----- CAMBI DI PROFILO -----
+static RadioProfile rxProfile() {
+    RadioProfile profile;
+    profile.freqHz = 868100000;
+    profile.sf = 7;
+    profile.bwKHz = 125;
+    profile.crDenom = 5;
+    profile.powerDbm = 22;
+    return profile;
+}
+
+// Applica e verifica che le scritture contate siano le transazioni reali
+static RadioProfileResult applyCounted(RadioShadow& shadow, MockBus& bus, const RadioProfile& target,
+                                       bool forTx, RadioSwitchCount& count) {
+    bus.reset();
+    RadioProfileResult result = shadow.apply(bus, target, forTx, count);
+    if (result == RadioProfileResult::OK) {
+        CHECK_EQ(count.writes, bus.count);
+    }
+    return result;
+}
+
+static void radioShadow() {
+    MockBus bus;
+    RadioShadow shadow;
+    RadioSwitchCount count;
+    RadioProfile rx = rxProfile();
+    shadow.assume(rx, true);
+    shadow.rxRestarted();
+
+    // Primo RX1: stessi freq/modulazione, potenza e IQ (letto una volta)
+    RadioProfile rx1 = rx;
+    rx1.invertIq = true;
+    rx1.powerDbm = 14;
+    CHECK(applyCounted(shadow, bus, rx1, true, count) == RadioProfileResult::OK);
+    const uint8_t first[] = { SX126X_CMD_SET_TX_PARAMS, SX126X_CMD_READ_REGISTER, SX126X_CMD_WRITE_REGISTER };
+    CHECK(bus.sequence(first, sizeof(first)));
+    CHECK_EQ(count.saved, 2);
+    CHECK_EQ(bus.iqRegister, 0x09);
+
+    // Ritorno all'RX: solo il registro IQ, senza rileggerlo
+    CHECK(applyCounted(shadow, bus, rx, false, count) == RadioProfileResult::OK);
+    const uint8_t back[] = { SX126X_CMD_WRITE_REGISTER };
+    CHECK(bus.sequence(back, sizeof(back)));
+    CHECK_EQ(count.saved, 3);
+    CHECK_EQ(bus.iqRegister, 0x0D);
+    shadow.rxRestarted();
+
+    // RX1 successivi: una sola transazione
+    CHECK(applyCounted(shadow, bus, rx1, true, count) == RadioProfileResult::OK);
+    CHECK(bus.sequence(back, sizeof(back)));
+    CHECK_EQ(count.saved, 4);
+    CHECK(applyCounted(shadow, bus, rx, false, count) == RadioProfileResult::OK);
+    shadow.rxRestarted();
+
+    // RX2 a 869.525 MHz SF12: frequenza, modulazione (LDRO) e IQ
+    RadioProfile rx2 = rx1;
+    rx2.freqHz = 869525000;
+    rx2.sf = 12;
+    bus.reset();
+    CHECK(shadow.apply(bus, rx2, true, count) == RadioProfileResult::OK);
+    const uint8_t toRx2[] = { SX126X_CMD_SET_RF_FREQUENCY, SX126X_CMD_SET_MODULATION_PARAMS,
+                              SX126X_CMD_WRITE_REGISTER };
+    CHECK(bus.sequence(toRx2, sizeof(toRx2)));
+    CHECK_EQ(count.writes, 3);
+    CHECK_EQ(count.saved, 2);
+    CHECK_EQ(sx126xFrequencyRegister(869525000), 0x36586666);
+    CHECK_EQ(sx126xFrequencyRegister(868100000), 0x36419999);
+    CHECK(applyCounted(shadow, bus, rx, false, count) == RadioProfileResult::OK);
+    const uint8_t fromRx2[] = { SX126X_CMD_SET_RF_FREQUENCY, SX126X_CMD_SET_MODULATION_PARAMS,
+                                SX126X_CMD_WRITE_REGISTER };
+    CHECK(bus.sequence(fromRx2, sizeof(fromRx2)));
+    shadow.rxRestarted();
+
+    // Parametri non validi: nessuna transazione
+    RadioProfile bad = rx1;
+    bad.bwKHz = 62;
+    bus.reset();
+    CHECK(shadow.apply(bus, bad, true, count) == RadioProfileResult::INVALID_PARAMS);
+    CHECK_EQ(bus.count, 0);
+
+    // Errore a ogni passo, poi invalidate(): il cambio successivo riscrive tutto
+    const RadioProfileResult failures[] = { RadioProfileResult::FREQUENCY_ERROR,
+                                            RadioProfileResult::MODULATION_ERROR,
+                                            RadioProfileResult::POWER_ERROR,
+                                            RadioProfileResult::IQ_ERROR,
+                                            RadioProfileResult::IQ_ERROR };
+    for (int step = 0; step < 5; step++) {
+        shadow.invalidate();
+        bus.reset();
+        bus.failAt = step;
+        CHECK(shadow.apply(bus, rx2, true, count) == failures[step]);
+        CHECK_EQ(bus.count, step + 1);
+        shadow.invalidate();
+        CHECK(applyCounted(shadow, bus, rx1, true, count) == RadioProfileResult::OK);
+        CHECK_EQ(count.writes, 5);
+        CHECK_EQ(count.saved, 0);
+        bus.reset();
+        CHECK(shadow.apply(bus, rx1, true, count) == RadioProfileResult::OK);
+        CHECK_EQ(bus.count, 0);
+        CHECK_EQ(count.saved, 4);
+    }
+
+    // Modulazione di ritorno all'RX: SF7, BW125, 4/5, senza LDRO
+    shadow.invalidate();
+    bus.reset();
+    bus.failAt = 2;   // Ci si ferma dopo SetModulationParams
+    shadow.apply(bus, rx, true, count);
+    const uint8_t modulation[] = { 7, 0x04, 1, 0 };
+    CHECK_EQ(bus.lastWriteLength, sizeof(modulation));
+    CHECK(memcmp(bus.lastWrite, modulation, sizeof(modulation)) == 0);
+}
+
+// ----- TX IN DUE FASI -----
+static void txStaging() {
+    MockBus bus;
+    uint8_t payload[51];
+    memset(payload, 0x5A, sizeof(payload));
+    TxStageParams params;
+    params.payload = payload;
+    params.length = sizeof(payload);
+
+    CHECK(prepareTx(bus, params) == TxStageResult::OK);
+    const uint8_t prepare[] = { SX126X_CMD_SET_STANDBY, SX126X_CMD_SET_BUFFER_BASE_ADDRESS,
+                                SX126X_CMD_WRITE_BUFFER, SX126X_CMD_SET_PACKET_PARAMS,
+                                SX126X_CMD_SET_DIO_IRQ_PARAMS, SX126X_CMD_CLEAR_IRQ_STATUS };
+    CHECK(bus.sequence(prepare, sizeof(prepare)));
+    CHECK_EQ(bus.log[2].length, sizeof(payload));
+
+    // All'istante TX: un solo comando
+    bus.reset();
+    CHECK(fireTx(bus) == TxStageResult::OK);
+    const uint8_t fire[] = { SX126X_CMD_SET_TX };
+    CHECK(bus.sequence(fire, sizeof(fire)));
+    bus.failAt = 0;
+    bus.count = 0;
+    CHECK(fireTx(bus) == TxStageResult::FIRE_ERROR);
+
+    const TxStageResult failures[] = { TxStageResult::STANDBY_ERROR, TxStageResult::BUFFER_ERROR,
+                                       TxStageResult::BUFFER_ERROR, TxStageResult::PARAMS_ERROR,
+                                       TxStageResult::IRQ_ERROR, TxStageResult::IRQ_ERROR };
+    for (int step = 0; step < 6; step++) {
+        bus.reset();
+        bus.failAt = step;
+        CHECK(prepareTx(bus, params) == failures[step]);
+        CHECK_EQ(bus.count, step + 1);
+    }
+
+    // Downlink RX1 completo dall'RX: preparazione + profilo + SetTx
+    RadioShadow shadow;
+    RadioSwitchCount count;
+    RadioProfile rx = rxProfile();
+    RadioProfile rx1 = rx;
+    rx1.invertIq = true;
+    shadow.assume(rx, true);
+    shadow.apply(bus, rx, false, count);
+    shadow.rxRestarted();
+    bus.reset();
+    prepareTx(bus, params);
+    shadow.apply(bus, rx1, true, count);
+    fireTx(bus);
+    printf("[RADIO_SPI] downlink RX1: %u transazioni (%u preparazione, %u profilo, 1 SetTx), %u evitate\n",
+           bus.count, (unsigned)sizeof(prepare), count.writes, count.saved);
+    CHECK_EQ(bus.count, sizeof(prepare) + 1 + 1);
+}
+
+int main() {
+    rxReadout();
+    radioShadow();
+    txStaging();
+    return testResult("test_radio_spi");
+}
@@ -0,0 +1,156 @@
+// ===========================
+// TEST SPSC RING (stress con due thread)
+// ===========================
+// Un thread produttore e uno consumatore, come radio task → network task:
+// ogni elemento porta un numero di sequenza e un payload derivato da esso.
+// Il consumatore verifica ordine, assenza di perdite/duplicati e che il
+// payload non sia mai letto a metà scrittura (le attese cedono la CPU:
+// il test gira anche su macchine con un solo core). Le due API (push/pop per
+// copia, reserve/commit e front/release in place) si alternano.
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "HostTest.h"
+#include "SpscRing.h"
+
+#define STRESS_ITEMS 1000000UL
+
+struct StressItem {
+    uint32_t seq;
+    uint8_t length;
+    uint8_t payload[61];
+};
+
+static void fillItem(StressItem& item, uint32_t seq) {
+    item.seq = seq;
+    item.length = (uint8_t)(seq % sizeof(item.payload));
+    memset(item.payload, (int)(seq * 31u), sizeof(item.payload));
+}
+
+static bool itemValid(const StressItem& item, uint32_t seq) {
+    if (item.seq != seq || item.length != (uint8_t)(seq % sizeof(item.payload))) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(item.payload); i++) {
+        if (item.payload[i] != (uint8_t)(seq * 31u)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <size_t N>
+struct StressRun {
+    SpscRing<StressItem, N> ring;
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint32_t producerSpins = 0;
+};
+
+template <size_t N>
+static void* producerThread(void* arg) {
+    StressRun<N>* run = (StressRun<N>*)arg;
+    for (uint32_t seq = 0; seq < STRESS_ITEMS; seq++) {
+        if (seq & 1) {
+            StressItem* slot;
+            while ((slot = run->ring.reserve()) == nullptr) {
+                run->producerSpins++;
+                sched_yield();
+            }
+            fillItem(*slot, seq);
+            run->ring.commit();
+        } else {
+            StressItem item;
+            fillItem(item, seq);
+            while (!run->ring.push(item)) {
+                run->producerSpins++;
+                sched_yield();
+            }
+        }
+    }
+    return nullptr;
+}
+
+template <size_t N>
+static void* consumerThread(void* arg) {
+    StressRun<N>* run = (StressRun<N>*)arg;
+    uint32_t expected = 0;
+    while (expected < STRESS_ITEMS) {
+        if (expected & 2) {
+            const StressItem* item = run->ring.front();
+            if (item == nullptr) {
+                sched_yield();
+                continue;
+            }
+            if (!itemValid(*item, expected)) run->errors++;
+            run->ring.release();
+        } else {
+            StressItem item;
+            if (!run->ring.pop(item)) {
+                sched_yield();
+                continue;
+            }
+            if (!itemValid(item, expected)) run->errors++;
+        }
+        expected++;
+        run->received++;
+    }
+    return nullptr;
+}
+
+template <size_t N>
+static void stress() {
+    static StressRun<N> run;
+    pthread_t producer, consumer;
+    pthread_create(&consumer, nullptr, consumerThread<N>, &run);
+    pthread_create(&producer, nullptr, producerThread<N>, &run);
+    pthread_join(producer, nullptr);
+    pthread_join(consumer, nullptr);
+
+    printf("[SPSC] N=%zu: %u elementi, %u errori, %u attese del produttore\n",
+           N, run.received, run.errors, run.producerSpins);
+    CHECK_EQ(run.received, STRESS_ITEMS);
+    CHECK_EQ(run.errors, 0);
+    CHECK(run.ring.isEmpty());
+}
+
+// Casi limite a thread singolo: pieno, vuoto, wrap degli indici
+static void singleThread() {
+    SpscRing<StressItem, 4> ring;
+    StressItem item;
+    CHECK(ring.isEmpty());
+    CHECK(!ring.pop(item));
+    CHECK(ring.front() == nullptr);
+
+    for (uint32_t round = 0; round < 1000; round++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            fillItem(item, round * 4 + i);
+            CHECK(ring.push(item));
+        }
+        CHECK(ring.isFull());
+        CHECK(ring.reserve() == nullptr);
+        CHECK(!ring.push(item));
+        CHECK_EQ(ring.size(), 4);
+        for (uint32_t i = 0; i < 4; i++) {
+            CHECK(ring.pop(item));
+            CHECK(itemValid(item, round * 4 + i));
+        }
+        CHECK(ring.isEmpty());
+    }
+
+    // Uno slot riservato e non pubblicato non è visibile al consumatore
+    StressItem* slot = ring.reserve();
+    CHECK(slot != nullptr);
+    fillItem(*slot, 7);
+    CHECK(ring.front() == nullptr);
+    ring.commit();
+    CHECK(ring.front() != nullptr && itemValid(*ring.front(), 7));
+}
+
+int main() {
+    singleThread();
+    stress<2>();
+    stress<8>();
+    stress<64>();
+    return testResult("test_spsc_ring");
+}
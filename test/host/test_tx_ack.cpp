@@ -0,0 +1,67 @@
+// ===========================
+// TEST TX_ACK
+// ===========================
+// Esito scelto alla chiusura di una TX (finishDownlinkTx: TxDone o
+// timeout) e JSON txpk_ack inviato al NS: una TX riuscita non porta mai
+// un errore, un timeout sempre, anche con powe ridotta.
+#include <string.h>
+#include "HostTest.h"
+#include "TxAck.h"
+
+static bool jsonIs(const TxAck& ack, const char* expected) {
+    char json[64];
+    size_t length = formatTxAckJson(ack, json, sizeof(json));
+    return length == strlen(expected) && strcmp(json, expected) == 0;
+}
+
+static void finishedTx() {
+    // TxDone: nessun errore
+    TxAck done = txAckForFinishedTx(0x1234, false, false, 14);
+    CHECK_EQ(done.token, 0x1234);
+    CHECK(done.error == TxAckError::NONE);
+    CHECK(!done.powerLimited);
+    CHECK(jsonIs(done, "{\"txpk_ack\":{\"error\":\"NONE\"}}"));
+
+    // TxDone con powe ridotta: avviso con la potenza usata, non un errore
+    TxAck limited = txAckForFinishedTx(0x1234, false, true, 14);
+    CHECK(limited.error == TxAckError::NONE);
+    CHECK(jsonIs(limited, "{\"txpk_ack\":{\"warn\":\"TX_POWER\",\"value\":14}}"));
+
+    // Nessun TxDone: errore, l'avviso di potenza non lo copre
+    TxAck timedOut = txAckForFinishedTx(0xBEEF, true, true, 14);
+    CHECK_EQ(timedOut.token, 0xBEEF);
+    CHECK(timedOut.error == TxAckError::COLLISION_PACKET);
+    CHECK(jsonIs(timedOut, "{\"txpk_ack\":{\"error\":\"COLLISION_PACKET\"}}"));
+    TxAck forced = limited;
+    forced.error = TxAckError::TOO_LATE;
+    CHECK(jsonIs(forced, "{\"txpk_ack\":{\"error\":\"TOO_LATE\"}}"));
+}
+
+static void errorStrings() {
+    // Nomi del protocollo Semtech, tutti distinti e nel buffer di sendTxAck
+    for (uint8_t i = 0; i < TX_ACK_ERROR_COUNT; i++) {
+        TxAck ack;
+        ack.error = (TxAckError)i;
+        CHECK(strcmp(txAckErrorToString(ack.error), "UNKNOWN") != 0);
+        for (uint8_t j = 0; j < i; j++) {
+            CHECK(strcmp(txAckErrorToString((TxAckError)i), txAckErrorToString((TxAckError)j)) != 0);
+        }
+        char json[64];
+        CHECK(formatTxAckJson(ack, json, sizeof(json)) > 0);
+    }
+    CHECK(strcmp(txAckErrorToString((TxAckError)TX_ACK_ERROR_COUNT), "UNKNOWN") == 0);
+
+    // Buffer insufficiente: nessun JSON troncato
+    TxAck ack;
+    char small[16];
+    CHECK_EQ(formatTxAckJson(ack, small, sizeof(small)), 0);
+    char exact[sizeof("{\"txpk_ack\":{\"error\":\"NONE\"}}")];
+    CHECK_EQ(formatTxAckJson(ack, exact, sizeof(exact)), sizeof(exact) - 1);
+    CHECK_EQ(formatTxAckJson(ack, exact, sizeof(exact) - 1), 0);
+}
+
+int main() {
+    finishedTx();
+    errorStrings();
+    return testResult("test_tx_ack");
+}
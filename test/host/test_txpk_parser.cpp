@@ -0,0 +1,199 @@
+// ===========================
+// TEST PARSER TXPK
+// ===========================
+// PULL_RESP validi (come da ChirpStack e con campi sconosciuti annidati),
+// JSON malformato, ogni troncamento di un messaggio valido e i campi con
+// valori non trasmissibili (datr/codr/modu/tmst/freq).
+#include <stdlib.h>
+#include <string.h>
+#include "HostTest.h"
+#include "Fixtures.h"
+#include "TxpkParser.h"
+
+static DownlinkTxParams tx;
+static uint8_t payload[256];
+static size_t payloadLength;
+
+// Parse di json in un buffer della lunghezza esatta (letture oltre la
+// fine visibili con -fsanitize=address)
+static TxpkParseResult parseExact(const char* json, size_t length) {
+    char* copy = (char*)malloc(length > 0 ? length : 1);
+    memcpy(copy, json, length);
+    TxpkParser parser;
+    TxpkParseResult result = parser.parse(copy, length, tx, payload, sizeof(payload), payloadLength);
+    free(copy);
+    return result;
+}
+
+static TxpkParseResult parse(const char* json) {
+    return parseExact(json, strlen(json));
+}
+
+// {"txpk":{<fields>,"data":"YAEAAAABAgM="}} (8 byte)
+static TxpkParseResult parseFields(const char* fields) {
+    char json[512];
+    snprintf(json, sizeof(json), "{\"txpk\":{%s%s\"data\":\"YAEAAAABAgM=\"}}",
+             fields, fields[0] ? "," : "");
+    return parse(json);
+}
+
+static void validMessages() {
+    char json[640];
+    size_t length = fixtureTxpk(json, sizeof(json), 222, 4294967295u);
+    CHECK(parseExact(json, length) == TxpkParseResult::OK);
+    CHECK_EQ(payloadLength, 222);
+    uint8_t expected[222];
+    fixtureFrame(expected, sizeof(expected), 0x26011BDA);
+    CHECK(memcmp(payload, expected, sizeof(expected)) == 0);
+    CHECK_EQ(tx.tmst, 4294967295u);
+    CHECK_EQ(tx.freqHz, 868100000);
+    CHECK_EQ(tx.power, 14);
+    CHECK_EQ(tx.sf, 7);
+    CHECK(tx.bandwidth == LoRaBandwidth::BW_125);
+    CHECK_EQ(tx.crDenom, 5);
+    CHECK(tx.hasTmst() && tx.invertIq() && !tx.isImmediate() && !tx.hasTmms());
+
+    // Spazi ovunque, '\0' finale (come alcuni NS), RX2 e Classe C
+    CHECK(parse(" { \"txpk\" : { \"imme\" : true , \"freq\" : 869.525 , \"datr\" : \"SF12BW125\" ,"
+                " \"codr\" : \"4/8\" , \"ipol\" : false , \"powe\" : 27 , \"prea\" : 12 ,"
+                " \"data\" : \"YAEAAAABAgM=\" } } \n") == TxpkParseResult::OK);
+    CHECK(tx.isImmediate() && !tx.invertIq() && !tx.hasTmst());
+    CHECK_EQ(tx.freqHz, 869525000);
+    CHECK_EQ(tx.sf, 12);
+    CHECK_EQ(tx.crDenom, 8);
+    CHECK_EQ(tx.power, 27);
+    CHECK_EQ(tx.preamble, 12);
+    const char withNull[] = "{\"txpk\":{\"data\":\"YAEAAAABAgM=\"}}\0\0";
+    CHECK(parseExact(withNull, sizeof(withNull)) == TxpkParseResult::OK);
+
+    // Valori di default senza campi opzionali
+    CHECK(parseFields("") == TxpkParseResult::OK);
+    CHECK(tx.bandwidth == LoRaBandwidth::UNSET);
+    CHECK_EQ(tx.sf, 0);
+    CHECK_EQ(tx.crDenom, 0);
+    CHECK_EQ(tx.freqHz, 0);
+
+    CHECK(parseFields("\"tmms\":1234567890123") == TxpkParseResult::OK);
+    CHECK(tx.hasTmms());
+    CHECK(parseFields("\"freq\":868.3000004") == TxpkParseResult::OK);
+    CHECK_EQ(tx.freqHz, 868300000);
+    CHECK(parseFields("\"datr\":\"SF9BW500\"") == TxpkParseResult::OK);
+    CHECK(tx.bandwidth == LoRaBandwidth::BW_500);
+    CHECK(parseFields("\"size\":8") == TxpkParseResult::OK);
+}
+
+static void unknownFields() {
+    // Campi sconosciuti annidati dentro e fuori txpk, stringhe con escape
+    CHECK(parse("{\"extra\":[1,{\"a\":[true,null,-1.5e3]},\"x\\\"}\"],"
+                "\"txpk\":{\"brd\":0,\"ant\":{\"gain\":[0,{\"v\":\"]}\"}]},\"rfch\":0,"
+                "\"note\":\"a\\\\b\",\"data\":\"YAEAAAABAgM=\",\"fdev\":null},"
+                "\"more\":{}}") == TxpkParseResult::OK);
+    CHECK_EQ(payloadLength, 8);
+    CHECK(parseFields("\"x\":[],\"y\":{},\"z\":[[[]]]") == TxpkParseResult::OK);
+
+    // Annidamento oltre TXPK_PARSER_MAX_DEPTH
+    char deep[128] = "\"deep\":";
+    for (int i = 0; i < TXPK_PARSER_MAX_DEPTH + 2; i++) strcat(deep, "[");
+    for (int i = 0; i < TXPK_PARSER_MAX_DEPTH + 2; i++) strcat(deep, "]");
+    CHECK(parseFields(deep) == TxpkParseResult::INVALID_JSON);
+    char ok[128] = "\"deep\":";
+    for (int i = 0; i < TXPK_PARSER_MAX_DEPTH; i++) strcat(ok, "[");
+    for (int i = 0; i < TXPK_PARSER_MAX_DEPTH; i++) strcat(ok, "]");
+    CHECK(parseFields(ok) == TxpkParseResult::OK);
+}
+
+static void malformed() {
+    const char* cases[] = {
+        "",
+        "   ",
+        "[]",
+        "{",
+        "{\"txpk\"}",
+        "{\"txpk\":}",
+        "{\"txpk\" {\"data\":\"YAEAAAABAgM=\"}}",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\",}}",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\"},}",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\"}}}",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\"}} x",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\" \"powe\":14}}",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\",\"x\":[1,2}}",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\",\"x\":{\"a\"}}}",
+        "{\"txpk\":{\"data\":\"YAEAAAABAgM=\",\"x\":\"abc}}",
+        "{txpk:{\"data\":\"YAEAAAABAgM=\"}}",
+    };
+    for (const char* json : cases) {
+        TxpkParseResult result = parse(json);
+        if (result != TxpkParseResult::INVALID_JSON) {
+            fprintf(stderr, "  \"%s\" → %s\n", json, txpkParseResultToString(result));
+        }
+        CHECK(result == TxpkParseResult::INVALID_JSON);
+    }
+
+    CHECK(parse("{}") == TxpkParseResult::MISSING_TXPK);
+    CHECK(parse("{\"rxpk\":[]}") == TxpkParseResult::MISSING_TXPK);
+    CHECK(parse("{\"txpk\":{}}") == TxpkParseResult::MISSING_DATA);
+    CHECK(parse("{\"txpk\":[]}") == TxpkParseResult::INVALID_JSON);
+    CHECK(parseFields("\"size\":9") == TxpkParseResult::SIZE_MISMATCH);
+    CHECK(parse("{\"txpk\":{\"data\":\"YAEAAAABAgM\"}}") == TxpkParseResult::INVALID_DATA);
+    CHECK(parse("{\"txpk\":{\"data\":\"YAEA\\u0041ABAgM=\"}}") == TxpkParseResult::INVALID_DATA);
+    CHECK(parse("{\"txpk\":{\"data\":12}}") == TxpkParseResult::INVALID_JSON);
+
+    // data più grande del buffer
+    char big[512];
+    fixtureTxpk(big, sizeof(big), 200, 0);
+    TxpkParser parser;
+    CHECK(parser.parse(big, strlen(big), tx, payload, 199, payloadLength) == TxpkParseResult::INVALID_DATA);
+    CHECK(parser.getBase64Result() == Base64Result::OUTPUT_TOO_SMALL);
+}
+
+// Ogni prefisso di un messaggio valido è rifiutato, senza leggere oltre
+static void truncated() {
+    char json[640];
+    size_t length = fixtureTxpk(json, sizeof(json), 51, 123456);
+    CHECK(parseExact(json, length) == TxpkParseResult::OK);
+    unsigned accepted = 0;
+    for (size_t n = 0; n < length; n++) {
+        accepted += parseExact(json, n) == TxpkParseResult::OK;
+    }
+    CHECK_EQ(accepted, 0);
+}
+
+static void invalidFields() {
+    // Bandwidth non LoRa standard: non si mappa silenziosamente sulla BW di RX
+    CHECK(parseFields("\"datr\":\"SF9BW62\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"datr\":\"SF9BW0125\"") == TxpkParseResult::OK);
+    CHECK(parseFields("\"datr\":\"SF9BW126\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"datr\":\"SF13BW125\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"datr\":\"SF4BW125\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"datr\":\"SF9\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"datr\":50000") == TxpkParseResult::INVALID_FIELD);
+    // Coding rate non valido: niente crDenom = 0 silenzioso
+    CHECK(parseFields("\"codr\":\"4/9\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"codr\":\"4/4\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"codr\":\"OFF\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"codr\":\"4/5 \"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"codr\":5") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"codr\":\"4/6\"") == TxpkParseResult::OK);
+    CHECK_EQ(tx.crDenom, 6);
+
+    CHECK(parseFields("\"modu\":\"FSK\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"tmst\":4294967296") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"tmst\":-1") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"tmst\":1.5") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"freq\":0") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"freq\":8.681e2") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"freq\":\"868.1\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"powe\":128") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"imme\":1") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"ipol\":\"true\"") == TxpkParseResult::INVALID_FIELD);
+    CHECK(parseFields("\"size\":-9") == TxpkParseResult::INVALID_FIELD);
+}
+
+int main() {
+    validMessages();
+    unknownFields();
+    malformed();
+    truncated();
+    invalidFields();
+    return testResult("test_txpk_parser");
+}
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""
+Decodifica l'output seriale del gateway compilato con LOG_FLUSH_BINARY=1.
+
+I record differiti arrivano come frame binari (0xA5 0x5A + LogEntry da
+28 byte, little-endian); il resto dell'output (log sincroni) passa
+invariato. I formati sono letti da src/Log.h (LOG_MESSAGES): l'ID di un
+messaggio è la sua posizione nell'elenco.
+
+Uso:
+    python3 tools/log_decode.py capture.bin
+    python3 tools/log_decode.py /dev/ttyACM0      (richiede pyserial)
+    cat capture.bin | python3 tools/log_decode.py
+
+Con --tx-jitter, a fine input (o Ctrl-C) stampa la distribuzione
+dell'errore di avvio TX letto dai record TX_DONE, anche da log già in
+testo (LOG_FLUSH_BINARY=0): due catture, con TX_TWO_PHASE 0 e 1, danno
+il confronto prima/dopo.
+"""
+
+import os
+import re
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+ENTRY = struct.Struct("<IHBB5I")  # tmst, id, argc, reserved, args[5]
+
+LOG_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "Log.h")
+TX_DONE_RE = re.compile(r"\[TX_DL\] tmst \d+, errore avvio (-?\d+) us")
+JITTER_STEP_US = 5      # Come DOWNLINK_TX_ERROR_STEP_US
+MESSAGE_RE = re.compile(r'X\(\s*(\w+)\s*,\s*"(\w*)"\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+
+
+def load_formats(path=LOG_H):
+    with open(path, encoding="utf-8") as f:
+        source = f.read()
+    block = source[source.index("#define LOG_MESSAGES(X)"):]
+    block = block[:block.index("\n\n")]
+    formats = []
+    for name, types, fmt in MESSAGE_RE.findall(block):
+        # %lu/%ld/%08lX → sintassi Python equivalente
+        formats.append((name, types, re.sub(r"%([0-9]*)l([udxX])", r"%\1\2", fmt)))
+    return formats
+
+
+def format_entry(formats, data):
+    tmst, msg_id, argc, _, *args = ENTRY.unpack(data)
+    if msg_id >= len(formats):
+        return "[%d] [LOG] ID sconosciuto %d" % (tmst, msg_id)
+    name, types, fmt = formats[msg_id]
+    values = []
+    for i, kind in enumerate(types):
+        value = args[i] if i < argc else 0
+        if kind == "d" and value >= 0x80000000:
+            value -= 0x100000000
+        values.append(value)
+    return "[%d] %s" % (tmst, fmt % tuple(values))
+
+
+def decode(stream, formats, out):
+    buffer = b""
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            break
+        buffer += chunk
+        while True:
+            start = buffer.find(SYNC)
+            if start < 0:
+                # Tiene un eventuale primo byte di sync spezzato tra due letture
+                keep = 1 if buffer.endswith(SYNC[:1]) else 0
+                out.write(buffer[:len(buffer) - keep].decode("utf-8", "replace"))
+                buffer = buffer[len(buffer) - keep:]
+                break
+            if len(buffer) < start + len(SYNC) + ENTRY.size:
+                out.write(buffer[:start].decode("utf-8", "replace"))
+                buffer = buffer[start:]
+                break
+            out.write(buffer[:start].decode("utf-8", "replace"))
+            frame = buffer[start + len(SYNC):start + len(SYNC) + ENTRY.size]
+            out.write(format_entry(formats, frame) + "\n")
+            buffer = buffer[start + len(SYNC) + ENTRY.size:]
+        out.flush()
+    out.write(buffer.decode("utf-8", "replace"))
+
+
+class JitterCollector:
+    """Inoltra l'output e raccoglie l'errore di avvio dei TX_DONE."""
+
+    def __init__(self, out):
+        self.out = out
+        self.partial = ""
+        self.errors = []
+
+    def write(self, text):
+        self.out.write(text)
+        lines = (self.partial + text).split("\n")
+        self.partial = lines.pop()
+        for line in lines:
+            match = TX_DONE_RE.search(line)
+            if match:
+                self.errors.append(int(match.group(1)))
+
+    def flush(self):
+        self.out.flush()
+
+
+def percentile(values, percent):
+    """Percentile nearest-rank su valori ordinati."""
+    rank = max(1, -(-len(values) * percent // 100))
+    return values[rank - 1]
+
+
+def jitter_summary(errors, out):
+    out.write("\n[TX_JITTER] ===== ERRORE AVVIO TX (us) =====\n")
+    if not errors:
+        out.write("[TX_JITTER] Nessun record TX_DONE\n")
+        return
+    values = sorted(errors)
+    mean_abs = sum(abs(v) for v in values) / len(values)
+    out.write("[TX_JITTER] n=%d min=%d p1=%d p50=%d p90=%d p99=%d max=%d |media|=%.1f\n" % (
+        len(values), values[0], percentile(values, 1), percentile(values, 50),
+        percentile(values, 90), percentile(values, 99), values[-1], mean_abs))
+    buckets = {}
+    for value in values:
+        low = value // JITTER_STEP_US * JITTER_STEP_US
+        buckets[low] = buckets.get(low, 0) + 1
+    widest = max(buckets.values())
+    for low in sorted(buckets):
+        count = buckets[low]
+        bar = "#" * max(1, count * 40 // widest)
+        out.write("[TX_JITTER] [%5d, %5d) %6d %s\n" % (low, low + JITTER_STEP_US, count, bar))
+
+
+class SerialStream:
+    """Porta seriale come stream bloccante: il timeout non è fine file."""
+
+    def __init__(self, path):
+        import serial  # pyserial
+        self.port = serial.Serial(path, 115200, timeout=1)
+
+    def read(self, size):
+        while True:
+            data = self.port.read(size)
+            if data:
+                return data
+
+
+def open_input(path):
+    if path is None:
+        return sys.stdin.buffer
+    if path.startswith("/dev/"):
+        return SerialStream(path)
+    return open(path, "rb")
+
+
+def main():
+    args = sys.argv[1:]
+    jitter = "--tx-jitter" in args
+    args = [arg for arg in args if arg != "--tx-jitter"]
+    formats = load_formats()
+    stream = open_input(args[0] if args else None)
+    out = JitterCollector(sys.stdout) if jitter else sys.stdout
+    try:
+        decode(stream, formats, out)
+    except KeyboardInterrupt:
+        pass
+    if jitter:
+        jitter_summary(out.errors, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()